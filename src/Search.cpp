@@ -1,71 +1,134 @@
 #include <boost/timer.hpp>
 
 #include <iostream>
+#include <limits>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <new>
+#include <stdexcept>
 
 #include "search/Node.hpp"
 #include "search/BucketPriorityQueue.hpp"
 #include "search/Constants.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+#include "search/WeightSchedule.hpp"
 #include "search/astar/AStar.hpp"
+#include "search/externalastar/ExternalAStar.hpp"
+#include "search/frontierastar/FrontierAStar.hpp"
 #include "search/hastar/HAStar.hpp"
+#include "search/hdastar/HDAStar.hpp"
 #include "search/hidastar/HIDAStar.hpp"
 #include "search/idastar/IDAStar.hpp"
+#include "search/mm/MM.hpp"
+#include "search/pidastar/PIDAStar.hpp"
 #include "search/switchback/Switchback.hpp"
 #include "tiles/Tiles.hpp"
 #include "tiles/MacroTiles.hpp"
 #include "tiles/GluedTiles.hpp"
+#include "tiles/PDBTiles.hpp"
 #include "pancake/PancakeInstance.hpp"
+#include "util/BatchRunner.hpp"
 
 using namespace std;
 using namespace boost;
 
 
-typedef AStar<TilesInstance15, TilesNode15> TilesAStar;
-typedef IDAStar<TilesInstance15, TilesNode15> TilesIDAStar;
-typedef HAStar<TilesInstance15, TilesNode15> TilesHAStar;
-typedef HIDAStar<TilesInstance15, TilesNode15> TilesHIDAStar;
-typedef Switchback<TilesInstance15, TilesNode15> TilesSwitchback;
+// The pattern database partition used when TILES_PDB_PARTITION is unset.
+static const char default_pdb_partition[] = "7-8";
 
-typedef AStar<MacroTilesInstance15, TilesNode15> MacroTilesAStar;
-typedef IDAStar<MacroTilesInstance15, TilesNode15> MacroTilesIDAStar;
-typedef HAStar<MacroTilesInstance15, TilesNode15> MacroTilesHAStar;
-typedef HIDAStar<MacroTilesInstance15, TilesNode15> MacroTilesHIDAStar;
-typedef Switchback<MacroTilesInstance15, TilesNode15> MacroTilesSwitchback;
+// The memory externalastar sorts its buckets in, unless
+// EXTERNAL_A_STAR_MEMORY_MB is set.
+static const long default_external_astar_memory_mb = 1024;
 
-typedef AStar<GluedTilesInstance15, TilesNode15> GluedTilesAStar;
-typedef IDAStar<GluedTilesInstance15, TilesNode15> GluedTilesIDAStar;
-typedef HAStar<GluedTilesInstance15, TilesNode15> GluedTilesHAStar;
-typedef HIDAStar<GluedTilesInstance15, TilesNode15> GluedTilesHIDAStar;
-typedef Switchback<GluedTilesInstance15, TilesNode15> GluedTilesSwitchback;
+// How much astar lowers its weight after each solution,
+// unless ANYTIME_WEIGHT_STEP is set.
+static const double default_anytime_weight_step = 0.2;
 
-typedef AStar<PancakeInstance14, PancakeNode14> PancakeAStar;
-typedef HAStar<PancakeInstance14, PancakeNode14> PancakeHAStar;
-typedef HIDAStar<PancakeInstance14, PancakeNode14> PancakeHIDAStar;
-typedef IDAStar<PancakeInstance14, PancakeNode14> PancakeIDAStar;
-typedef Switchback<PancakeInstance14, PancakeNode14> PancakeSwitchback;
+// The largest weight ANYTIME_WEIGHT may give, which keeps the weighted
+// heuristic values well within an unsigned.
+static const double max_anytime_weight = 100;
 
 
-static void print_build_info(ostream &o)
-{
-  o << "tiles state hash caching is "
-#ifdef CACHE_TILES_HASH_VALUE
-    << "enabled" << endl;
+// The node type the searchers are instantiated with.
+#ifdef COMPACT_SEARCH_NODES
+typedef CompactTilesNode15 TilesSearchNode15;
+typedef CompactPancakeNode14 PancakeSearchNode14;
 #else
-    << "disabled" << endl;
+typedef TilesNode15 TilesSearchNode15;
+typedef PancakeNode14 PancakeSearchNode14;
 #endif
 
-  o << "tiles state blank index caching is "
-#ifdef CACHE_TILES_BLANK_INDEX
+
+typedef AStar<TilesInstance15, TilesSearchNode15> TilesAStar;
+typedef ExternalAStar<TilesInstance15, TilesSearchNode15> TilesExternalAStar;
+typedef FrontierAStar<TilesInstance15, TilesSearchNode15> TilesFrontierAStar;
+typedef MM<TilesInstance15, TilesSearchNode15> TilesMM;
+typedef IDAStar<TilesInstance15, TilesSearchNode15> TilesIDAStar;
+typedef PIDAStar<TilesInstance15, TilesSearchNode15> TilesPIDAStar;
+typedef HAStar<TilesInstance15, TilesSearchNode15> TilesHAStar;
+typedef HDAStar<TilesInstance15, TilesSearchNode15> TilesHDAStar;
+typedef HIDAStar<TilesInstance15, TilesSearchNode15> TilesHIDAStar;
+typedef Switchback<TilesInstance15, TilesSearchNode15> TilesSwitchback;
+
+typedef AStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesAStar;
+typedef MM<MacroTilesInstance15, TilesSearchNode15> MacroTilesMM;
+typedef IDAStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesIDAStar;
+typedef PIDAStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesPIDAStar;
+typedef HAStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesHAStar;
+typedef HDAStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesHDAStar;
+typedef HIDAStar<MacroTilesInstance15, TilesSearchNode15> MacroTilesHIDAStar;
+typedef Switchback<MacroTilesInstance15, TilesSearchNode15> MacroTilesSwitchback;
+
+typedef AStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesAStar;
+typedef MM<GluedTilesInstance15, TilesSearchNode15> GluedTilesMM;
+typedef IDAStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesIDAStar;
+typedef PIDAStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesPIDAStar;
+typedef HAStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesHAStar;
+typedef HDAStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesHDAStar;
+typedef HIDAStar<GluedTilesInstance15, TilesSearchNode15> GluedTilesHIDAStar;
+typedef Switchback<GluedTilesInstance15, TilesSearchNode15> GluedTilesSwitchback;
+
+typedef AStar<PDBTilesInstance15, TilesSearchNode15> PDBTilesAStar;
+typedef ExternalAStar<PDBTilesInstance15, TilesSearchNode15> PDBTilesExternalAStar;
+typedef MM<PDBTilesInstance15, TilesSearchNode15> PDBTilesMM;
+typedef IDAStar<PDBTilesInstance15, TilesSearchNode15> PDBTilesIDAStar;
+typedef PIDAStar<PDBTilesInstance15, TilesSearchNode15> PDBTilesPIDAStar;
+typedef HDAStar<PDBTilesInstance15, TilesSearchNode15> PDBTilesHDAStar;
+
+typedef AStar<PancakeInstance14, PancakeSearchNode14> PancakeAStar;
+typedef ExternalAStar<PancakeInstance14, PancakeSearchNode14> PancakeExternalAStar;
+typedef FrontierAStar<PancakeInstance14, PancakeSearchNode14> PancakeFrontierAStar;
+typedef MM<PancakeInstance14, PancakeSearchNode14> PancakeMM;
+typedef HAStar<PancakeInstance14, PancakeSearchNode14> PancakeHAStar;
+typedef HDAStar<PancakeInstance14, PancakeSearchNode14> PancakeHDAStar;
+typedef HIDAStar<PancakeInstance14, PancakeSearchNode14> PancakeHIDAStar;
+typedef IDAStar<PancakeInstance14, PancakeSearchNode14> PancakeIDAStar;
+typedef PIDAStar<PancakeInstance14, PancakeSearchNode14> PancakePIDAStar;
+typedef Switchback<PancakeInstance14, PancakeSearchNode14> PancakeSwitchback;
+
+
+static void print_build_info(ostream &o)
+{
+  o << "node f-value caching is "
+#ifdef CACHE_NODE_F_VALUE
     << "enabled" << endl;
 #else
     << "disabled" << endl;
 #endif
 
-  o << "node f-value caching is "
-#ifdef CACHE_NODE_F_VALUE
+  o << "compact search nodes are "
+#ifdef COMPACT_SEARCH_NODES
     << "enabled" << endl;
 #else
     << "disabled" << endl;
@@ -96,6 +159,13 @@ static void print_build_info(ostream &o)
     << "disabled" << endl;
 #endif
 
+  o << "Hierarchical search profiling is "
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+    << "enabled" << endl;
+#else
+    << "disabled" << endl;
+#endif
+
   o << "Hierarchical A*'s reexpansion counting is "
 #ifdef HIERARCHICAL_A_STAR_REEXPANSION_COUNTING
     << "enabled" << endl;
@@ -132,17 +202,6 @@ static void print_build_info(ostream &o)
   o << endl;
 
 
-  o << "IDA* Cycle Checking is "
-#ifdef IDA_STAR_CYCLE_CHECKING
-    << "enabled" << endl;
-#else
-    << "disabled" << endl;
-#endif
-
-
-  o << endl;
-
-
   o << "OUTPUT_SEARCH_PROGRESS is "
 #ifdef OUTPUT_SEARCH_PROGRESS
     << "enabled" << endl;
@@ -150,7 +209,16 @@ static void print_build_info(ostream &o)
     << "disabled" << endl;
 #endif
 
+  o << "Manhattan distance kernel is "
+    << ManhattanDist15::get_kernel_name() << endl;
+
   o << "INITIAL_CLOSED_SET_SIZE is " << INITIAL_CLOSED_SET_SIZE << endl;
+  o << "DENSE_CLOSED_MEMORY_BUDGET is " << DENSE_CLOSED_MEMORY_BUDGET << endl;
+  o << "HDA_STAR_BATCH_SIZE is " << HDA_STAR_BATCH_SIZE << endl;
+  o << "IDA_STAR_TT_MIN_SLACK is " << IDA_STAR_TT_MIN_SLACK << endl;
+  o << "PIDA_STAR_ITEMS_PER_THREAD is " << PIDA_STAR_ITEMS_PER_THREAD << endl;
+  o << "EXTERNAL_A_STAR_IO_BUFFER_BYTES is " << EXTERNAL_A_STAR_IO_BUFFER_BYTES << endl;
+  o << "SEARCH_BUDGET_CHECK_INTERVAL is " << SEARCH_BUDGET_CHECK_INTERVAL << endl;
 
 
   o << endl;
@@ -174,6 +242,7 @@ static void print_size_info(ostream &o)
     << "sizeof(TileCost) is " << sizeof(TileCost) << endl
     << "sizeof(TilesState15) is " << sizeof(TilesState15) << endl
     << "sizeof(TilesNode15) is " << sizeof(TilesNode15) << endl
+    << "sizeof(CompactTilesNode15) is " << sizeof(CompactTilesNode15) << endl
     << "sizeof(size_t) is " << sizeof(size_t) << endl
     << "sizeof(BucketPriorityQueue<TilesNode15>::ItemPointer) is "
     << sizeof(BucketPriorityQueue<TilesNode15>::ItemPointer) << endl
@@ -183,6 +252,7 @@ static void print_size_info(ostream &o)
     << "sizeof(PancakeCost) is " << sizeof(PancakeCost) << endl
     << "sizeof(PancakeState14) is " << sizeof(PancakeState14) << endl
     << "sizeof(PancakeNode14) is " << sizeof(PancakeNode14) << endl
+    << "sizeof(CompactPancakeNode14) is " << sizeof(CompactPancakeNode14) << endl
     << "sizeof(BucketPriorityQueue<PancakeNode14>::ItemPointer) is "
     << sizeof(BucketPriorityQueue<PancakeNode14>::ItemPointer) << endl;
 }
@@ -190,13 +260,83 @@ static void print_size_info(ostream &o)
 
 static void print_usage(ostream &o, const char *prog_name)
 {
-  o << "usage: " << prog_name << " DOMAIN ALGORITHM [FILE]" << endl
+  o << "usage: " << prog_name << " DOMAIN ALGORITHM [-f FORMAT] [FILE]" << endl
+    << "       " << prog_name << " DOMAIN ALGORITHM [-f FORMAT] [-j WORKERS] [-t SECONDS] [-m MB] PATH..." << endl
     << "where" << endl
-    << "  DOMAIN is one of {tiles, tiles_static_abstraction, macro_tiles, glued_tiles, pancake}" << endl
-    << "  ALGORITHM is one of {astar, hastar, idastar, hidastar, switchback}" << endl
+    << "  DOMAIN is one of {tiles, tiles_static_abstraction, tiles_pdb, macro_tiles, glued_tiles, pancake}" << endl
+    << "  ALGORITHM is one of {astar, hastar, hdastar, idastar, pidastar, hidastar, switchback, mm, frontierastar, externalastar}" << endl
     << "  FILE is the optional instance file to read from" << endl
     << endl
-    << "If no file is specified, the instance is read from stdin." << endl;
+    << "If no file is specified, the instance is read from stdin." << endl
+    << endl
+    << "Given several paths, a directory, or any of the options, the instances" << endl
+    << "in the files and directories are solved as a batch, WORKERS at a time" << endl
+    << "(default: one per online processor), each in its own process.  Each" << endl
+    << "instance gets SECONDS of wall time and MB megabytes of address space" << endl
+    << "(default: no limit), and its results are printed when it finishes." << endl
+    << endl
+    << "FORMAT is one of {text, json, csv}.  With json or csv, the results of" << endl
+    << "each instance are a single statistics record: a JSON object on one" << endl
+    << "line, or a CSV row under a header." << endl
+    << endl
+    << "hdastar is a multi-threaded A*.  It runs HDA_STAR_THREADS threads" << endl
+    << "(default: one per online processor)." << endl
+    << endl
+    << "pidastar is a multi-threaded IDA*.  It runs PIDA_STAR_THREADS threads" << endl
+    << "(default: one per online processor), which share the subtrees below" << endl
+    << "depth PIDA_STAR_SPLIT_DEPTH (default: deep enough for "
+    << PIDA_STAR_ITEMS_PER_THREAD << " subtrees per thread)." << endl
+    << endl
+    << "If IDA_STAR_TT_MB is set, idastar keeps a transposition table of that" << endl
+    << "many megabytes.  IDA_STAR_TT_POLICY is the table's replacement policy:" << endl
+    << "always, or shallow (the default) to keep the entries nearer the start." << endl
+    << endl
+    << "mm is a bidirectional A* that meets in the middle.  Its backward" << endl
+    << "search uses the domain's heuristic toward the start state (for the" << endl
+    << "tiles, including tiles_pdb, the Manhattan distance to the start)." << endl
+    << endl
+    << "frontierastar is an A* that keeps only its open list, and rebuilds the" << endl
+    << "solution by solving the halves of the problem on either side of a" << endl
+    << "state on it.  It only works with tiles, tiles_static_abstraction and" << endl
+    << "pancake." << endl
+    << endl
+    << "externalastar is an A* that keeps its open and closed lists on disk," << endl
+    << "in a directory it makes in EXTERNAL_A_STAR_DIR (default: TMPDIR, or" << endl
+    << "/tmp), and sorts them EXTERNAL_A_STAR_MEMORY_MB megabytes (default" << endl
+    << default_external_astar_memory_mb << ") at a time.  It only works with" << endl
+    << "tiles, tiles_static_abstraction, tiles_pdb and pancake." << endl
+    << endl
+    << "If ANYTIME_WEIGHT is set, astar is an anytime weighted search: its" << endl
+    << "first solution is within ANYTIME_WEIGHT (at least 1) times the optimal" << endl
+    << "cost, and it goes on to improve it, lowering the weight by" << endl
+    << "ANYTIME_WEIGHT_STEP (default " << default_anytime_weight_step << ") after each solution, down to 1." << endl
+    << "Each solution, with its suboptimality bound, is reported on stderr as" << endl
+    << "it is found.  With a step of 0, the search stops at its first solution." << endl
+    << "Switchback has no weighted mode: its abstract searches stay optimal, so" << endl
+    << "weighting its base level only makes it slower." << endl
+    << endl
+    << "If SWITCHBACK_MEMORY_MB is set, switchback keeps its nodes within that" << endl
+    << "many megabytes by discarding the searches at abstract levels, least" << endl
+    << "recently used first, and redoing them when they are needed again." << endl
+    << endl
+    << "tiles_pdb uses an additive pattern database, and only works with" << endl
+    << "astar, hdastar, idastar, pidastar, mm and externalastar.  The partition is read from TILES_PDB_PARTITION" << endl
+    << "(default " << default_pdb_partition << ") and the database file from" << endl
+    << "TILES_PDB_FILE (default tiles15-PARTITION.pdb).  The file is built" << endl
+    << "if it does not exist." << endl
+    << endl
+    << "If HIERARCHICAL_CACHE_DIR is set, hastar and hidastar save their caches" << endl
+    << "of abstract heuristic values there, and preload them in later runs on" << endl
+    << "the same domain, goal and abstraction." << endl
+    << endl
+    << "SEARCH_TIME_BUDGET (seconds of wall time), SEARCH_EXPANSION_BUDGET" << endl
+    << "(expansions) and SEARCH_MEMORY_BUDGET_MB (megabytes of resident memory" << endl
+    << "now, not at its peak) limit the search itself.  When one runs out, the" << endl
+    << "search stops with its statistics so far, including the largest f-value" << endl
+    << "it reached (f_reached) and any solution found, and the program exits" << endl
+    << "with status " << BatchRunner::budget_exhausted_status
+    << ".  The time and memory are checked every" << endl
+    << SEARCH_BUDGET_CHECK_INTERVAL << " expansions." << endl;
 
   o << endl << endl;
 
@@ -208,11 +348,213 @@ static void print_usage(ostream &o, const char *prog_name)
 }
 
 
-static TilesInstance15 * get_tiles_instance(int argc, char *argv[])
+// The number of threads for a parallel searcher, from the given
+// environment variable, or one per online processor.
+static unsigned get_num_threads(const char *env_name = "HDA_STAR_THREADS")
+{
+  const char *threads_env = getenv(env_name);
+  if (threads_env != NULL) {
+    const int num_threads = atoi(threads_env);
+    if (num_threads <= 0) {
+      cerr << "error: invalid " << env_name << " " << threads_env << endl;
+      exit(1);
+    }
+    return num_threads;
+  }
+
+  const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return num_cpus > 0 ? num_cpus : 1;
+}
+
+
+// The transposition table for idastar, of IDA_STAR_TT_MB megabytes with
+// the IDA_STAR_TT_POLICY replacement policy, or NULL if IDA_STAR_TT_MB is
+// unset.
+template <class Searcher>
+static typename Searcher::Table * make_idastar_table()
+{
+  typedef typename Searcher::Table Table;
+
+  const char *size_env = getenv("IDA_STAR_TT_MB");
+  if (size_env == NULL)
+    return NULL;
+
+  const long size_mb = atol(size_env);
+  if (size_mb <= 0) {
+    cerr << "error: invalid IDA_STAR_TT_MB " << size_env << endl;
+    exit(1);
+  }
+
+  typename Table::ReplacementPolicy policy = Table::prefer_shallow;
+  const char *policy_env = getenv("IDA_STAR_TT_POLICY");
+  if (policy_env != NULL && !Table::parse_policy(policy_env, policy)) {
+    cerr << "error: invalid IDA_STAR_TT_POLICY " << policy_env << endl;
+    exit(1);
+  }
+
+  return new Table(static_cast<size_t>(size_mb) << 20, policy);
+}
+
+
+// The depth at which pidastar splits the tree, from
+// PIDA_STAR_SPLIT_DEPTH, or 0 to let it choose.
+static unsigned get_pidastar_split_depth()
+{
+  const char *depth_env = getenv("PIDA_STAR_SPLIT_DEPTH");
+  if (depth_env == NULL)
+    return 0;
+
+  const int depth = atoi(depth_env);
+  if (depth <= 0) {
+    cerr << "error: invalid PIDA_STAR_SPLIT_DEPTH " << depth_env << endl;
+    exit(1);
+  }
+  return depth;
+}
+
+
+// The directory in which externalastar makes its scratch directory,
+// from EXTERNAL_A_STAR_DIR, or TMPDIR, or /tmp.  It must be a writable
+// directory.
+static string get_external_astar_dir()
+{
+  const char *env_name = "EXTERNAL_A_STAR_DIR";
+  const char *dir_env = getenv(env_name);
+  if (dir_env == NULL) {
+    env_name = "TMPDIR";
+    dir_env = getenv(env_name);
+  }
+  if (dir_env == NULL)
+    return "/tmp";
+
+  struct stat st;
+  if (stat(dir_env, &st) != 0) {
+    cerr << "error: invalid " << env_name << " " << dir_env << ": "
+         << strerror(errno) << endl;
+    exit(1);
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    cerr << "error: invalid " << env_name << " " << dir_env
+         << ": not a directory" << endl;
+    exit(1);
+  }
+  if (access(dir_env, W_OK | X_OK) != 0) {
+    cerr << "error: invalid " << env_name << " " << dir_env << ": "
+         << strerror(errno) << endl;
+    exit(1);
+  }
+  return dir_env;
+}
+
+
+// The memory, in bytes, that externalastar sorts its buckets in, from
+// EXTERNAL_A_STAR_MEMORY_MB.
+static size_t get_external_astar_memory()
+{
+  const char *memory_env = getenv("EXTERNAL_A_STAR_MEMORY_MB");
+  if (memory_env == NULL)
+    return static_cast<size_t>(default_external_astar_memory_mb) << 20;
+
+  const long memory_mb = atol(memory_env);
+  if (memory_mb <= 0) {
+    cerr << "error: invalid EXTERNAL_A_STAR_MEMORY_MB " << memory_env << endl;
+    exit(1);
+  }
+  return static_cast<size_t>(memory_mb) << 20;
+}
+
+
+// A weight from the given environment variable, in thousandths, or the
+// given default if it is unset.
+static unsigned get_weight(const char *env_name,
+                           double default_weight,
+                           double min_weight)
+{
+  const char *weight_env = getenv(env_name);
+  double weight = default_weight;
+  if (weight_env != NULL) {
+    istringstream in(weight_env);
+    if (!(in >> weight) || !in.eof()
+        || weight < min_weight || weight > max_anytime_weight) {
+      cerr << "error: invalid " << env_name << " " << weight_env << endl;
+      exit(1);
+    }
+  }
+  return static_cast<unsigned>(weight * WeightSchedule::unit + 0.5);
+}
+
+
+// The weights for astar, from ANYTIME_WEIGHT and
+// ANYTIME_WEIGHT_STEP, or just one if ANYTIME_WEIGHT is unset.
+static WeightSchedule get_weight_schedule()
+{
+  if (getenv("ANYTIME_WEIGHT") == NULL)
+    return WeightSchedule();
+
+  return WeightSchedule(get_weight("ANYTIME_WEIGHT", 1, 1),
+                        get_weight("ANYTIME_WEIGHT_STEP",
+                                   default_anytime_weight_step,
+                                   0),
+                        &cerr);
+}
+
+
+// A search budget limit from the given environment variable, or 0 for no
+// limit if it is unset.
+template <class T>
+static T get_budget_limit(const char *env_name)
+{
+  const char *limit_env = getenv(env_name);
+  if (limit_env == NULL)
+    return 0;
+
+  T limit;
+  istringstream in(limit_env);
+  if (!(in >> limit) || !in.eof() || limit <= 0) {
+    cerr << "error: invalid " << env_name << " " << limit_env << endl;
+    exit(1);
+  }
+  return limit;
+}
+
+
+// The search memory budget, in bytes, from SEARCH_MEMORY_BUDGET_MB, or 0
+// for no limit.  Sizes too large for a size_t in bytes are rejected,
+// rather than wrapped round to a small budget.
+static size_t get_memory_budget_limit()
+{
+  const size_t limit_mb = get_budget_limit<size_t>("SEARCH_MEMORY_BUDGET_MB");
+  if (limit_mb > (numeric_limits<size_t>::max() >> 20)) {
+    cerr << "error: invalid SEARCH_MEMORY_BUDGET_MB "
+         << getenv("SEARCH_MEMORY_BUDGET_MB") << endl;
+    exit(1);
+  }
+  return limit_mb << 20;
+}
+
+
+// The memory budget for switchback, in bytes, from SWITCHBACK_MEMORY_MB,
+// or 0 for no limit.
+static size_t get_switchback_memory_budget()
+{
+  const char *budget_env = getenv("SWITCHBACK_MEMORY_MB");
+  if (budget_env == NULL)
+    return 0;
+
+  const long budget_mb = atol(budget_env);
+  if (budget_mb <= 0) {
+    cerr << "error: invalid SWITCHBACK_MEMORY_MB " << budget_env << endl;
+    exit(1);
+  }
+  return static_cast<size_t>(budget_mb) << 20;
+}
+
+
+static TilesInstance15 * get_tiles_instance(const char *path)
 {
   TilesInstance15 *instance;
-  if (argc == 4) {
-    ifstream infile(argv[3]);
+  if (path != NULL) {
+    ifstream infile(path);
     instance = readTilesInstance15(infile);
   }
   else {
@@ -228,17 +570,46 @@ static TilesInstance15 * get_tiles_instance(int argc, char *argv[])
 }
 
 
-static MacroTilesInstance15 * get_macro_tiles_instance(int argc, char *argv[])
+static PDBTilesInstance15 * get_pdb_tiles_instance(const char *instance_path)
+{
+  TilesInstance15 *instance = get_tiles_instance(instance_path);
+
+  const char *partition_env = getenv("TILES_PDB_PARTITION");
+  const string partition_string =
+    partition_env != NULL ? partition_env : default_pdb_partition;
+  AdditivePDB15::Partition partition;
+  if (!AdditivePDB15::parse_partition(partition_string, partition)) {
+    cerr << "error: invalid pattern database partition "
+         << partition_string << endl;
+    exit(1);
+  }
+
+  const char *path_env = getenv("TILES_PDB_FILE");
+  const string path =
+    path_env != NULL ? path_env : "tiles15-" + partition_string + ".pdb";
+
+  AdditivePDB15 *pdb = AdditivePDB15::load_or_build(path,
+                                                    instance->get_goal_state(),
+                                                    partition,
+                                                    cerr);
+  if (pdb == NULL)
+    exit(1);
+
+  return new PDBTilesInstance15(instance, pdb);
+}
+
+
+static MacroTilesInstance15 * get_macro_tiles_instance(const char *path)
 {
-  return new MacroTilesInstance15(get_tiles_instance(argc, argv));
+  return new MacroTilesInstance15(get_tiles_instance(path));
 }
 
 
-static GluedTilesInstance15 * get_glued_tiles_instance(int argc, char *argv[])
+static GluedTilesInstance15 * get_glued_tiles_instance(const char *path)
 {
   GluedTilesInstance15 *instance;
-  if (argc == 4) {
-    ifstream infile(argv[3]);
+  if (path != NULL) {
+    ifstream infile(path);
     instance = readGluedTilesInstance15(infile);
   }
   else {
@@ -253,11 +624,11 @@ static GluedTilesInstance15 * get_glued_tiles_instance(int argc, char *argv[])
   return instance;
 }
 
-static PancakeInstance14 * get_pancake_instance(int argc, char *argv[])
+static PancakeInstance14 * get_pancake_instance(const char *path)
 {
   PancakeInstance14 *instance;
-  if (argc == 4) {
-    ifstream infile(argv[3]);
+  if (path != NULL) {
+    ifstream infile(path);
     instance = PancakeInstance14::read(infile);
   }
   else {
@@ -287,16 +658,102 @@ static long get_max_mem_used_in_mb ()
 #endif
 }
 
+template <class Instance>
+static void print_instance(const Instance &instance,
+                           SearchStatistics::Format format)
+{
+  if (format != SearchStatistics::text_format)
+    return;
+
+  cout << "######## The Instance ########" << endl;
+  cout << instance << endl << endl;
+}
+
+static double get_wall_seconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Searches, then writes the results as text or as the given record,
+// completed with the searcher's statistics.  The search is given the
+// budget from SEARCH_TIME_BUDGET, SEARCH_EXPANSION_BUDGET and
+// SEARCH_MEMORY_BUDGET_MB, if any is set.  Returns the exit status: 0,
+// or BatchRunner::budget_exhausted_status if the budget ran out, in
+// which case the results are those so far.
 template <class Searcher>
-static void search(Searcher &searcher)
+static int search(Searcher &searcher,
+                  SearchStatistics &record,
+                  SearchStatistics::Format format)
 {
-  cout << "######## Search Results ########" << endl;
+  if (format == SearchStatistics::text_format)
+    cout << "######## Search Results ########" << endl;
+
+  SearchBudget budget(get_budget_limit<double>("SEARCH_TIME_BUDGET"),
+                      get_budget_limit<unsigned long>("SEARCH_EXPANSION_BUDGET"),
+                      get_memory_budget_limit());
+  if (budget.is_limited())
+    searcher.set_budget(&budget);
 
   timer search_timer;
-  searcher.search();
+  budget.start();
+  const double wall_start = get_wall_seconds();
+  bool exhausted = false;
+  try {
+    searcher.search();
+  }
+  catch (const BudgetExhausted &) {
+    exhausted = true;
+  }
+  catch (const std::runtime_error &e) {
+    // The searchers that keep their lists on disk fail this way.
+    cout.flush();
+    cerr << "error: " << e.what() << endl;
+    exit(1);
+  }
+  const double wall_seconds_elapsed = get_wall_seconds() - wall_start;
 
+  searcher.set_budget(NULL);
+  const int status = exhausted ? BatchRunner::budget_exhausted_status : 0;
+  const char *exhausted_limit = SearchBudget::limit_name(budget.get_exhausted());
+
+  // A search stopped by its budget may have a solution, if it is an
+  // anytime one, but the solution need not be optimal.
   const typename Searcher::Node *goal = searcher.get_goal();
-  if (goal == NULL) {
+
+  if (format != SearchStatistics::text_format) {
+    if (exhausted) {
+      record.set_string("status", "budget exhausted");
+      record.set_string("exhausted_budget", exhausted_limit);
+    }
+    else {
+      record.set_string("status", goal == NULL ? "no solution" : "solved");
+    }
+    if (goal == NULL) {
+      record.set_null("solution_cost");
+      record.set_null("solution_length");
+    }
+    else {
+      record.set_count("solution_cost", goal->get_g());
+      record.set_count("solution_length", goal->num_nodes_to_start() - 1);
+    }
+    record.set_real("wall_time", wall_seconds_elapsed);
+    record.set_real("cpu_time", search_timer.elapsed());
+    record.set_count("max_memory_mb", get_max_mem_used_in_mb());
+    searcher.get_statistics(record);
+    record.write(cout, format);
+    return status;
+  }
+
+  if (exhausted) {
+    cout << "search stopped: " << exhausted_limit << " budget exhausted" << endl;
+    if (goal != NULL) {
+      cout << "best solution so far:" << endl;
+      cout << *goal << endl;
+    }
+  }
+  else if (goal == NULL) {
     cout << "no solution found!" << endl;
   }
   else {
@@ -318,72 +775,127 @@ static void search(Searcher &searcher)
        << "max memory: " << get_max_mem_used_in_mb () << " MB" << endl;
 
   searcher.output_statistics(cout);
+  return status;
 }
 
 
-int main(int argc, char * argv[])
+// Searches with a hierarchical searcher.  If HIERARCHICAL_CACHE_DIR is
+// set, the searcher's heuristic cache is first preloaded from the file
+// that earlier runs saved there for the same domain, goal and
+// abstraction, and is saved back after a search that finishes.
+template <class Searcher>
+static int search_hierarchical(Searcher &searcher,
+                               const string &cache_name,
+                               SearchStatistics &record,
+                               SearchStatistics::Format format)
 {
-  if (argc < 3 || argc > 4) {
-    print_usage(cerr, argv[0]);
-    return 1;
-  }
+  const char *cache_dir = getenv("HIERARCHICAL_CACHE_DIR");
+  if (cache_dir != NULL)
+    searcher.load_cache(cache_dir, cache_name, cerr);
+
+  const int status = search(searcher, record, format);
+
+  // A search stopped by its budget may be stopped in the middle of an
+  // abstract search, and saving its cache would take more of the time
+  // or memory that ran out, so only a finished search saves it.
+  if (cache_dir != NULL && status != BatchRunner::budget_exhausted_status)
+    searcher.save_cache(cache_dir, cache_name, cerr);
+
+  return status;
+}
 
-  const string domain_string(argv[1]);
-  const string alg_string(argv[2]);
+
+// Solves the instance in the given file, or on stdin if path is NULL,
+// writing the results to cout.  The domain and algorithm must be valid.
+static int solve(const string &domain_string,
+                 const string &alg_string,
+                 SearchStatistics::Format format,
+                 const char *path)
+{
+  SearchStatistics record;
+  record.set_string("domain", domain_string);
+  record.set_string("algorithm", alg_string);
+  record.set_string("instance", path != NULL ? path : "-");
 
   const bool is_tiles = domain_string == "tiles";
   const bool is_tiles_static = domain_string == "tiles_static_abstraction";
+  const bool is_tiles_pdb = domain_string == "tiles_pdb";
   const bool is_macro_tiles = domain_string == "macro_tiles";
   const bool is_glued_tiles = domain_string == "glued_tiles";
   const bool is_pancake = domain_string == "pancake";
 
   const bool is_astar = alg_string == "astar";
   const bool is_hastar = alg_string == "hastar";
+  const bool is_hdastar = alg_string == "hdastar";
   const bool is_hidastar = alg_string == "hidastar";
   const bool is_idastar = alg_string == "idastar";
+  const bool is_pidastar = alg_string == "pidastar";
+  const bool is_mm = alg_string == "mm";
+  const bool is_frontier_astar = alg_string == "frontierastar";
+  const bool is_external_astar = alg_string == "externalastar";
   const bool is_switchback = alg_string == "switchback";
 
-  // ############################################################
-  // Argument Error Checking
-  // ############################################################
-  if (!is_tiles && !is_tiles_static && !is_macro_tiles && !is_pancake && !is_glued_tiles) {
-    cerr << "error: invalid domain specified" << endl;
-    print_usage(cerr, argv[0]);
-    exit (1);
-  }
-  if (!is_astar && !is_hastar && !is_hidastar && !is_idastar && !is_switchback) {
-    cerr << "error: invalid algorithm specified" << endl;
-    print_usage(cerr, argv[0]);
-    exit (1);
-  }
+  // Names the heuristic cache files of the hierarchical searchers.  The
+  // goal and abstraction order are part of the files' keys, so the two
+  // tiles domains can share files.
+  string cache_name = (is_tiles_static ? "tiles" : domain_string)
+    + "-" + alg_string;
 
   // ############################################################
   // tiles domain with custom abstraction
   // ############################################################
   if (is_tiles) {
-    TilesInstance15 *instance = get_tiles_instance(argc, argv);
-    cout << "######## The Instance ########" << endl;
-    cout << *instance << endl << endl;
+    TilesInstance15 *instance = get_tiles_instance(path);
+    print_instance(*instance, format);
 
     if (is_astar) {
-      TilesAStar &astar = *new TilesAStar(*instance);
-      search(astar);
+      TilesAStar &astar = *new TilesAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      TilesMM &mm = *new TilesMM(*instance);
+      return search(mm, record, format);
+    }
+    else if (is_external_astar) {
+      TilesExternalAStar &eastar =
+        *new TilesExternalAStar(*instance,
+                             get_external_astar_dir(),
+                             get_external_astar_memory());
+      return search(eastar, record, format);
+    }
+    else if (is_frontier_astar) {
+      TilesFrontierAStar &fastar = *new TilesFrontierAStar(*instance);
+      return search(fastar, record, format);
     }
     else if (is_hastar) {
       TilesHAStar &hastar = *new TilesHAStar(*instance);
-      search(hastar);
+      return search_hierarchical(hastar, cache_name, record, format);
+    }
+    else if (is_hdastar) {
+      TilesHDAStar &hdastar = *new TilesHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
     }
     else if (is_hidastar) {
       TilesHIDAStar &hidastar = *new TilesHIDAStar(*instance);
-      search(hidastar);
+      return search_hierarchical(hidastar, cache_name, record, format);
     }
     else if (is_idastar) {
-      TilesIDAStar &idastar = *new TilesIDAStar(*instance);
-      search(idastar);
+      TilesIDAStar &idastar =
+        *new TilesIDAStar(*instance, make_idastar_table<TilesIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      TilesPIDAStar &pidastar =
+        *new TilesPIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
     else if (is_switchback) {
-      TilesSwitchback &switchback = *new TilesSwitchback(*instance);
-      search(switchback);
+      TilesSwitchback &switchback =
+        *new TilesSwitchback(*instance,
+                             get_switchback_memory_budget());
+      return search(switchback, record, format);
     }
   }
 
@@ -391,30 +903,98 @@ int main(int argc, char * argv[])
   // tiles domain with static abstraction
   // ############################################################
   if (is_tiles_static) {
-    TilesInstance15 *instance = get_tiles_instance(argc, argv);
+    TilesInstance15 *instance = get_tiles_instance(path);
     instance->set_abstraction_order (TilesInstance15::static_abstraction_order);
-    cout << "######## The Instance ########" << endl;
-    cout << *instance << endl << endl;
+    print_instance(*instance, format);
 
     if (is_astar) {
-      TilesAStar &astar = *new TilesAStar(*instance);
-      search(astar);
+      TilesAStar &astar = *new TilesAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      TilesMM &mm = *new TilesMM(*instance);
+      return search(mm, record, format);
+    }
+    else if (is_external_astar) {
+      TilesExternalAStar &eastar =
+        *new TilesExternalAStar(*instance,
+                             get_external_astar_dir(),
+                             get_external_astar_memory());
+      return search(eastar, record, format);
+    }
+    else if (is_frontier_astar) {
+      TilesFrontierAStar &fastar = *new TilesFrontierAStar(*instance);
+      return search(fastar, record, format);
     }
     else if (is_hastar) {
       TilesHAStar &hastar = *new TilesHAStar(*instance);
-      search(hastar);
+      return search_hierarchical(hastar, cache_name, record, format);
+    }
+    else if (is_hdastar) {
+      TilesHDAStar &hdastar = *new TilesHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
     }
     else if (is_hidastar) {
       TilesHIDAStar &hidastar = *new TilesHIDAStar(*instance);
-      search(hidastar);
+      return search_hierarchical(hidastar, cache_name, record, format);
     }
     else if (is_idastar) {
-      TilesIDAStar &idastar = *new TilesIDAStar(*instance);
-      search(idastar);
+      TilesIDAStar &idastar =
+        *new TilesIDAStar(*instance, make_idastar_table<TilesIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      TilesPIDAStar &pidastar =
+        *new TilesPIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
     else if (is_switchback) {
-      TilesSwitchback &switchback = *new TilesSwitchback(*instance);
-      search(switchback);
+      TilesSwitchback &switchback =
+        *new TilesSwitchback(*instance,
+                             get_switchback_memory_budget());
+      return search(switchback, record, format);
+    }
+  }
+
+  // ############################################################
+  // tiles domain with an additive pattern database
+  // ############################################################
+  else if (is_tiles_pdb) {
+    PDBTilesInstance15 *instance = get_pdb_tiles_instance(path);
+    print_instance(*instance, format);
+
+    if (is_astar) {
+      PDBTilesAStar &astar = *new PDBTilesAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      PDBTilesMM &mm = *new PDBTilesMM(*instance);
+      return search(mm, record, format);
+    }
+    else if (is_external_astar) {
+      PDBTilesExternalAStar &eastar =
+        *new PDBTilesExternalAStar(*instance,
+                             get_external_astar_dir(),
+                             get_external_astar_memory());
+      return search(eastar, record, format);
+    }
+    else if (is_hdastar) {
+      PDBTilesHDAStar &hdastar = *new PDBTilesHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
+    }
+    else if (is_idastar) {
+      PDBTilesIDAStar &idastar =
+        *new PDBTilesIDAStar(*instance, make_idastar_table<PDBTilesIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      PDBTilesPIDAStar &pidastar =
+        *new PDBTilesPIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
   }
 
@@ -422,29 +1002,46 @@ int main(int argc, char * argv[])
   // macro tiles domain
   // ############################################################
   else if (is_macro_tiles) {
-    MacroTilesInstance15 *instance = get_macro_tiles_instance(argc, argv);
-    cout << "######## The Instance ########" << endl;
-    cout << *instance << endl << endl;
+    MacroTilesInstance15 *instance = get_macro_tiles_instance(path);
+    print_instance(*instance, format);
 
     if (is_astar) {
-      MacroTilesAStar &astar = *new MacroTilesAStar(*instance);
-      search(astar);
+      MacroTilesAStar &astar = *new MacroTilesAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      MacroTilesMM &mm = *new MacroTilesMM(*instance);
+      return search(mm, record, format);
     }
     else if (is_hastar) {
       MacroTilesHAStar &hastar = *new MacroTilesHAStar(*instance);
-      search(hastar);
+      return search_hierarchical(hastar, cache_name, record, format);
+    }
+    else if (is_hdastar) {
+      MacroTilesHDAStar &hdastar = *new MacroTilesHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
     }
     else if (is_hidastar) {
       MacroTilesHIDAStar &hidastar = *new MacroTilesHIDAStar(*instance);
-      search(hidastar);
+      return search_hierarchical(hidastar, cache_name, record, format);
     }
     else if (is_idastar) {
-      MacroTilesIDAStar &idastar = *new MacroTilesIDAStar(*instance);
-      search(idastar);
+      MacroTilesIDAStar &idastar =
+        *new MacroTilesIDAStar(*instance, make_idastar_table<MacroTilesIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      MacroTilesPIDAStar &pidastar =
+        *new MacroTilesPIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
     else if (is_switchback) {
-      MacroTilesSwitchback &switchback = *new MacroTilesSwitchback(*instance);
-      search(switchback);
+      MacroTilesSwitchback &switchback =
+        *new MacroTilesSwitchback(*instance,
+                                  get_switchback_memory_budget());
+      return search(switchback, record, format);
     }
   }
 
@@ -452,29 +1049,52 @@ int main(int argc, char * argv[])
   // glued tiles domain
   // ############################################################
   else if (is_glued_tiles) {
-    GluedTilesInstance15 *instance = get_glued_tiles_instance(argc, argv);
-    cout << "######## The Instance ########" << endl;
-    cout << *instance << endl << endl;
+    GluedTilesInstance15 *instance = get_glued_tiles_instance(path);
+    print_instance(*instance, format);
+
+    // The glued tile changes the domain.
+    ostringstream glued_cache_name;
+    glued_cache_name << domain_string << static_cast<int>(instance->glued)
+                     << "-" << alg_string;
+    cache_name = glued_cache_name.str();
 
     if (is_astar) {
-      GluedTilesAStar &astar = *new GluedTilesAStar(*instance);
-      search(astar);
+      GluedTilesAStar &astar = *new GluedTilesAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      GluedTilesMM &mm = *new GluedTilesMM(*instance);
+      return search(mm, record, format);
     }
     else if (is_hastar) {
       GluedTilesHAStar &hastar = *new GluedTilesHAStar(*instance);
-      search(hastar);
+      return search_hierarchical(hastar, cache_name, record, format);
+    }
+    else if (is_hdastar) {
+      GluedTilesHDAStar &hdastar = *new GluedTilesHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
     }
     else if (is_hidastar) {
       GluedTilesHIDAStar &hidastar = *new GluedTilesHIDAStar(*instance);
-      search(hidastar);
+      return search_hierarchical(hidastar, cache_name, record, format);
     }
     else if (is_idastar) {
-      GluedTilesIDAStar &idastar = *new GluedTilesIDAStar(*instance);
-      search(idastar);
+      GluedTilesIDAStar &idastar =
+        *new GluedTilesIDAStar(*instance, make_idastar_table<GluedTilesIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      GluedTilesPIDAStar &pidastar =
+        *new GluedTilesPIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
     else if (is_switchback) {
-      GluedTilesSwitchback &switchback = *new GluedTilesSwitchback(*instance);
-      search(switchback);
+      GluedTilesSwitchback &switchback =
+        *new GluedTilesSwitchback(*instance,
+                                  get_switchback_memory_budget());
+      return search(switchback, record, format);
     }
   }
 
@@ -482,31 +1102,245 @@ int main(int argc, char * argv[])
   // pancake puzzle domain
   // ############################################################
   else if (is_pancake) {
-    PancakeInstance14 *instance = get_pancake_instance(argc, argv);
-    cout << "######## The Instance ########" << endl;
-    cout << *instance << endl << endl;
+    PancakeInstance14 *instance = get_pancake_instance(path);
+    print_instance(*instance, format);
 
     if (is_astar) {
-      PancakeAStar &astar = *new PancakeAStar(*instance);
-      search(astar);
+      PancakeAStar &astar = *new PancakeAStar(*instance, get_weight_schedule());
+      return search(astar, record, format);
+    }
+    else if (is_mm) {
+      PancakeMM &mm = *new PancakeMM(*instance);
+      return search(mm, record, format);
+    }
+    else if (is_external_astar) {
+      PancakeExternalAStar &eastar =
+        *new PancakeExternalAStar(*instance,
+                             get_external_astar_dir(),
+                             get_external_astar_memory());
+      return search(eastar, record, format);
+    }
+    else if (is_frontier_astar) {
+      PancakeFrontierAStar &fastar = *new PancakeFrontierAStar(*instance);
+      return search(fastar, record, format);
     }
     else if (is_hastar) {
       PancakeHAStar &hastar = *new PancakeHAStar(*instance);
-      search(hastar);
+      return search_hierarchical(hastar, cache_name, record, format);
+    }
+    else if (is_hdastar) {
+      PancakeHDAStar &hdastar = *new PancakeHDAStar(*instance, get_num_threads());
+      return search(hdastar, record, format);
     }
     else if (is_hidastar) {
       PancakeHIDAStar &hidastar = *new PancakeHIDAStar(*instance);
-      search(hidastar);
+      return search_hierarchical(hidastar, cache_name, record, format);
     }
     else if (is_idastar) {
-      PancakeIDAStar &idastar = *new PancakeIDAStar(*instance);
-      search(idastar);
+      PancakeIDAStar &idastar =
+        *new PancakeIDAStar(*instance, make_idastar_table<PancakeIDAStar>());
+      return search(idastar, record, format);
+    }
+    else if (is_pidastar) {
+      PancakePIDAStar &pidastar =
+        *new PancakePIDAStar(*instance,
+                        get_num_threads("PIDA_STAR_THREADS"),
+                        get_pidastar_split_depth());
+      return search(pidastar, record, format);
     }
     else if (is_switchback) {
-      PancakeSwitchback &switchback = *new PancakeSwitchback(*instance);
-      search(switchback);
+      PancakeSwitchback &switchback =
+        *new PancakeSwitchback(*instance,
+                               get_switchback_memory_budget());
+      return search(switchback, record, format);
     }
   }
 
   return 0;
 }
+
+
+// Solves a single instance, in this process.  Running out of memory, as
+// under a batch's memory limit, gets its own exit status.
+static int solve_instance(const string &domain_string,
+                          const string &alg_string,
+                          SearchStatistics::Format format,
+                          const char *path)
+{
+  try {
+    return solve(domain_string, alg_string, format, path);
+  }
+  catch (const std::bad_alloc &) {
+    cout.flush();
+    cerr << "error: out of memory" << endl;
+    return BatchRunner::out_of_memory_status;
+  }
+}
+
+
+// The path of this program, to run again for each instance of a batch.
+static string get_program_path(const char *argv0)
+{
+  char buf[4096];
+  const ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf));
+  if (n > 0 && static_cast<size_t>(n) < sizeof(buf))
+    return string(buf, n);
+  return argv0;
+}
+
+
+// Parses a positive count or limit for a command line option.
+template <class T>
+static bool parse_option(const char *arg, T &value)
+{
+  istringstream in(arg);
+  return (in >> value) && in.eof() && value > 0;
+}
+
+
+int main(int argc, char * argv[])
+{
+  if (argc < 3) {
+    print_usage(cerr, argv[0]);
+    return 1;
+  }
+
+  const string domain_string(argv[1]);
+  const string alg_string(argv[2]);
+
+  const bool is_tiles = domain_string == "tiles";
+  const bool is_tiles_static = domain_string == "tiles_static_abstraction";
+  const bool is_tiles_pdb = domain_string == "tiles_pdb";
+  const bool is_macro_tiles = domain_string == "macro_tiles";
+  const bool is_glued_tiles = domain_string == "glued_tiles";
+  const bool is_pancake = domain_string == "pancake";
+
+  const bool is_astar = alg_string == "astar";
+  const bool is_hastar = alg_string == "hastar";
+  const bool is_hdastar = alg_string == "hdastar";
+  const bool is_hidastar = alg_string == "hidastar";
+  const bool is_idastar = alg_string == "idastar";
+  const bool is_pidastar = alg_string == "pidastar";
+  const bool is_mm = alg_string == "mm";
+  const bool is_frontier_astar = alg_string == "frontierastar";
+  const bool is_external_astar = alg_string == "externalastar";
+  const bool is_switchback = alg_string == "switchback";
+
+  // ############################################################
+  // Argument Error Checking
+  // ############################################################
+  if (!is_tiles && !is_tiles_static && !is_tiles_pdb && !is_macro_tiles && !is_pancake && !is_glued_tiles) {
+    cerr << "error: invalid domain specified" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+  if (!is_astar && !is_hastar && !is_hdastar && !is_hidastar && !is_idastar && !is_pidastar && !is_mm && !is_frontier_astar && !is_external_astar && !is_switchback) {
+    cerr << "error: invalid algorithm specified" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+  if (is_frontier_astar && !is_tiles && !is_tiles_static && !is_pancake) {
+    cerr << "error: frontierastar only works with tiles, tiles_static_abstraction and pancake" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+  if (is_external_astar && !is_tiles && !is_tiles_static && !is_tiles_pdb && !is_pancake) {
+    cerr << "error: externalastar only works with tiles, tiles_static_abstraction, tiles_pdb and pancake" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+  if (getenv("ANYTIME_WEIGHT") != NULL && !is_astar) {
+    cerr << "error: ANYTIME_WEIGHT only works with astar" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+  if (is_tiles_pdb && !is_astar && !is_hdastar && !is_idastar && !is_pidastar && !is_mm && !is_external_astar) {
+    cerr << "error: tiles_pdb only works with astar, hdastar, idastar, pidastar, mm and externalastar" << endl;
+    print_usage(cerr, argv[0]);
+    exit (1);
+  }
+
+  unsigned num_workers = 0;
+  double time_limit = 0;
+  unsigned long memory_limit_mb = 0;
+  SearchStatistics::Format format = SearchStatistics::text_format;
+  const char *format_arg = NULL;
+  vector<string> args;
+  for (int i = 3; i < argc; i += 1) {
+    const string arg(argv[i]);
+    bool ok = true;
+    if (arg == "-j" || arg == "-t" || arg == "-m" || arg == "-f") {
+      if (i + 1 == argc)
+        ok = false;
+      else if (arg == "-f")
+        ok = SearchStatistics::parse_format(format_arg = argv[++i], format);
+      else if (arg == "-j")
+        ok = parse_option(argv[++i], num_workers);
+      else if (arg == "-t")
+        ok = parse_option(argv[++i], time_limit);
+      else
+        ok = parse_option(argv[++i], memory_limit_mb);
+    }
+    else {
+      args.push_back(arg);
+    }
+
+    if (!ok) {
+      cerr << "error: invalid " << arg << " option" << endl;
+      print_usage(cerr, argv[0]);
+      exit (1);
+    }
+  }
+
+  // ############################################################
+  // A single instance, solved in this process
+  // ############################################################
+  const bool has_options = num_workers > 0 || time_limit > 0 || memory_limit_mb > 0;
+  if (!has_options && args.empty())
+    return solve_instance(domain_string, alg_string, format, NULL);
+
+  vector<string> paths;
+  if (!BatchRunner::list_instances(args, paths, cerr))
+    exit (1);
+
+  if (!has_options && args.size() == 1 && paths.size() == 1 && paths[0] == args[0])
+    return solve_instance(domain_string, alg_string, format, args[0].c_str());
+
+  // ############################################################
+  // A batch of instances
+  // ############################################################
+  if (paths.empty()) {
+    cerr << "error: no instances given" << endl;
+    exit (1);
+  }
+  if (num_workers == 0) {
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_workers = num_cpus > 0 ? num_cpus : 1;
+  }
+
+  // Each instance is solved by running this program on it alone.
+  vector<string> command;
+  command.push_back(get_program_path(argv[0]));
+  command.push_back(domain_string);
+  command.push_back(alg_string);
+  if (format_arg != NULL) {
+    command.push_back("-f");
+    command.push_back(format_arg);
+  }
+
+  BatchRunner runner(command,
+                     num_workers,
+                     time_limit,
+                     memory_limit_mb);
+  if (format != SearchStatistics::text_format) {
+    SearchStatistics base;
+    base.set_string("domain", domain_string);
+    base.set_string("algorithm", alg_string);
+    runner.set_record_format(format, base);
+  }
+  const unsigned num_unfinished = runner.run(paths);
+  // The summary is not a record.
+  runner.output_statistics(format == SearchStatistics::text_format ? cout : cerr);
+
+  return num_unfinished == 0 ? 0 : 1;
+}
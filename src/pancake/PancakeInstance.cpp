@@ -64,68 +64,145 @@ PancakeInstance14::PancakeInstance14(const PancakeState14 &s,
 				     const PancakeState14 &g)
 	: start(s),
 	  goal(g),
-	  abstraction_order(simple_abstraction_order(s))
+	  abstraction_order(simple_abstraction_order(s)),
+	  goal_number(number_by_position(g)),
+	  start_number(number_by_position(s))
 { }
 
+PancakeInstance14::PancakeInstance14(const PancakeInstance14 &,
+				     const PancakeState14 &s,
+				     const PancakeState14 &g)
+	: start(s),
+	  goal(g),
+	  abstraction_order(simple_abstraction_order(s)),
+	  goal_number(number_by_position(g)),
+	  start_number(number_by_position(s))
+{ }
 
-PancakeNode14 *PancakeInstance14::child(const PancakeState14 &new_state,
-					PancakeCost new_g,
-					const PancakeNode14 &parent,
-					boost::pool<> &node_pool)
+
+PancakeInstance14::Numbering
+PancakeInstance14::number_by_position(const PancakeState14 &s)
 {
-	assert(!(parent.get_state() == new_state));
-	assert((parent.get_parent() == NULL)
-	       || !(new_state == parent.get_parent()->get_state()));
+	Numbering number;
+	number.assign(-1);
+	for (unsigned int i = 0; i < s.size(); i += 1)
+		if (s[i] >= 0)
+			number[s[i] + 1] = i + 1;
+	number[plate + 1] = plate;
+
+	return number;
+}
+
 
-	PancakeNode14 *child_node =
-		new (node_pool.malloc()) PancakeNode14(new_state,
-						       new_g,
+template <class NodeT, class Buffer>
+void PancakeInstance14::make_children(const NodeT &parent,
+				      const Buffer &states,
+				      std::vector<NodeT*> &succs,
+				      typename NodeT::Pool &node_pool)
+{
+	succs.clear();
+	for (unsigned int i = 0; i < states.size(); i += 1) {
+		assert(!(parent.get_state() == states[i].state));
+		assert((parent.get_parent() == NULL)
+		       || !(states[i].state == parent.get_parent()->get_state()));
+
+		NodeT *child_node =
+			new (node_pool.malloc()) NodeT(states[i].state,
+						       states[i].g,
 						       0,
 						       &parent);
-
-	return child_node;
+		succs.push_back(child_node);
+	}
 }
 
 
-void PancakeInstance14::compute_successors(const PancakeNode14 &node,
-					   std::vector<PancakeNode14*> &succs,
-					   boost::pool<> &node_pool)
+template <class NodeT>
+void PancakeInstance14::compute_successor_states(const NodeT &node,
+						 Successors &succs) const
 {
-	const PancakeNode14 *gp = node.get_parent();
+	const NodeT *gp = node.get_parent();
 
 	succs.clear();
 	for (unsigned int n = 2; n <= 14; n += 1) {
 		const PancakeState14 child_state = node.get_state().flip(n);
 		if ((!gp || gp->get_state() != child_state)
-		    && node.get_state() != child_state) {
-			PancakeNode14 *child_node = child(child_state,
-							  node.get_g() + 1,
-							  node,
-							  node_pool);
-			succs.push_back(child_node);
-		}
+		    && node.get_state() != child_state)
+			succs.push_back(child_state, node.get_g() + 1, n);
 	}
 }
 
 
+template <class NodeT>
+void PancakeInstance14::compute_predecessor_states(const NodeT &n,
+						   Successors &succs) const
+{
+	compute_successor_states(n, succs);
+}
+
+
+template <class NodeT>
+void PancakeInstance14::compute_successors(const NodeT &node,
+					   std::vector<NodeT*> &succs,
+					   typename NodeT::Pool &node_pool)
+{
+	Successors states;
+	compute_successor_states(node, states);
+	make_children(node, states, succs, node_pool);
+}
+
+
+template <class NodeT>
 void
-PancakeInstance14::compute_predecessors(const PancakeNode14 &n,
-					std::vector<PancakeNode14*> &succs,
-					boost::pool<> &node_pool)
+PancakeInstance14::compute_predecessors(const NodeT &n,
+					std::vector<NodeT*> &succs,
+					typename NodeT::Pool &node_pool)
 {
 	compute_successors(n, succs, node_pool);
 }
 
-void PancakeInstance14::compute_heuristic(const PancakeNode14 &parent,
-					  PancakeNode14 &child) const
+PancakeCost PancakeInstance14::count_gaps(const PancakeState14 &s) const
+{
+	return count_gaps(s, goal_number);
+}
+
+PancakeCost PancakeInstance14::count_gaps(const PancakeState14 &s,
+					  const Numbering &number)
+{
+	PancakeCost gaps = 0;
+	for (unsigned int i = 0; i + 1 < s.size(); i += 1)
+		gaps += gap(number, s[i], s[i + 1]);
+	gaps += gap(number, s[s.size() - 1], plate);
+
+	return gaps;
+}
+
+
+template <class NodeT>
+void PancakeInstance14::compute_heuristic(const NodeT &parent,
+					  NodeT &child) const
+{
+	// Flipping the top n pancakes only changes the adjacency
+	// between positions n - 1 and n, where the top pancake of the
+	// parent lands.
+	const PancakeState14 &p = parent.get_state();
+	const unsigned int n = p.last_difference(child.get_state()) + 1;
+	const Pancake below = n < p.size() ? p[n] : plate;
+
+	child.set_h(parent.get_h() - gap(goal_number, p[n - 1], below)
+		    + gap(goal_number, p[0], below));
+	assert(child.get_h() == count_gaps(child.get_state()));
+}
+
+template <class NodeT>
+void PancakeInstance14::compute_heuristic(NodeT &child) const
 {
-	compute_heuristic(child);
+	child.set_h(count_gaps(child.get_state()));
 }
 
-void PancakeInstance14::compute_heuristic(PancakeNode14 &child) const
+template <class NodeT>
+void PancakeInstance14::compute_start_heuristic(NodeT &child) const
 {
-	// Just use h(n) = 0 for now, I guess.
-	child.set_h(0);
+	child.set_h(count_gaps(child.get_state(), start_number));
 }
 
 bool
@@ -165,9 +242,96 @@ PancakeState14 PancakeInstance14::abstract(unsigned int level,
 }
 
 
+PermutationRank PancakeInstance14::num_ranks(unsigned int level) const
+{
+	unsigned int nsymbols = 0;
+	for (unsigned int c = 1; c <= 14; c += 1)
+		if (!should_abstract(level, c))
+			nsymbols += 1;
+
+	return num_k_permutations(14, nsymbols);
+}
+
+
+PermutationRank PancakeInstance14::rank(unsigned int level,
+					const PancakeState14 &s) const
+{
+	// The symbols are the unobscured pancakes in increasing order.
+	// Every state at a level has the same unobscured pancakes, so
+	// they can be read off the state itself.
+	boost::array<unsigned char, 15> position_of;
+	unsigned int present = 0;
+	for (unsigned int i = 0; i < s.size(); i += 1) {
+		const Pancake c = s[i];
+		if (c > 0) {
+			position_of[c] = i;
+			present |= 1u << c;
+		}
+	}
+
+	boost::array<unsigned char, 14> places;
+	unsigned int nsymbols = 0;
+	for (unsigned int c = 1; c <= 14; c += 1)
+		if (present & (1u << c))
+			places[nsymbols++] = position_of[c];
+
+	const PermutationRank r = rank_k_permutation(14, nsymbols, places);
+	assert(r < num_ranks(level));
+	return r;
+}
+
+
+PancakeState14 PancakeInstance14::unrank(unsigned int level,
+					 PermutationRank r) const
+{
+	assert(r < num_ranks(level));
+
+	boost::array<Pancake, 14> symbols;
+	unsigned int nsymbols = 0;
+	for (unsigned int c = 1; c <= 14; c += 1)
+		if (!should_abstract(level, c))
+			symbols[nsymbols++] = c;
+
+	boost::array<unsigned char, 14> places;
+	unrank_k_permutation(14, nsymbols, r, places);
+
+	boost::array<Pancake, 14> cakes;
+	cakes.assign(-1);
+	for (unsigned int j = 0; j < nsymbols; j += 1)
+		cakes[places[j]] = symbols[j];
+
+	return PancakeState14(cakes);
+}
+
+
 std::ostream &operator<< (std::ostream &out, const PancakeInstance14 &inst)
 {
 	out << "Start: " << inst.get_start_state() << std::endl;
 	out << "Goal: " << inst.get_goal_state() << std::endl;
+	out << "Initial gap heuristic estimate: "
+	    << static_cast<unsigned int>(
+		    inst.count_gaps(inst.get_start_state()))
+	    << std::endl;
 	return out;
 }
+
+
+// The domain can be searched with either node layout.
+#define INSTANTIATE_PANCAKE_INSTANCE14(NodeT)				\
+	template void PancakeInstance14::compute_successors<NodeT>(	\
+		const NodeT &, std::vector<NodeT*> &, NodeT::Pool &);	\
+	template void PancakeInstance14::compute_predecessors<NodeT>(	\
+		const NodeT &, std::vector<NodeT*> &, NodeT::Pool &);	\
+	template void PancakeInstance14::compute_heuristic<NodeT>(	\
+		const NodeT &, NodeT &) const;				\
+	template void PancakeInstance14::compute_heuristic<NodeT>(	\
+		NodeT &) const;						\
+	template void PancakeInstance14::compute_start_heuristic<NodeT>( \
+		NodeT &) const;						\
+	template void PancakeInstance14::compute_successor_states<NodeT>( \
+		const NodeT &, Successors &) const;			\
+	template void PancakeInstance14::compute_predecessor_states<NodeT>( \
+		const NodeT &, Successors &) const;
+
+INSTANTIATE_PANCAKE_INSTANCE14(PancakeNode14)
+INSTANTIATE_PANCAKE_INSTANCE14(CompactPancakeNode14)
@@ -16,6 +16,8 @@
 
 #include "pancake/PancakeState.hpp"
 #include "pancake/PancakeNode.hpp"
+#include "search/SuccessorBuffer.hpp"
+#include "util/PermutationRank.hpp"
 
 #include <iostream>
 
@@ -38,22 +40,59 @@ private:
 	static AbstractionOrder
 	simple_abstraction_order(const PancakeState14 &);
 
-	// Wrap a child state in a new node.
-	PancakeNode14 *child(const PancakeState14 &new_state,
-			     PancakeCost new_g,
-			     const PancakeNode14 &parent,
-			     boost::pool<> &node_pool);
+	// Wrap each of the given successor states in a new node.
+	template <class NodeT, class Buffer>
+	void make_children(const NodeT &parent,
+			   const Buffer &states,
+			   std::vector<NodeT*> &succs,
+			   typename NodeT::Pool &node_pool);
 
 
+	// The plate under the stack acts as a pancake one larger than
+	// the largest.
+	static const Pancake plate = 15;
+
+	// Is there a gap between the two adjacent pancakes?
+	static inline PancakeCost gap(Pancake above, Pancake below) {
+		if (above < 0 || below < 0)
+			return 0;
+		return above - below == 1 || below - above == 1 ? 0 : 1;
+	}
+
+	// The pancakes renumbered by their positions in a stack, so
+	// that the gaps can be counted toward any stack.  number[p + 1]
+	// is one more than the position of pancake p, counting from the
+	// top; -1 (abstracted away) and the plate keep their numbers.
+	typedef boost::array<Pancake, plate + 2> Numbering;
+
+	static Numbering number_by_position(const PancakeState14 &s);
+
+	// Is there a gap between the two adjacent pancakes, once they
+	// are renumbered?
+	static inline PancakeCost gap(const Numbering &number,
+				      Pancake above, Pancake below) {
+		return gap(number[above + 1], number[below + 1]);
+	}
+
 	// Test if pancake number [i] should be abstracted away.
 	bool should_abstract(unsigned int level, unsigned int i) const;
 
 public:
+	// Flips of 2 through 14 pancakes.
+	typedef SuccessorBuffer<PancakeState14, PancakeCost, 13> Successors;
 
 	// Create a new pancake puzzle instance
 	PancakeInstance14(const PancakeState14 &start,
 			  const PancakeState14 &goal);
 
+	// Create an instance between the given states, like the given
+	// one.  There is nothing to share, but the searchers that split
+	// a problem into smaller ones (FrontierAStar) make their
+	// instances this way.
+	PancakeInstance14(const PancakeInstance14 &other,
+			  const PancakeState14 &start,
+			  const PancakeState14 &goal);
+
 	// Test if the given state is the goal state.
 	inline bool is_goal(const PancakeState14 &s) const {
 		return s == goal;
@@ -64,28 +103,102 @@ public:
 		return 1;
 	}
 
+	// Compute the successor states of the given node, with their g
+	// values, without allocating nodes for them.  The operator of
+	// each successor is the number of pancakes flipped.
+	template <class NodeT>
+	void compute_successor_states(const NodeT &n,
+				      Successors &succs) const;
+
+	template <class NodeT>
+	void compute_predecessor_states(const NodeT &n,
+					Successors &succs) const;
+
 	// Compute the successors of the given node.
 	//
 	// Note that this does not assign the h values for the
 	// successor nodes: that must be done by the caller.
-	void compute_successors(const PancakeNode14 &n,
-				std::vector<PancakeNode14*> &succs,
-				boost::pool<> &node_pool);
+	template <class NodeT>
+	void compute_successors(const NodeT &n,
+				std::vector<NodeT*> &succs,
+				typename NodeT::Pool &node_pool);
 
 	// Compute the predecessors of the given node.
 	//
 	// Note that this does not assign the h values for the
 	// successor nodes: that must be done by the caller.
-	void compute_predecessors(const PancakeNode14 &n,
-				  std::vector<PancakeNode14*> &succs,
-				  boost::pool<> &node_pool);
+	template <class NodeT>
+	void compute_predecessors(const NodeT &n,
+				  std::vector<NodeT*> &succs,
+				  typename NodeT::Pool &node_pool);
+
+
+	// Compute/fill-in the heuristic value for a child node.  This is
+	// the gap heuristic: the number of adjacent pancakes, counting
+	// the plate as the largest one, whose sizes are not consecutive.
+	// Each flip changes at most one adjacency, so with a parent the
+	// child's value is found in constant time.
+	template <class NodeT>
+	void compute_heuristic(const NodeT &parent,
+			       NodeT &child) const;
+
+	template <class NodeT>
+	void compute_heuristic(NodeT &child) const;
+
+	// Compute/fill-in a heuristic for the cost from the start state
+	// to the child's, for searching backward from the goal.  This is
+	// the gap heuristic with the pancakes renumbered by their
+	// positions in the start state.
+	template <class NodeT>
+	void compute_start_heuristic(NodeT &child) const;
+
+
+	// In-place moves, for searchers that keep a single state and
+	// change it (IDAStar).  A move is the number of pancakes
+	// flipped, and undoes itself.  The gap heuristic is updated as
+	// in compute_heuristic().  The move state is the last flip,
+	// which is not repeated.
+	typedef unsigned char Move;
+	typedef boost::array<Move, 13> Moves;
+	typedef Move MoveState;
+	static const MoveState initial_move_state = 0;
+
+	inline unsigned compute_moves(const PancakeState14 &s, MoveState last,
+				      Moves &moves) const {
+		unsigned int num = 0;
+		for (unsigned int n = 2; n <= 14; n += 1)
+			if (n != last)
+				moves[num++] = n;
+		return num;
+	}
 
+	inline MoveState next_move_state(const PancakeState14 &s,
+					 MoveState last, Move n) const {
+		return n;
+	}
 
-	// Compute/fill-in the heuristic value for a child node.
-	void compute_heuristic(const PancakeNode14 &parent,
-			       PancakeNode14 &child) const;
+	inline Move apply_move(PancakeState14 &s, Move n,
+			       PancakeCost &h) const {
+		const Pancake below = n < s.size() ? s[n] : plate;
+		h = h - gap(goal_number, s[n - 1], below)
+			+ gap(goal_number, s[0], below);
+		s.flip_in_place(n);
+		return n;
+	}
+
+	inline void undo_move(PancakeState14 &s, Move undo) const {
+		s.flip_in_place(undo);
+	}
 
-	void compute_heuristic(PancakeNode14 &child) const;
+
+	// Count the gaps in the given stack, toward the goal.  Gaps
+	// next to an obscured pancake are not counted.
+	PancakeCost count_gaps(const PancakeState14 &s) const;
+
+	// Count the gaps in the given stack, toward the stack that
+	// gave the numbering.
+	static PancakeCost count_gaps(const PancakeState14 &s,
+				      const Numbering &number);
 
 
 	// Access the start state.
@@ -106,10 +219,30 @@ public:
 		return level <= num_abstraction_levels;
 	}
 
+
+	// The number of distinct states at the given level.  A state at
+	// a level is a placement of the level's unobscured pancakes, so
+	// these are ranked as k-permutations of the 14 positions.
+	PermutationRank num_ranks(unsigned level) const;
+
+
+	// Map a state at the given level to a unique integer in
+	// [0, num_ranks(level)).
+	PermutationRank rank(unsigned level, const PancakeState14 &s) const;
+
+
+	// The inverse of rank().
+	PancakeState14 unrank(unsigned level, PermutationRank r) const;
+
 private:
 	const PancakeState14 start;
 	const PancakeState14 goal;
 	const AbstractionOrder abstraction_order;
+
+	// The pancakes numbered by their positions in the goal, and in
+	// the start state, for the gaps toward each.
+	const Numbering goal_number;
+	const Numbering start_number;
 };
 
 std::ostream &operator<< (std::ostream &, const PancakeInstance14 &);
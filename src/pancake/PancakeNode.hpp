@@ -7,6 +7,7 @@
  * \date 18-01-2010
  */
 
+#include "search/CompactNode.hpp"
 #include "search/Node.hpp"
 #include "pancake/PancakeTypes.hpp"
 #include "pancake/PancakeState.hpp"
@@ -15,6 +16,7 @@
 #define _PANCAKE_NODE_H_
 
 typedef Node<PancakeState14, PancakeCost> PancakeNode14;
+typedef CompactNode<PancakeState14, PancakeCost> CompactPancakeNode14;
 
 #endif // !_PANCAKE_NODE_H_
 
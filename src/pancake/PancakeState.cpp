@@ -95,10 +95,6 @@ PancakeState14::PancakeState14(void)
 PancakeState14::PancakeState14(boost::array<Pancake, 14> cs) : cakes(cs) {}
 
 
-PancakeState14::PancakeState14(const PancakeState14 &s)
-	: cakes(s.cakes) { }
-
-
 std::size_t PancakeState14::get_hash_value(void) const
 {
 	return boost::hash_range(cakes.begin(), cakes.end());
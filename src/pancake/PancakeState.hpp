@@ -11,8 +11,12 @@
 #define _PANCAKE_STATE_H_
 
 #include <boost/array.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
@@ -34,8 +38,9 @@ public:
 	// Make a new 14-pancake state from the given array.
 	PancakeState14(boost::array<Pancake, 14>);
 
-	// Copy a pancake state.
-	PancakeState14(const PancakeState14 &s);
+	// The copy constructor and assignment are the implicit ones, which
+	// keeps states trivially copyable, as raw bytes in state files and
+	// heuristic caches.
 
 	// Gets the pancake at the given index.
 	inline Pancake operator[] (unsigned int i) const {
@@ -48,6 +53,31 @@ public:
 	// Flips the top [n] pancakes.
 	PancakeState14 flip(unsigned int n) const;
 
+	// Flips the top [n] pancakes in place.
+	inline void flip_in_place(unsigned int n) {
+		std::reverse(cakes.begin(), cakes.begin() + n);
+	}
+
+	// Gets the deepest position at which the two states differ.  If
+	// [other] is a flip of this state then this is the flip size
+	// minus one.  The states must differ.
+	inline unsigned int last_difference(const PancakeState14 &other) const {
+		// Compare the stack as two overlapping words: positions
+		// 0-7 and positions 6-13.
+		boost::uint64_t top, other_top, bottom, other_bottom;
+		memcpy(&top, &cakes[0], sizeof(top));
+		memcpy(&other_top, &other.cakes[0], sizeof(other_top));
+		memcpy(&bottom, &cakes[6], sizeof(bottom));
+		memcpy(&other_bottom, &other.cakes[6], sizeof(other_bottom));
+
+		const boost::uint64_t diff_bottom = bottom ^ other_bottom;
+		if (diff_bottom != 0)
+			return 6 + last_byte(diff_bottom);
+
+		assert((top ^ other_top) != 0);
+		return last_byte(top ^ other_top);
+	}
+
 	// Equality
 	bool operator ==(const PancakeState14 &other) const;
 
@@ -65,6 +95,15 @@ public:
 	}
 
 private:
+	// The index, in memory order, of the last nonzero byte of a word.
+	static inline unsigned int last_byte(boost::uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return __builtin_ctzll(word) / 8;
+#else
+		return (63 - __builtin_clzll(word)) / 8;
+#endif
+	}
+
 	// The pancake numbers.
 	boost::array<Pancake, 14> cakes;
 };
@@ -2,79 +2,273 @@
 #define _BUCKET_PRIORITY_QUEUE_HPP_
 
 
+#include <algorithm>
 #include <cassert>
-#include <list>
+#include <iostream>
 #include <vector>
 
-#include <boost/integer_traits.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
 
 
+//! The priority of a node on an f-ordered open list: its f-value.
 template <class Node>
-class BucketPriorityQueue
+struct FPriority
 {
-private:
-  unsigned num_elems;
-  unsigned first_bucket;
-
-  typedef std::vector<Node *> Bin;
-  typedef std::vector<Bin> Bucket;
-
-  std::vector<Bucket> store;
+  unsigned operator ()(const Node &n) const
+  {
+    return n.get_f();
+  }
+};
 
 
+/*! \brief An f-ordered open list, breaking ties in favor of high g.
+
+    Nodes are kept in bins indexed by (f, g).  Each bin is an unordered
+    array of nodes; every node records its index within its bin (its
+    "open index"), so a node can be removed from the middle of a bin
+    in constant time by moving the bin's last node into its place.
+
+    Which bins are nonempty is tracked by two-level occupancy bitmaps:
+    one over f-values, and one over g-values for each f-value.  Finding
+    the minimum is thus a couple of bit scans, regardless of how the
+    costs are spread out.
+
+    Bins are stored as lists of fixed-size chunks.  When a bin shrinks
+    past a chunk boundary the chunk is recycled, so drained bins do not
+    hold on to their peak memory.
+
+    \tparam Node  The type of the search node.  Beyond get_f() and
+                  get_g(), nodes must provide get_open_index() and
+                  set_open_index(), for the queue's exclusive use while
+                  the node is on the queue.
+    \tparam Priority  The function of a node that orders the buckets in
+                      place of its f-value.  It may have state, which
+                      can only change while the queue is empty.
+*/
+template <class Node, class Priority = FPriority<Node> >
+class BucketPriorityQueue : boost::noncopyable
+{
 public:
+    /*! A handle to a node in the queue.  It remains valid until the
+        node is popped or erased, regardless of other operations on
+        the queue.
+     */
     struct ItemPointer
     {
-      ItemPointer(unsigned short bucket_num,
-                  unsigned short bin_num,
-                  unsigned idx)
-        : bucket_num(bucket_num)
-        , bin_num(bin_num)
-        , idx(idx)
+      explicit ItemPointer(Node *node)
+        : node(node)
       {
       }
 
-      unsigned short bucket_num;
-      unsigned short bin_num;
-      unsigned idx;
+      Node *node;
     };
 
 
+private:
+  /*! A two-level bitmap over the naturals, supporting constant-time
+      search for the lowest and highest set bits for indices less than
+      64 * 64 (and a linear scan of summary words beyond that).
+   */
+  class OccupancyBitmap
+  {
+  private:
+    typedef boost::uint64_t Word;
+
+    // Bit i of words[w] is set iff index 64 * w + i is in the set.
+    std::vector<Word> words;
+    // Bit i of summary[s] is set iff words[64 * s + i] is nonzero.
+    std::vector<Word> summary;
+
+  public:
+    bool empty() const
+    {
+      for (unsigned s = 0; s < summary.size(); s += 1)
+        if (summary[s] != 0)
+          return false;
+      return true;
+    }
+
+    bool test(unsigned i) const
+    {
+      return i / 64 < words.size() && (words[i / 64] & bit(i % 64)) != 0;
+    }
+
+    void set(unsigned i)
+    {
+      const unsigned w = i / 64;
+      if (w >= words.size()) {
+        words.resize(w + 1, 0);
+        summary.resize(w / 64 + 1, 0);
+      }
+      words[w] |= bit(i % 64);
+      summary[w / 64] |= bit(w % 64);
+    }
+
+    void reset(unsigned i)
+    {
+      assert(test(i));
+      const unsigned w = i / 64;
+      words[w] &= ~bit(i % 64);
+      if (words[w] == 0)
+        summary[w / 64] &= ~bit(w % 64);
+    }
+
+    unsigned first() const
+    {
+      assert(!empty());
+      unsigned s = 0;
+      while (summary[s] == 0)
+        s += 1;
+      const unsigned w = 64 * s + lowest_bit(summary[s]);
+      return 64 * w + lowest_bit(words[w]);
+    }
+
+    unsigned last() const
+    {
+      assert(!empty());
+      unsigned s = summary.size() - 1;
+      while (summary[s] == 0)
+        s -= 1;
+      const unsigned w = 64 * s + highest_bit(summary[s]);
+      return 64 * w + highest_bit(words[w]);
+    }
+
+    void clear()
+    {
+      words.clear();
+      summary.clear();
+    }
+
+  private:
+    static Word bit(unsigned i)
+    {
+      return static_cast<Word>(1) << i;
+    }
+
+    static unsigned lowest_bit(Word w)
+    {
+      assert(w != 0);
+#ifdef __GNUC__
+      return __builtin_ctzll(w);
+#else
+      unsigned i = 0;
+      while ((w & 1) == 0) {
+        w >>= 1;
+        i += 1;
+      }
+      return i;
+#endif
+    }
+
+    static unsigned highest_bit(Word w)
+    {
+      assert(w != 0);
+#ifdef __GNUC__
+      return 63 - __builtin_clzll(w);
+#else
+      unsigned i = 0;
+      while (w >>= 1)
+        i += 1;
+      return i;
+#endif
+    }
+  };
+
+
+  // The number of node pointers in each bin chunk.
+  static const unsigned chunk_size = 128;
+  // The number of free chunks kept around for reuse; chunks drained
+  // beyond this are returned to the system.
+  static const unsigned max_free_chunks = 256;
+
+  struct Bin
+  {
+    Bin()
+      : chunks()
+      , size(0)
+    {
+    }
+
+    Node *& operator [](unsigned i)
+    {
+      return chunks[i / chunk_size][i % chunk_size];
+    }
+
+    Node * operator [](unsigned i) const
+    {
+      return chunks[i / chunk_size][i % chunk_size];
+    }
+
+    std::vector<Node **> chunks;
+    unsigned size;
+  };
+
+  struct Bucket
+  {
+    std::vector<Bin> bins;       // indexed by g
+    OccupancyBitmap nonempty;    // g-values of the nonempty bins
+  };
+
+
+private:
+  Priority priority;
+
+  unsigned num_elems;
+
+  std::vector<Bucket> store;     // indexed by f
+  OccupancyBitmap nonempty;      // f-values of the nonempty buckets
+
+  std::vector<Node **> free_chunks;
+
+
 public:
-  BucketPriorityQueue()
-    : num_elems(0)
-    , first_bucket(boost::integer_traits<unsigned>::const_max)
+  BucketPriorityQueue(const Priority &priority = Priority())
+    : priority(priority)
+    , num_elems(0)
     , store()
+    , nonempty()
+    , free_chunks()
   {
     assert(empty());
   }
 
   ~BucketPriorityQueue()
   {
+    reset();
+    for (unsigned i = 0; i < free_chunks.size(); i += 1)
+      delete [] free_chunks[i];
   }
 
   ItemPointer push(Node *n)
   {
     num_elems += 1;
 
-    const unsigned bucket_num = n->get_f();
+    const unsigned bucket_num = priority(*n);
     if (bucket_num >= store.size())
       store.resize(bucket_num + 1);
-    assert(bucket_num < store.size());
- 
+
+    Bucket &bucket = store[bucket_num];
     const unsigned bin_num = n->get_g();
-    if (bin_num >= store[bucket_num].size())
-      store[bucket_num].resize(bin_num + 1);
-    assert(bin_num < store[bucket_num].size());
+    if (bin_num >= bucket.bins.size())
+      bucket.bins.resize(bin_num + 1);
 
-    store[bucket_num][bin_num].push_back(n);
-    
-    const unsigned idx = store[bucket_num][bin_num].size() - 1;
+    Bin &bin = bucket.bins[bin_num];
+    if (bin.size % chunk_size == 0) {
+      assert(bin.size / chunk_size == bin.chunks.size());
+      bin.chunks.push_back(allocate_chunk());
+    }
 
-    if (bucket_num < first_bucket)
-      first_bucket = bucket_num;
+    n->set_open_index(bin.size);
+    bin[bin.size] = n;
+    bin.size += 1;
 
-    ItemPointer item_ptr = ItemPointer(bucket_num, bin_num, idx);
+    if (bin.size == 1) {
+      bucket.nonempty.set(bin_num);
+      nonempty.set(bucket_num);
+    }
+
+    ItemPointer item_ptr = ItemPointer(n);
     assert(valid_item_pointer(item_ptr));
     return item_ptr;
   }
@@ -84,47 +278,7 @@ public:
     assert(!empty());
     assert(invariants_satisfied());
 
-    num_elems -= 1;
-
-    if (empty()) {
-      // entire priority queue has been exhausted
-      reset();
-      return;
-    }
-
-    assert(no_all_null_bins());
-    assert(!store[first_bucket].empty());
-    assert(!store[first_bucket].back().empty());
-
-    {
-      // Eliminate the last item in the bin, along with its
-      // immediately preceding and trailing NULL items.
-      Bin &bin = store[first_bucket].back();
-      while (!bin.empty() && bin.back() == NULL)
-        bin.pop_back();
-      bin.pop_back();
-      while (!bin.empty() && bin.back() == NULL)
-        bin.pop_back();
-
-      if (bin.empty())
-        bin.clear();
-    }
-
-    assert(no_all_null_bins());
-
-    {
-      // eliminate empty bins in the bucket
-      Bucket &bucket = store[first_bucket];
-      while (!bucket.empty() && bucket.back().empty())
-        bucket.pop_back();
-    }
-
-    assert(no_all_null_bins());
-    assert(no_trailing_empty_bins());
-
-    // Update the first bucket index
-    while (store[first_bucket].empty() && first_bucket < store.size() - 1)
-      first_bucket += 1;
+    remove(top());
 
     assert(invariants_satisfied());
   }
@@ -133,83 +287,28 @@ public:
   {
     assert(!empty());
     assert(invariants_satisfied());
-    assert(!store[first_bucket].empty());
-    assert(!store[first_bucket].back().empty());
-
-    // Because of the way element deletions are implemented in this
-    // priority queue, we may have to scan an entire bin to find a
-    // non-deleted element.
-    const Bin &bin = store[first_bucket].back();
-    assert(!bin_vals_all_null(bin));
-    for (typename Bin::const_reverse_iterator bin_it = bin.rbegin();
-         bin_it != bin.rend();
-         ++bin_it) {
-      if (*bin_it != NULL)
-        return *bin_it;
-    }
 
-    assert(false);
-    return NULL;
+    const Bucket &bucket = store[nonempty.first()];
+    const Bin &bin = bucket.bins[bucket.nonempty.last()];
+    assert(bin.size > 0);
+    return bin[bin.size - 1];
   }
 
   void erase(const ItemPointer &ptr)
   {
-    assert(no_all_null_bins());
-
-    // std::cerr << "erase!" << std::endl;
     assert(!empty());
     assert(valid_item_pointer(ptr));
 
-    num_elems -= 1;
-
-    if (empty()) {
-      reset();
-      return;
-    }
-
-    Bucket &bucket = store[ptr.bucket_num];
-    Bin &bin = store[ptr.bucket_num][ptr.bin_num];
-    bin[ptr.idx] = NULL;
-
-    bool all_null = bin_vals_all_null(bin);
-    if (all_null && bucket.size() == ptr.bin_num + 1u) {
-      // std::cerr << "bin at end to be popped" << std::endl;
-
-      // The bin at the end of the bucket has been entirely deleted.
-      // Get rid of trailing empty bins.
-      do {
-        bucket.pop_back();
-      } while (!bucket.empty() && bucket.back().empty());
-
-      if (bucket.empty() && ptr.bucket_num == first_bucket) {
-        // std::cerr << "first bucket to be updated" << std::endl;
+    remove(ptr.node);
 
-        // The first bucket has been emptied.  We need to find the new
-        // first bucket.
-        assert(!empty());
-        while (store[first_bucket].empty())
-          first_bucket += 1;
-      }
-    }
-    else if (all_null) {
-      // std::cerr << "non-last bin to be cleared" << std::endl;
-
-      // A bin somewhere in the bucket, but not at the end, has been
-      // entirely deleted.  Clear it out, but don't delete it, as
-      // deletion would invalidate any ItemPointers that have been
-      // handed out.
-      bin.clear();
-    }
-
-    assert(no_all_null_bins());
+    assert(invariants_satisfied());
   }
 
   Node * lookup(const ItemPointer &ptr)
   {
     assert(!empty());
     assert(valid_item_pointer(ptr));
-    Node *ret = store[ptr.bucket_num][ptr.bin_num][ptr.idx];
-    return ret;
+    return ptr.node;
   }
 
   bool empty() const
@@ -217,108 +316,200 @@ public:
     return num_elems == 0;
   }
 
+  const Priority & get_priority() const
+  {
+    return priority;
+  }
+
+  //! Changes the priority function, which the queue must be empty for.
+  void set_priority(const Priority &p)
+  {
+    assert(empty());
+    priority = p;
+  }
+
   unsigned size() const
   {
     return num_elems;
   }
 
+  /*! The smallest value of the given function of a node, such as
+      FPriority when the queue is ordered otherwise, over the nodes on
+      the queue, which must not be empty.  This visits every node.
+   */
+  template <class Function>
+  unsigned min_value(const Function &function) const
+  {
+    assert(!empty());
+    unsigned min = function(*top());
+    for (unsigned f = 0; f < store.size(); f += 1)
+      for (unsigned g = 0; g < store[f].bins.size(); g += 1) {
+        const Bin &bin = store[f].bins[g];
+        for (unsigned i = 0; i < bin.size; i += 1)
+          min = std::min(min, function(*bin[i]));
+      }
+    return min;
+  }
+
   void reset()
   {
+    for (unsigned f = 0; f < store.size(); f += 1)
+      for (unsigned g = 0; g < store[f].bins.size(); g += 1) {
+        Bin &bin = store[f].bins[g];
+        while (!bin.chunks.empty()) {
+          free_chunk(bin.chunks.back());
+          bin.chunks.pop_back();
+        }
+      }
+
     num_elems = 0;
-    first_bucket = boost::integer_traits<unsigned>::const_max;
     store.clear();
+    nonempty.clear();
   }
 
-private:
-  bool bin_vals_all_null(const Bin &bin) const
+  /*! \brief Removes all nodes, keeping the buckets and bins for reuse.
+
+      Unlike reset(), this only visits the nonempty bins, which makes it
+      cheap for a queue that is emptied after every small search.
+   */
+  void clear()
   {
-    for (unsigned i = 0; i < bin.size(); ++i)
-      if (bin[i] != NULL) {
-        return false;
+    while (!nonempty.empty()) {
+      const unsigned bucket_num = nonempty.first();
+      Bucket &bucket = store[bucket_num];
+      while (!bucket.nonempty.empty()) {
+        const unsigned bin_num = bucket.nonempty.first();
+        Bin &bin = bucket.bins[bin_num];
+        for (unsigned i = 0; i < bin.chunks.size(); i += 1)
+          free_chunk(bin.chunks[i]);
+        bin.chunks.clear();
+        bin.size = 0;
+        bucket.nonempty.reset(bin_num);
       }
-    return true;
+      nonempty.reset(bucket_num);
+    }
+
+    num_elems = 0;
+    assert(invariants_satisfied());
   }
 
-  bool no_all_null_bins() const
+private:
+  // Removes n by moving the last node of its bin into its place.
+  void remove(Node *n)
   {
-    for (unsigned buck_i = 0; buck_i < store.size(); buck_i += 1) {
-      for (unsigned bin_i = 0; bin_i < store[buck_i].size(); bin_i += 1) {
-        if (!store[buck_i][bin_i].empty() && bin_vals_all_null(store[buck_i][bin_i])) {
-          std::cerr << "error: bin " << bin_i << " in bucket " << buck_i
-                    << " is all NULL!" << std::endl;
-          return false;
-        }
-      }
+    const unsigned bucket_num = priority(*n);
+    const unsigned bin_num = n->get_g();
+    Bucket &bucket = store[bucket_num];
+    Bin &bin = bucket.bins[bin_num];
+
+    const unsigned idx = n->get_open_index();
+    assert(bin[idx] == n);
+
+    Node *last = bin[bin.size - 1];
+    bin[idx] = last;
+    last->set_open_index(idx);
+    bin.size -= 1;
+    num_elems -= 1;
+
+    if (bin.size % chunk_size == 0) {
+      free_chunk(bin.chunks.back());
+      bin.chunks.pop_back();
+    }
+
+    if (bin.size == 0) {
+      // Give back the chunk list's own storage, too.
+      std::vector<Node **>().swap(bin.chunks);
+      bucket.nonempty.reset(bin_num);
+      if (bucket.nonempty.empty())
+        nonempty.reset(bucket_num);
     }
-    return true;
   }
 
-  bool no_trailing_empty_bins() const
+  Node ** allocate_chunk()
   {
-    for (unsigned buck_i = 0; buck_i < store.size(); buck_i += 1) {
-      if (!store[buck_i].empty() && store[buck_i].back().empty())
-        return false;
-    }
-    return true;
+    if (free_chunks.empty())
+      return new Node *[chunk_size];
+
+    Node **chunk = free_chunks.back();
+    free_chunks.pop_back();
+    return chunk;
   }
 
-  bool size_is_accurate() const
+  void free_chunk(Node **chunk)
   {
-    if (num_elems != size())
-      return false;
+    if (free_chunks.size() < max_free_chunks)
+      free_chunks.push_back(chunk);
+    else
+      delete [] chunk;
+  }
 
+  bool size_is_accurate() const
+  {
     unsigned sum_num_elems = 0;
     for (unsigned buck_i = 0; buck_i < store.size(); buck_i += 1) {
-      for (unsigned bin_i = 0; bin_i < store[buck_i].size(); bin_i += 1) {
-        for (unsigned idx = 0; idx < store[buck_i][bin_i].size(); idx += 1) {
-          if (store[buck_i][bin_i][idx] != NULL)
-            sum_num_elems += 1;
-        }
-      }
+      for (unsigned bin_i = 0; bin_i < store[buck_i].bins.size(); bin_i += 1)
+        sum_num_elems += store[buck_i].bins[bin_i].size;
     }
 
     return sum_num_elems == num_elems;
   }
 
-  bool first_bucket_is_correct() const
+  bool bitmaps_are_correct() const
   {
-    if (empty() && first_bucket != boost::integer_traits<unsigned>::const_max)
-      return false;
-    if (!empty() && first_bucket >= store.size())
-      return false;
-
-    if (!empty()) {
-      for (unsigned i = 0; i < first_bucket; i += 1) {
-        if (!store[i].empty())
+    for (unsigned buck_i = 0; buck_i < store.size(); buck_i += 1) {
+      const Bucket &bucket = store[buck_i];
+      bool bucket_nonempty = false;
+      for (unsigned bin_i = 0; bin_i < bucket.bins.size(); bin_i += 1) {
+        const bool bin_nonempty = bucket.bins[bin_i].size > 0;
+        if (bin_nonempty != bucket.nonempty.test(bin_i)) {
+          std::cerr << "error: bin " << bin_i << " in bucket " << buck_i
+                    << " has the wrong occupancy bit!" << std::endl;
           return false;
+        }
+        bucket_nonempty = bucket_nonempty || bin_nonempty;
       }
+      if (bucket_nonempty != nonempty.test(buck_i))
+        return false;
     }
+    return empty() == nonempty.empty();
+  }
 
+  bool open_indices_are_correct() const
+  {
+    for (unsigned buck_i = 0; buck_i < store.size(); buck_i += 1)
+      for (unsigned bin_i = 0; bin_i < store[buck_i].bins.size(); bin_i += 1) {
+        const Bin &bin = store[buck_i].bins[bin_i];
+        if (bin.chunks.size() != (bin.size + chunk_size - 1) / chunk_size)
+          return false;
+        for (unsigned idx = 0; idx < bin.size; idx += 1)
+          if (bin[idx]->get_open_index() != idx)
+            return false;
+      }
     return true;
-   }
+  }
 
 public:
   bool valid_item_pointer(const ItemPointer &ptr) const
   {
+    const Node *n = ptr.node;
+    const unsigned bucket_num = priority(*n);
+    const unsigned bin_num = n->get_g();
+    const unsigned idx = n->get_open_index();
+
     return
-      ptr.bucket_num < store.size() &&
-      ptr.bin_num < store[ptr.bucket_num].size() &&
-      ptr.idx < store[ptr.bucket_num][ptr.bin_num].size();
+      bucket_num < store.size() &&
+      bin_num < store[bucket_num].bins.size() &&
+      idx < store[bucket_num].bins[bin_num].size &&
+      store[bucket_num].bins[bin_num][idx] == n;
   }
 
   bool invariants_satisfied() const
   {
     if (!size_is_accurate())
       return false;
-    if (!no_all_null_bins())
-      return false;
-    if (!no_trailing_empty_bins())
-      return false;
-    if (!first_bucket_is_correct())
-      return false;
-    if (!empty() && store[first_bucket].empty())
+    if (!bitmaps_are_correct())
       return false;
-    if (!empty() && store[first_bucket].back().empty())
+    if (!open_indices_are_correct())
       return false;
 
     return true;
@@ -0,0 +1,620 @@
+#ifndef _CLOSED_TABLE_HPP_
+#define _CLOSED_TABLE_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*! \brief A flat, open-addressing hash table from search nodes to
+    values, keyed by the nodes' states.
+
+    This is laid out like Google's SwissTable: a byte array of control
+    bytes sits alongside a flat array of (Node *, Value) slots.  A
+    control byte is either empty, deleted, or holds 7 bits of the
+    slot's hash.  Probing compares a whole group of 16 control bytes
+    against the wanted fingerprint at once (with SSE2 when available),
+    so the nodes themselves are only dereferenced on a fingerprint
+    match, which is nearly always the node being looked for.
+
+    Lookups can be done either by node or directly by state, so callers
+    need not build a dummy node to search for a state.
+
+    Growing the table is one linear pass over the two flat arrays, with
+    no per-entry allocation.  As with boost::unordered_map, insertion
+    may invalidate iterators.
+
+    When the states to be stored have a perfect hash into a small range
+    (see use_perfect_hash()), the table can instead index the slots
+    directly by that hash, with no probing and no fingerprints.
+
+    Clearing the table takes constant time, so that a searcher can
+    reuse one table for many small searches without paying for its
+    capacity each time.  Each group of slots is stamped with the
+    generation in which its control bytes were last written, and
+    clear() just starts a new generation: a group from an older one
+    reads as empty, and its control bytes are emptied when something
+    is next inserted into it.
+
+    \tparam NodeT   The type of the search node, providing get_state()
+    \tparam ValueT  The type of the values associated with the nodes
+*/
+template <
+  class NodeT,
+  class ValueT
+  >
+class ClosedTable : boost::noncopyable
+{
+public:
+  typedef NodeT Node;
+  typedef typename Node::State State;
+  typedef ValueT Value;
+  typedef std::pair<Node *, Value> value_type;
+  typedef boost::function<std::size_t (const State &)> PerfectHash;
+
+
+private:
+  typedef signed char Control;
+
+  static const Control empty_slot = -128;
+  static const Control deleted_slot = -2;
+  static const std::size_t group_size = 16;
+  static const std::size_t not_found = static_cast<std::size_t>(-1);
+
+  std::vector<Control> ctrl;
+  std::vector<value_type> slots;
+
+  std::size_t num_elems;
+  std::size_t num_deleted;
+  std::size_t group_mask;
+
+  // When set, the slot of a state is given by this function.
+  PerfectHash perfect_hash;
+
+  // The generation of each group's control bytes, and the current
+  // one.  Groups from other generations are empty.
+  std::vector<boost::uint32_t> group_generation;
+  boost::uint32_t generation;
+
+
+  template <class Table, class Reference, class Pointer>
+  class basic_iterator
+  {
+    friend class ClosedTable;
+    template <class T, class R, class P> friend class basic_iterator;
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename ClosedTable::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Pointer pointer;
+    typedef Reference reference;
+
+    basic_iterator()
+      : table(NULL)
+      , idx(0)
+    {
+    }
+
+    // Allow conversion from iterator to const_iterator.
+    template <class T, class R, class P>
+    basic_iterator(const basic_iterator<T, R, P> &other)
+      : table(other.table)
+      , idx(other.idx)
+    {
+    }
+
+    Reference operator *() const
+    {
+      assert(table->is_full(idx));
+      return table->slots[idx];
+    }
+
+    Pointer operator ->() const
+    {
+      return &**this;
+    }
+
+    basic_iterator & operator ++()
+    {
+      idx = table->next_full(idx + 1);
+      return *this;
+    }
+
+    basic_iterator operator ++(int)
+    {
+      basic_iterator old(*this);
+      ++*this;
+      return old;
+    }
+
+    template <class T, class R, class P>
+    bool operator ==(const basic_iterator<T, R, P> &other) const
+    {
+      return idx == other.idx;
+    }
+
+    template <class T, class R, class P>
+    bool operator !=(const basic_iterator<T, R, P> &other) const
+    {
+      return idx != other.idx;
+    }
+
+  private:
+    basic_iterator(Table table, std::size_t idx)
+      : table(table)
+      , idx(idx)
+    {
+    }
+
+    Table table;
+    std::size_t idx;
+  };
+
+
+public:
+  typedef basic_iterator<ClosedTable *, value_type &, value_type *> iterator;
+  typedef basic_iterator<const ClosedTable *,
+                         const value_type &,
+                         const value_type *> const_iterator;
+
+
+public:
+  ClosedTable(std::size_t initial_size = group_size)
+    : ctrl()
+    , slots()
+    , num_elems(0)
+    , num_deleted(0)
+    , group_mask(0)
+    , perfect_hash()
+    , group_generation()
+    , generation(0)
+  {
+    allocate(capacity_for(initial_size));
+  }
+
+  ~ClosedTable()
+  {
+  }
+
+  /*! \brief Switches the table to direct indexing by the given perfect
+      hash function, which must map every state ever stored or looked
+      up in the table to a distinct integer in [0, num_states).
+
+      The table is emptied, and from then on takes
+      perfect_hash_bytes_per_state() * num_states bytes, however few
+      entries it holds.
+   */
+  void use_perfect_hash(std::size_t num_states, const PerfectHash &hash)
+  {
+    perfect_hash = hash;
+    std::vector<value_type>(num_states).swap(slots);
+    std::vector<Control>(num_states, empty_slot).swap(ctrl);
+    std::vector<boost::uint32_t>((num_states + group_size - 1) / group_size,
+                                 generation).swap(group_generation);
+    num_elems = 0;
+    num_deleted = 0;
+    group_mask = 0;
+  }
+
+  static std::size_t perfect_hash_bytes_per_state()
+  {
+    return sizeof(Control) + sizeof(value_type)
+      + (sizeof(boost::uint32_t) + group_size - 1) / group_size;
+  }
+
+  bool uses_perfect_hash() const
+  {
+    return !perfect_hash.empty();
+  }
+
+  iterator find(const State &s)
+  {
+    const std::size_t idx = uses_perfect_hash()
+                              ? find_ranked_index(s)
+                              : find_index(s, state_hash(s));
+    return idx == not_found ? end() : iterator(this, idx);
+  }
+
+  const_iterator find(const State &s) const
+  {
+    const std::size_t idx = uses_perfect_hash()
+                              ? find_ranked_index(s)
+                              : find_index(s, state_hash(s));
+    return idx == not_found ? end() : const_iterator(this, idx);
+  }
+
+  iterator find(const Node *n)
+  {
+    return find(n->get_state());
+  }
+
+  const_iterator find(const Node *n) const
+  {
+    return find(n->get_state());
+  }
+
+  /*! \brief Returns the value associated with the state of the given
+      node, inserting the node with a default value if its state is not
+      present.
+   */
+  Value & operator [](Node *n)
+  {
+    const State &s = n->get_state();
+
+    if (uses_perfect_hash()) {
+      const std::size_t idx = perfect_hash(s);
+      assert(idx < capacity());
+      refresh_group(idx / group_size);
+      if (ctrl[idx] < 0) {
+        ctrl[idx] = 0;
+        slots[idx] = value_type(n, Value());
+        num_elems += 1;
+      }
+      return slots[idx].second;
+    }
+
+    const std::size_t hash = state_hash(s);
+
+    const std::size_t idx = find_index(s, hash);
+    if (idx != not_found)
+      return slots[idx].second;
+
+    return slots[insert_new(n, hash)].second;
+  }
+
+  /*! \brief Removes the entry pointed to by the given iterator.
+
+      The slot is marked as deleted rather than emptied, so that
+      probe sequences passing through it remain intact.
+   */
+  void erase(iterator it)
+  {
+    assert(is_full(it.idx));
+    num_elems -= 1;
+    if (uses_perfect_hash()) {
+      ctrl[it.idx] = empty_slot;
+    }
+    else {
+      ctrl[it.idx] = deleted_slot;
+      num_deleted += 1;
+    }
+  }
+
+  std::size_t size() const
+  {
+    return num_elems;
+  }
+
+  bool empty() const
+  {
+    return num_elems == 0;
+  }
+
+  std::size_t capacity() const
+  {
+    return ctrl.size();
+  }
+
+  /*! \brief Removes all entries, keeping the table's capacity, in
+      constant time.
+   */
+  void clear()
+  {
+    generation += 1;
+    if (generation == 0) {
+      // The generations have wrapped around, so older groups could
+      // pass for current ones.  Empty them all for real.
+      std::fill(ctrl.begin(), ctrl.end(), empty_slot);
+      std::fill(group_generation.begin(), group_generation.end(), generation);
+    }
+    num_elems = 0;
+    num_deleted = 0;
+  }
+
+  /*! \brief Removes all entries and gives back the memory of the
+      slots, shrinking the table to its smallest capacity.  A table
+      indexed by a perfect hash keeps its size.
+   */
+  void release()
+  {
+    if (uses_perfect_hash()) {
+      clear();
+      return;
+    }
+
+    std::vector<Control>().swap(ctrl);
+    std::vector<value_type>().swap(slots);
+    std::vector<boost::uint32_t>().swap(group_generation);
+    allocate(capacity_for(group_size));
+  }
+
+  //! The bytes held by the table, not counting the nodes.
+  std::size_t memory_usage() const
+  {
+    return ctrl.capacity() * sizeof(Control)
+      + slots.capacity() * sizeof(value_type)
+      + group_generation.capacity() * sizeof(boost::uint32_t);
+  }
+
+  iterator begin()
+  {
+    return iterator(this, next_full(0));
+  }
+
+  const_iterator begin() const
+  {
+    return const_iterator(this, next_full(0));
+  }
+
+  iterator end()
+  {
+    return iterator(this, capacity());
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(this, capacity());
+  }
+
+
+private:
+  static std::size_t state_hash(const State &s)
+  {
+    return boost::hash<State>()(s);
+  }
+
+  // The low 7 bits of a hash are kept in the control byte; the rest
+  // choose the group at which probing begins.
+  static Control fingerprint(std::size_t hash)
+  {
+    return static_cast<Control>(hash & 0x7F);
+  }
+
+  std::size_t first_group(std::size_t hash) const
+  {
+    return (hash >> 7) & group_mask;
+  }
+
+  bool is_current_group(std::size_t group) const
+  {
+    return group_generation[group] == generation;
+  }
+
+  // Makes a group current, emptying its control bytes if they are
+  // from an older generation.
+  void refresh_group(std::size_t group)
+  {
+    if (is_current_group(group))
+      return;
+
+    const std::size_t begin = group * group_size;
+    const std::size_t end = std::min(begin + group_size, capacity());
+    std::fill(ctrl.begin() + begin, ctrl.begin() + end, empty_slot);
+    group_generation[group] = generation;
+  }
+
+  bool is_full(std::size_t idx) const
+  {
+    return idx < capacity()
+      && is_current_group(idx / group_size)
+      && ctrl[idx] >= 0;
+  }
+
+  std::size_t next_full(std::size_t idx) const
+  {
+    while (idx < capacity()) {
+      if (!is_current_group(idx / group_size))
+        idx = (idx / group_size + 1) * group_size;
+      else if (ctrl[idx] < 0)
+        idx += 1;
+      else
+        return idx;
+    }
+    return capacity();
+  }
+
+  // At most 7/8ths of the slots may be full or deleted, so that every
+  // probe sequence ends at an empty slot.
+  std::size_t max_load() const
+  {
+    return capacity() - capacity() / 8;
+  }
+
+  static std::size_t capacity_for(std::size_t num_entries)
+  {
+    std::size_t cap = group_size;
+    while (cap - cap / 8 < num_entries)
+      cap *= 2;
+    return cap;
+  }
+
+  static unsigned lowest_bit(unsigned mask)
+  {
+    assert(mask != 0);
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    unsigned i = 0;
+    while ((mask & 1) == 0) {
+      mask >>= 1;
+      i += 1;
+    }
+    return i;
+#endif
+  }
+
+  // Bit i of the result is set iff control byte (group_start + i)
+  // equals c.
+  unsigned match(std::size_t group_start, Control c) const
+  {
+#ifdef __SSE2__
+    const __m128i group =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl[group_start]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < group_size; i += 1)
+      if (ctrl[group_start + i] == c)
+        mask |= 1u << i;
+    return mask;
+#endif
+  }
+
+  // Bit i of the result is set iff control byte (group_start + i) is
+  // empty or deleted; these are exactly the bytes with the sign bit set.
+  unsigned match_empty_or_deleted(std::size_t group_start) const
+  {
+#ifdef __SSE2__
+    const __m128i group =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl[group_start]));
+    return _mm_movemask_epi8(group);
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < group_size; i += 1)
+      if (ctrl[group_start + i] < 0)
+        mask |= 1u << i;
+    return mask;
+#endif
+  }
+
+  std::size_t find_index(const State &s, std::size_t hash) const
+  {
+    const Control fp = fingerprint(hash);
+    std::size_t group = first_group(hash);
+
+    // Triangular probing over groups visits every group, as the
+    // number of groups is a power of two.
+    for (std::size_t step = 1; ; step += 1) {
+      if (!is_current_group(group))
+        return not_found;
+
+      const std::size_t base = group * group_size;
+
+      for (unsigned m = match(base, fp); m != 0; m &= m - 1) {
+        const std::size_t idx = base + lowest_bit(m);
+        if (slots[idx].first->get_state() == s)
+          return idx;
+      }
+
+      if (match(base, empty_slot) != 0)
+        return not_found;
+
+      assert(step <= group_mask + 1);
+      group = (group + step) & group_mask;
+    }
+  }
+
+  std::size_t find_ranked_index(const State &s) const
+  {
+    const std::size_t idx = perfect_hash(s);
+    assert(idx < capacity());
+    return is_full(idx) ? idx : not_found;
+  }
+
+  // A stale group is empty, so its first slot is free.
+  std::size_t find_insert_index(std::size_t hash) const
+  {
+    std::size_t group = first_group(hash);
+
+    for (std::size_t step = 1; ; step += 1) {
+      const std::size_t base = group * group_size;
+      if (!is_current_group(group))
+        return base;
+
+      const unsigned m = match_empty_or_deleted(base);
+      if (m != 0)
+        return base + lowest_bit(m);
+
+      assert(step <= group_mask + 1);
+      group = (group + step) & group_mask;
+    }
+  }
+
+  // Inserts a node whose state is known not to be in the table.
+  std::size_t insert_new(Node *n, std::size_t hash)
+  {
+    if (num_elems + num_deleted + 1 > max_load()) {
+      // Only grow if the table is really filling up; otherwise it is
+      // mostly tombstones, and rebuilding at the same size clears them.
+      if (num_elems + 1 > capacity() / 2)
+        rehash(capacity() * 2);
+      else
+        rehash(capacity());
+    }
+
+    const std::size_t idx = find_insert_index(hash);
+    refresh_group(idx / group_size);
+    if (ctrl[idx] == deleted_slot)
+      num_deleted -= 1;
+    ctrl[idx] = fingerprint(hash);
+    slots[idx] = value_type(n, Value());
+    num_elems += 1;
+    return idx;
+  }
+
+  void allocate(std::size_t cap)
+  {
+    assert(cap % group_size == 0);
+    assert((cap & (cap - 1)) == 0);
+    ctrl.assign(cap, empty_slot);
+    slots.resize(cap);
+    group_generation.assign(cap / group_size, generation);
+    group_mask = cap / group_size - 1;
+    num_elems = 0;
+    num_deleted = 0;
+  }
+
+  void rehash(std::size_t new_capacity)
+  {
+    std::vector<Control> old_ctrl;
+    std::vector<value_type> old_slots;
+    std::vector<boost::uint32_t> old_generation;
+    old_ctrl.swap(ctrl);
+    old_slots.swap(slots);
+    old_generation.swap(group_generation);
+
+    allocate(new_capacity);
+
+    for (std::size_t i = 0; i < old_ctrl.size(); i += 1) {
+      if (old_generation[i / group_size] != generation || old_ctrl[i] < 0)
+        continue;
+      const std::size_t hash = state_hash(old_slots[i].first->get_state());
+      const std::size_t idx = find_insert_index(hash);
+      ctrl[idx] = fingerprint(hash);
+      slots[idx] = old_slots[i];
+      num_elems += 1;
+    }
+  }
+};
+
+
+template <class NodeT, class ValueT>
+const typename ClosedTable<NodeT, ValueT>::Control
+ClosedTable<NodeT, ValueT>::empty_slot;
+
+template <class NodeT, class ValueT>
+const typename ClosedTable<NodeT, ValueT>::Control
+ClosedTable<NodeT, ValueT>::deleted_slot;
+
+template <class NodeT, class ValueT>
+const std::size_t ClosedTable<NodeT, ValueT>::group_size;
+
+template <class NodeT, class ValueT>
+const std::size_t ClosedTable<NodeT, ValueT>::not_found;
+
+
+#endif /* !_CLOSED_TABLE_HPP_ */
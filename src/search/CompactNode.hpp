@@ -0,0 +1,202 @@
+#ifndef _COMPACT_NODE_HPP_
+#define _COMPACT_NODE_HPP_
+
+
+#include <cstddef>
+#include <iostream>
+
+#include <boost/static_assert.hpp>
+
+#include "search/NodeArena.hpp"
+
+
+/*! \brief A search node with the same interface as Node, but laid out
+    for minimal size.
+
+    The parent is a 32-bit NodeArena handle instead of a pointer, the
+    fields are packed to 4-byte alignment, and f is always computed on
+    the fly.  For the fifteen puzzle this gives 16 bytes of node proper
+    (g, h and the move-pruning state share a word), plus the open
+    list's 4-byte back-index, against 24 bytes for Node.
+
+    CompactNodes must be allocated from their Pool (a NodeArena) if
+    they are ever to be the parent of another node.  Searchers that
+    allocate from Node::Pool work with either node type unchanged.
+*/
+#pragma pack(push, 4)
+template <
+  class StateT,
+  class CostT
+  >
+class CompactNode
+{
+public:
+  typedef StateT State;
+  typedef CostT Cost;
+  typedef NodeArena<CompactNode> Pool;
+
+
+private:
+  BOOST_STATIC_ASSERT(sizeof(Cost) <= 2);
+
+  typedef typename Pool::Handle Handle;
+
+  State state;
+  Handle parent;
+  Cost g;
+  Cost h;
+  // The state of the domain's move-pruning automaton after the moves
+  // that led to this node.
+  unsigned char move_state;
+  // The node's index within its open list bin, maintained by
+  // BucketPriorityQueue.
+  unsigned open_index;
+
+public:
+  CompactNode(const State &s,
+              Cost g,
+              Cost h,
+              const CompactNode<State, Cost> *p = NULL)
+    : state(s)
+    , parent(p == NULL ? Pool::null_handle : Pool::handle_of(p))
+    , g(g)
+    , h(h)
+    , move_state(0)
+    , open_index(0)
+  {
+  }
+
+  Cost get_f() const
+  {
+    return get_g() + get_h();
+  }
+
+  Cost get_g() const
+  {
+    return g;
+  }
+
+  void set_g(Cost new_g)
+  {
+    g = new_g;
+  }
+
+  Cost get_h() const
+  {
+    return h;
+  }
+
+  void set_h(Cost new_h)
+  {
+    h = new_h;
+  }
+
+  const State & get_state() const
+  {
+    return state;
+  }
+
+  const CompactNode<State, Cost> * get_parent() const
+  {
+    return Pool::resolve(parent);
+  }
+
+  unsigned char get_move_state() const
+  {
+    return move_state;
+  }
+
+  void set_move_state(unsigned char s)
+  {
+    move_state = s;
+  }
+
+  unsigned get_open_index() const
+  {
+    return open_index;
+  }
+
+  void set_open_index(unsigned idx)
+  {
+    open_index = idx;
+  }
+
+  unsigned num_nodes_to_start() const
+  {
+    unsigned num_nodes = 1;
+    const CompactNode<State, Cost> *parent_ptr = get_parent();
+    while (parent_ptr != NULL) {
+      num_nodes += 1;
+      parent_ptr = parent_ptr->get_parent();
+    }
+    return num_nodes;
+  }
+
+
+  bool is_descendent_of(const CompactNode<State, Cost> *node) const
+  {
+    const CompactNode *p = this;
+
+    while (p != NULL) {
+      if (p->get_state() == node->get_state())
+        return true;
+
+      p = p->get_parent();
+    }
+
+    return false;
+  }
+
+
+  /**
+   * Compare nodes by f-value, breaking ties in favor of high g-value.
+   */
+  bool operator <(const CompactNode<State, Cost> &other) const
+  {
+    Cost my_f = get_f();
+    Cost other_f = other.get_f();
+
+    return my_f < other_f || (my_f == other_f && get_g() > other.get_g());
+  }
+
+  bool operator >=(const CompactNode<State, Cost> &other) const
+  {
+    return !(*this < other);
+  }
+
+  /**
+   * Equality is determined by the enclosed states.
+   */
+  bool operator ==(const CompactNode<State, Cost> &other) const
+  {
+    return state == other.state;
+  }
+};
+#pragma pack(pop)
+
+
+template <
+  class State,
+  class Cost
+  >
+std::size_t hash_value(CompactNode<State, Cost> const &node)
+{
+  return hash_value(node.get_state());
+}
+
+
+template <
+  class State,
+  class Cost
+  >
+std::ostream & operator <<(std::ostream &o, const CompactNode<State, Cost> &n)
+{
+  o << n.get_state() << std::endl
+    << "f: " << n.get_f() << std::endl
+    << "g: " << n.get_g() << std::endl
+    << "h: " << n.get_h() << std::endl;
+  return o;
+}
+
+
+#endif /* !_COMPACT_NODE_HPP_ */
@@ -2,7 +2,39 @@
 #define _SEARCH_CONSTANTS_HPP_
 
 
+#include <cstddef>
+
+
 const unsigned INITIAL_CLOSED_SET_SIZE = 1024;
 
+// The memory, in bytes, that a hierarchical searcher may spend on
+// closed lists indexed directly by state rank, for the abstraction
+// levels small enough to allow it.
+const std::size_t DENSE_CLOSED_MEMORY_BUDGET = 4u << 20;
+
+// The number of successors HDA* gathers for another thread before
+// handing them over.
+const unsigned HDA_STAR_BATCH_SIZE = 64;
+
+// IDA* only consults its transposition table at states whose f-value is
+// at least this far below the bound.  The subtrees of the others are
+// too small to be worth a likely cache miss.
+const unsigned IDA_STAR_TT_MIN_SLACK = 2;
+
+// The number of work items for each thread that parallel IDA* splits
+// the tree into, unless it is given the split depth.  More items
+// balance the threads better, at the cost of a longer split.
+const unsigned PIDA_STAR_ITEMS_PER_THREAD = 32;
+
+
+// The bytes that external-memory A* reads or writes to a file at a
+// time, for each file it has open.
+const std::size_t EXTERNAL_A_STAR_IO_BUFFER_BYTES = 1u << 20;
+
+
+// The number of budget checks, one per expansion, between readings of
+// the clock and the memory use.
+const unsigned SEARCH_BUDGET_CHECK_INTERVAL = 1024;
+
 
 #endif /* !_SEARCH_CONSTANTS_HPP_ */
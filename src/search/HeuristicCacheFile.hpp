@@ -0,0 +1,267 @@
+#ifndef _HEURISTIC_CACHE_FILE_HPP_
+#define _HEURISTIC_CACHE_FILE_HPP_
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+
+/*! \brief A hierarchical searcher's heuristic cache, saved to disk so
+    that later runs can start with it.
+
+    The cached values of abstract states depend only on the domain, the
+    goal and the abstraction hierarchy, and not on the start state, so
+    every instance of a benchmark set with a shared goal and a static
+    abstraction can use the values learned on the others.  A file is
+    identified by a key made of the name of the domain and searcher and
+    the abstraction of the goal at every level, which gives both the
+    goal and the abstraction order.  Its name holds a hash of the key,
+    so files for different keys live side by side in one directory.
+
+    The file is a header, the key, and the entries, each the bytes of a
+    state (which must be a plain value, as the domains' states are),
+    its cost, and whether the cost is exact.  It is written under a
+    temporary name and renamed into place, and is read by mapping it.
+
+    \tparam State  The type of the cached states
+    \tparam Cost   The type of the cached costs
+*/
+template <class State, class Cost>
+class HeuristicCacheFile : boost::noncopyable
+{
+public:
+  static const boost::uint32_t file_version = 1;
+
+  static const unsigned entry_size = sizeof(State) + sizeof(Cost) + 1;
+
+
+private:
+  struct Header
+  {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t entry_size;
+    boost::uint64_t key_size;
+    boost::uint64_t num_entries;
+  };
+
+  std::string key;
+  std::string path;
+
+  // The entries to be saved.
+  std::vector<char> entries;
+
+  void *mapped;
+  size_t mapped_size;
+  const char *mapped_entries;
+  boost::uint64_t num_mapped_entries;
+
+
+public:
+  /*! \param dir                The directory of the cache files
+      \param name               Names the domain and searcher
+      \param goal_abstractions  The goal at each level of the hierarchy
+   */
+  template <std::size_t NumLevels>
+  HeuristicCacheFile(const std::string &dir,
+                     const std::string &name,
+                     const boost::array<State, NumLevels> &goal_abstractions)
+    : key(name)
+    , path()
+    , entries()
+    , mapped(MAP_FAILED)
+    , mapped_size(0)
+    , mapped_entries(NULL)
+    , num_mapped_entries(0)
+  {
+    key.push_back('\0');
+    for (unsigned level = 0; level < NumLevels; level += 1)
+      key.append(reinterpret_cast<const char *>(&goal_abstractions[level]),
+                 sizeof(State));
+
+    std::ostringstream o;
+    o << dir << "/" << name << "-" << std::hex << std::setfill('0')
+      << std::setw(16) << hash_key(key) << ".hcache";
+    path = o.str();
+  }
+
+  ~HeuristicCacheFile()
+  {
+    if (mapped != MAP_FAILED)
+      munmap(mapped, mapped_size);
+  }
+
+  const std::string & get_path() const
+  {
+    return path;
+  }
+
+
+  /*! \brief Maps the file, if there is one.
+
+      Returns false if there is no file, or, after writing a message to
+      log, if it is not a cache file for this key.
+   */
+  bool map(std::ostream &log)
+  {
+    assert(mapped == MAP_FAILED);
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      if (errno != ENOENT)
+        log << "error: cannot open heuristic cache " << path << ": "
+            << strerror(errno) << std::endl;
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(Header)) {
+      mapped_size = st.st_size;
+      mapped = mmap(NULL, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+      log << "error: cannot map heuristic cache " << path << std::endl;
+      return false;
+    }
+
+    const Header expected = make_header(0);
+    Header header;
+    memcpy(&header, mapped, sizeof(header));
+    const char *file_key = static_cast<const char *>(mapped) + sizeof(header);
+
+    const char *problem = NULL;
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+        || header.version != expected.version
+        || header.entry_size != expected.entry_size)
+      problem = "is not a heuristic cache of this version";
+    else if (mapped_size < sizeof(header) + header.key_size)
+      problem = "is truncated";
+    else if (header.key_size != key.size()
+             || memcmp(file_key, key.data(), key.size()) != 0)
+      problem = "was not saved for this domain, goal and abstraction";
+    else if (mapped_size != sizeof(header) + key.size()
+                            + header.num_entries * entry_size)
+      problem = "is truncated";
+
+    if (problem != NULL) {
+      log << "error: " << path << " " << problem << std::endl;
+      munmap(mapped, mapped_size);
+      mapped = MAP_FAILED;
+      return false;
+    }
+
+    mapped_entries = file_key + key.size();
+    num_mapped_entries = header.num_entries;
+    return true;
+  }
+
+  //! The number of entries in the mapped file.
+  boost::uint64_t size() const
+  {
+    return num_mapped_entries;
+  }
+
+  //! Reads the i-th entry of the mapped file.
+  void get(boost::uint64_t i, State &s, Cost &cost, bool &is_exact) const
+  {
+    assert(i < num_mapped_entries);
+    const char *entry = mapped_entries + i * entry_size;
+    memcpy(&s, entry, sizeof(State));
+    memcpy(&cost, entry + sizeof(State), sizeof(Cost));
+    is_exact = entry[sizeof(State) + sizeof(Cost)] != 0;
+  }
+
+
+  //! Adds an entry to those to be saved.
+  void add(const State &s, Cost cost, bool is_exact)
+  {
+    const size_t begin = entries.size();
+    entries.resize(begin + entry_size);
+    memcpy(&entries[begin], &s, sizeof(State));
+    memcpy(&entries[begin + sizeof(State)], &cost, sizeof(Cost));
+    entries[begin + sizeof(State) + sizeof(Cost)] = is_exact;
+  }
+
+  /*! \brief Replaces the file with the added entries.
+
+      Returns false, after writing a message to log, if it cannot.
+   */
+  bool save(std::ostream &log) const
+  {
+    const Header header = make_header(entries.size() / entry_size);
+
+    std::ostringstream tmp_path;
+    tmp_path << path << ".tmp." << getpid();
+    std::ofstream out(tmp_path.str().c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(key.data(), key.size());
+    if (!entries.empty())
+      out.write(&entries[0], entries.size());
+
+    out.close();
+    if (!out || rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+      log << "error: cannot write heuristic cache " << path << ": "
+          << strerror(errno) << std::endl;
+      unlink(tmp_path.str().c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+
+private:
+  Header make_header(boost::uint64_t num_entries) const
+  {
+    static const char magic[8] = {'H', 'E', 'U', 'R', 'C', 'A', 'C', 'H'};
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = file_version;
+    header.entry_size = entry_size;
+    header.key_size = key.size();
+    header.num_entries = num_entries;
+    return header;
+  }
+
+  // FNV-1a, which is plenty for telling a handful of keys apart.
+  static boost::uint64_t hash_key(const std::string &key)
+  {
+    boost::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned i = 0; i < key.size(); i += 1) {
+      hash ^= static_cast<unsigned char>(key[i]);
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+};
+
+
+template <class State, class Cost>
+const boost::uint32_t HeuristicCacheFile<State, Cost>::file_version;
+
+template <class State, class Cost>
+const unsigned HeuristicCacheFile<State, Cost>::entry_size;
+
+
+#endif /* !_HEURISTIC_CACHE_FILE_HPP_ */
@@ -0,0 +1,228 @@
+#ifndef _LEVEL_PROFILE_HPP_
+#define _LEVEL_PROFILE_HPP_
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+#include <time.h>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include "search/SearchStatistics.hpp"
+
+
+// Profile the sub-searches of the hierarchical searchers.  It costs two
+// clock reads per sub-search.
+#define HIERARCHICAL_SEARCH_PROFILING
+
+
+/*! \brief Where a hierarchical searcher's time goes, by abstraction
+    level.
+
+    Each sub-search (a call of HA*'s search_at_level, HIDA*'s
+    hidastar_search, or Switchback's resume_search) is bracketed by a
+    Scope.  The profile records, per level:
+
+    - the number of sub-searches,
+    - their inclusive wall time, including the sub-searches at higher
+      levels that they started for heuristic values,
+    - their exclusive wall time, without those,
+    - a histogram of their lengths in expansions at their own level,
+      in power-of-two buckets.
+
+    Sub-searches nest strictly by level, so a stack of open scopes is
+    enough to split inclusive from exclusive time.
+
+    \tparam NumLevels  The number of levels in the hierarchy
+*/
+template <unsigned NumLevels>
+class LevelProfile : boost::noncopyable
+{
+public:
+  //! Bucket b counts sub-searches of [2^(b-1), 2^b) expansions; bucket
+  //! 0 counts those of none.
+  static const unsigned num_length_buckets = 33;
+
+  class Scope : boost::noncopyable
+  {
+  public:
+    /*! Opens a sub-search at the given level, whose expansions are
+        counted by the given counter.
+     */
+    Scope(LevelProfile &profile, unsigned level, const unsigned &num_expanded)
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+      : profile(profile)
+      , level(level)
+      , num_expanded(num_expanded)
+      , start_expanded(num_expanded)
+    {
+      profile.enter(level);
+    }
+#else
+    {
+    }
+#endif
+
+    ~Scope()
+    {
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+      profile.leave(level, num_expanded - start_expanded);
+#endif
+    }
+
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+  private:
+    LevelProfile &profile;
+    const unsigned level;
+    const unsigned &num_expanded;
+    const unsigned start_expanded;
+#endif
+  };
+
+
+private:
+  typedef boost::uint64_t Nanoseconds;
+
+  struct Frame
+  {
+    Nanoseconds start;
+    Nanoseconds children;
+  };
+
+  boost::array<unsigned long, NumLevels> num_searches;
+  boost::array<Nanoseconds, NumLevels> inclusive;
+  boost::array<Nanoseconds, NumLevels> exclusive;
+  boost::array<boost::array<unsigned long, num_length_buckets>, NumLevels> lengths;
+
+  std::vector<Frame> open_frames;
+
+
+public:
+  LevelProfile()
+  {
+    reset();
+    open_frames.reserve(NumLevels);
+  }
+
+  void reset()
+  {
+    num_searches.assign(0);
+    inclusive.assign(0);
+    exclusive.assign(0);
+    for (unsigned level = 0; level < NumLevels; level += 1)
+      lengths[level].assign(0);
+    open_frames.clear();
+  }
+
+  void output(std::ostream &o) const
+  {
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+    o << "sub-search profile (searches, inclusive/exclusive seconds, lengths):"
+      << std::endl;
+    for (unsigned level = 0; level < NumLevels; level += 1) {
+      o << "  " << level << ": " << num_searches[level] << " searches, "
+        << seconds(inclusive[level]) << " / " << seconds(exclusive[level])
+        << " s, lengths " << length_histogram(level) << std::endl;
+    }
+#endif
+  }
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+#ifdef HIERARCHICAL_SEARCH_PROFILING
+    for (unsigned level = 0; level < NumLevels; level += 1) {
+      stats.set_level_count(level, "searches", num_searches[level]);
+      stats.set_real(SearchStatistics::level_key(level, "inclusive_time"),
+                     seconds(inclusive[level]));
+      stats.set_real(SearchStatistics::level_key(level, "exclusive_time"),
+                     seconds(exclusive[level]));
+      stats.set_string(SearchStatistics::level_key(level, "search_lengths"),
+                       length_histogram(level));
+    }
+#endif
+  }
+
+
+private:
+  void enter(unsigned level)
+  {
+    Frame frame;
+    frame.start = now();
+    frame.children = 0;
+    open_frames.push_back(frame);
+  }
+
+  void leave(unsigned level, unsigned expanded)
+  {
+    const Frame frame = open_frames.back();
+    open_frames.pop_back();
+
+    const Nanoseconds elapsed = now() - frame.start;
+    num_searches[level] += 1;
+    inclusive[level] += elapsed;
+    exclusive[level] += elapsed - frame.children;
+    lengths[level][length_bucket(expanded)] += 1;
+
+    if (!open_frames.empty())
+      open_frames.back().children += elapsed;
+  }
+
+  static unsigned length_bucket(unsigned expanded)
+  {
+    unsigned bucket = 0;
+    while (expanded != 0) {
+      expanded >>= 1;
+      bucket += 1;
+    }
+    return bucket;
+  }
+
+  // The histogram of a level as "<upper bound>:<count>" pairs for the
+  // nonempty buckets, where a bucket holds the lengths up to its upper
+  // bound and above the previous bucket's.
+  std::string length_histogram(unsigned level) const
+  {
+    std::ostringstream o;
+    for (unsigned bucket = 0; bucket < num_length_buckets; bucket += 1) {
+      if (lengths[level][bucket] == 0)
+        continue;
+      if (o.tellp() > 0)
+        o << " ";
+      const unsigned long long upper =
+        bucket == 0 ? 0 : (static_cast<unsigned long long>(1) << bucket) - 1;
+      o << upper << ":" << lengths[level][bucket];
+    }
+    return o.str();
+  }
+
+  static double seconds(Nanoseconds ns)
+  {
+    return ns / 1e9;
+  }
+
+  static Nanoseconds now()
+  {
+#if defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<Nanoseconds>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<Nanoseconds>(tv.tv_sec) * 1000000000 + tv.tv_usec * 1000;
+#endif
+  }
+};
+
+
+template <unsigned NumLevels>
+const unsigned LevelProfile<NumLevels>::num_length_buckets;
+
+
+#endif /* !_LEVEL_PROFILE_HPP_ */
@@ -0,0 +1,146 @@
+#ifndef _MOVE_PRUNING_FSM_HPP_
+#define _MOVE_PRUNING_FSM_HPP_
+
+
+#include <cassert>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+
+/*! \brief A finite-state machine over move sequences that rejects the
+    moves completing a known redundant sequence, after Taylor and Korf.
+
+    A domain finds the redundant sequences of its moves: those whose
+    effect, wherever they apply, is also had by a shorter sequence, or
+    by one of the same length that comes first in the order in which
+    successors are generated.  A search that never makes a redundant
+    sequence still finds the first optimal path, in that order, of a
+    depth-first search.  The machine recognizes the sequences as
+    substrings, Aho-Corasick style, so each node need only carry the
+    machine's state, and each move costs one table lookup.
+
+    The moves are given as labels in [0, num_labels), which must not
+    depend on the state they are made from: for the tiles, the
+    direction the blank moves.
+*/
+class MovePruningFSM
+{
+public:
+  typedef unsigned char State;
+  typedef std::vector<unsigned char> Sequence;
+
+  //! The state for an empty sequence of moves.
+  static const State start_state = 0;
+  //! The state after a move that completes a redundant sequence.
+  static const State pruned = 255;
+
+
+private:
+  unsigned num_labels;
+  // table[state * num_labels + label] is the state after the move.
+  std::vector<State> table;
+
+
+public:
+  /*! \param num_labels  The number of move labels
+      \param redundant   The redundant sequences, none of which may
+                         contain another
+   */
+  MovePruningFSM(unsigned num_labels, const std::vector<Sequence> &redundant)
+    : num_labels(num_labels)
+    , table()
+  {
+    build(redundant);
+  }
+
+  State next(State s, unsigned label) const
+  {
+    assert(s != pruned);
+    assert(label < num_labels);
+    return table[s * num_labels + label];
+  }
+
+  unsigned get_num_states() const
+  {
+    return table.size() / num_labels;
+  }
+
+
+private:
+  void build(const std::vector<Sequence> &redundant)
+  {
+    // The trie of the sequences, whose nodes are the prefixes.
+    std::vector<std::vector<int> > child(1, std::vector<int>(num_labels, -1));
+    std::vector<bool> is_end(1, false);
+
+    for (unsigned i = 0; i < redundant.size(); i += 1) {
+      const Sequence &seq = redundant[i];
+      assert(!seq.empty());
+      int node = 0;
+      for (unsigned j = 0; j < seq.size(); j += 1) {
+        assert(seq[j] < num_labels);
+        if (child[node][seq[j]] == -1) {
+          child[node][seq[j]] = child.size();
+          child.push_back(std::vector<int>(num_labels, -1));
+          is_end.push_back(false);
+        }
+        node = child[node][seq[j]];
+      }
+      is_end[node] = true;
+    }
+
+    // Breadth-first, fill in the missing moves from each prefix by
+    // following its longest proper suffix that is also a prefix.
+    // Ending a sequence anywhere in a prefix ends it for good.
+    std::vector<int> suffix(child.size(), 0);
+    std::vector<int> queue;
+    for (unsigned l = 0; l < num_labels; l += 1) {
+      if (child[0][l] == -1)
+        child[0][l] = 0;
+      else
+        queue.push_back(child[0][l]);
+    }
+
+    for (unsigned q = 0; q < queue.size(); q += 1) {
+      const int node = queue[q];
+      is_end[node] = is_end[node] || is_end[suffix[node]];
+      for (unsigned l = 0; l < num_labels; l += 1) {
+        const int next = child[node][l];
+        if (next == -1) {
+          child[node][l] = child[suffix[node]][l];
+        }
+        else {
+          suffix[next] = child[suffix[node]][l];
+          queue.push_back(next);
+        }
+      }
+    }
+
+    // Number the prefixes that do not end a sequence; the others are
+    // all the pruned state.
+    std::map<int, State> number;
+    for (unsigned node = 0; node < child.size(); node += 1)
+      if (!is_end[node]) {
+        if (number.size() == pruned)
+          throw std::length_error("MovePruningFSM: too many states");
+        const State s = number.size();
+        number[node] = s;
+      }
+    assert(number[0] == start_state);
+
+    table.assign(number.size() * num_labels, State(pruned));
+    for (std::map<int, State>::const_iterator it = number.begin();
+         it != number.end();
+         ++it)
+      for (unsigned l = 0; l < num_labels; l += 1) {
+        const int next = child[it->first][l];
+        if (!is_end[next])
+          table[it->second * num_labels + l] = number[next];
+      }
+  }
+};
+
+
+#endif /* !_MOVE_PRUNING_FSM_HPP_ */
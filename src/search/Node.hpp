@@ -2,6 +2,9 @@
 #define _NODE_HPP_
 
 
+#include <boost/pool/pool.hpp>
+
+
 template <
   class StateT,
   class CostT
@@ -11,6 +14,7 @@ class Node
 public:
   typedef StateT State;
   typedef CostT Cost;
+  typedef boost::pool<> Pool;
 
 
 private:
@@ -21,6 +25,12 @@ private:
 #ifdef CACHE_NODE_F_VALUE
   Cost f;
 #endif
+  // The state of the domain's move-pruning automaton after the moves
+  // that led to this node.  It fits in the padding after the costs.
+  unsigned char move_state;
+  // The node's index within its open list bin, maintained by
+  // BucketPriorityQueue.
+  unsigned open_index;
 
 public:
   Node(const State &s,
@@ -34,6 +44,8 @@ public:
 #ifdef CACHE_NODE_F_VALUE
     , f(g + h)
 #endif
+    , move_state(0)
+    , open_index(0)
   {
   }
 
@@ -82,6 +94,26 @@ public:
     return parent;
   }
 
+  unsigned char get_move_state() const
+  {
+    return move_state;
+  }
+
+  void set_move_state(unsigned char s)
+  {
+    move_state = s;
+  }
+
+  unsigned get_open_index() const
+  {
+    return open_index;
+  }
+
+  void set_open_index(unsigned idx)
+  {
+    open_index = idx;
+  }
+
   unsigned num_nodes_to_start() const
   {
     unsigned num_nodes = 1;
@@ -0,0 +1,264 @@
+#ifndef _NODE_ARENA_HPP_
+#define _NODE_ARENA_HPP_
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <pthread.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+
+/*! \brief A per-search node allocator that can name its nodes with
+    32-bit handles.
+
+    This has the same malloc()/free()/purge_memory() interface as
+    boost::pool<>, so searchers can use either one as their node pool,
+    plus a constant-time reset() that keeps the arena's memory.
+    Nodes are carved out of large chunks.  Each chunk has a process-wide
+    id, and a node's handle is its chunk id followed by its slot number
+    within the chunk, so a handle can be turned back into a pointer
+    without a reference to the arena that allocated it.
+
+    Chunks are aligned to a power of two at least as large as the chunk
+    itself, which lets handle_of() find a node's chunk (and the chunk
+    id kept in its first slot) by masking the node's address.
+
+    \tparam Node  The type of node allocated from the arena
+*/
+template <class Node>
+class NodeArena : boost::noncopyable
+{
+public:
+  typedef boost::uint32_t Handle;
+
+  //! The handle of no node.  Slot 0 of each chunk holds the chunk's
+  //! header, so no node ever has this handle.
+  static const Handle null_handle = 0;
+
+
+private:
+  static const unsigned slot_bits = 16;
+  static const std::size_t slots_per_chunk = 1u << slot_bits;
+  static const std::size_t max_chunks = 1u << (32 - slot_bits);
+
+  struct ChunkHeader
+  {
+    Handle id;
+  };
+
+  // The chunks allocated by this arena, in allocation order.
+  std::vector<char *> chunks;
+  // The chunk being carved up.  Those after it are kept from before
+  // the last reset(), and are used before new ones are allocated.
+  std::size_t current_chunk;
+  // The next never-allocated slot in the current chunk, and its end.
+  char *next_slot;
+  char *chunk_end;
+  // A singly-linked list of freed slots, threaded through the slots.
+  void *free_list;
+
+  // The process-wide directory of chunks, indexed by chunk id.  It is
+  // shared by all arenas for this node type.
+  static char *directory[max_chunks];
+  static std::vector<Handle> free_ids;
+  static Handle next_id;
+  static pthread_mutex_t directory_lock;
+
+
+public:
+  explicit NodeArena(std::size_t requested_size = sizeof(Node))
+    : chunks()
+    , current_chunk(0)
+    , next_slot(NULL)
+    , chunk_end(NULL)
+    , free_list(NULL)
+  {
+    assert(requested_size == sizeof(Node));
+  }
+
+  ~NodeArena()
+  {
+    while (!chunks.empty()) {
+      release_chunk(chunks.back());
+      chunks.pop_back();
+    }
+  }
+
+  void * malloc()
+  {
+    if (free_list != NULL) {
+      void *slot = free_list;
+      free_list = *static_cast<void **>(slot);
+      return slot;
+    }
+
+    if (next_slot == chunk_end)
+      next_chunk();
+
+    void *slot = next_slot;
+    next_slot += sizeof(Node);
+    return slot;
+  }
+
+  void free(void *slot)
+  {
+    *static_cast<void **>(slot) = free_list;
+    free_list = slot;
+  }
+
+  /*! \brief Frees every node allocated from the arena at once.
+
+      The first chunk is kept for the next round of allocations, as
+      searchers typically purge an arena only to start over with it.
+   */
+  void purge_memory()
+  {
+    while (chunks.size() > 1) {
+      release_chunk(chunks.back());
+      chunks.pop_back();
+    }
+
+    reset();
+  }
+
+  /*! \brief Frees every node allocated from the arena at once, in
+      constant time, keeping all of its chunks for reuse.
+   */
+  void reset()
+  {
+    free_list = NULL;
+    current_chunk = 0;
+    if (chunks.empty()) {
+      next_slot = chunk_end = NULL;
+    }
+    else {
+      next_slot = chunks[0] + sizeof(Node);
+      chunk_end = chunks[0] + slots_per_chunk * sizeof(Node);
+    }
+  }
+
+  static Handle handle_of(const Node *n)
+  {
+    const std::size_t addr = reinterpret_cast<std::size_t>(n);
+    const char *chunk =
+      reinterpret_cast<const char *>(addr & ~(chunk_alignment() - 1));
+    const Handle id = reinterpret_cast<const ChunkHeader *>(chunk)->id;
+    assert(directory[id] == chunk);
+
+    const std::size_t slot = (reinterpret_cast<const char *>(n) - chunk) / sizeof(Node);
+    assert(0 < slot && slot < slots_per_chunk);
+    return (id << slot_bits) | slot;
+  }
+
+  static Node * resolve(Handle h)
+  {
+    if (h == null_handle)
+      return NULL;
+
+    char *chunk = directory[h >> slot_bits];
+    assert(chunk != NULL);
+    return reinterpret_cast<Node *>(chunk + (h & (slots_per_chunk - 1)) * sizeof(Node));
+  }
+
+
+private:
+  // The smallest power of two no less than N.
+  template <std::size_t N, std::size_t P = 1, bool done = (P >= N)>
+  struct CeilPowerOfTwo
+  {
+    static const std::size_t value = CeilPowerOfTwo<N, 2 * P>::value;
+  };
+
+  template <std::size_t N, std::size_t P>
+  struct CeilPowerOfTwo<N, P, true>
+  {
+    static const std::size_t value = P;
+  };
+
+  static std::size_t chunk_alignment()
+  {
+    return CeilPowerOfTwo<slots_per_chunk * sizeof(Node)>::value;
+  }
+
+  void next_chunk()
+  {
+    if (current_chunk + 1 < chunks.size()) {
+      current_chunk += 1;
+      next_slot = chunks[current_chunk] + sizeof(Node);
+      chunk_end = chunks[current_chunk] + slots_per_chunk * sizeof(Node);
+    }
+    else {
+      add_chunk();
+    }
+  }
+
+  void add_chunk()
+  {
+    void *mem = NULL;
+    if (posix_memalign(&mem, chunk_alignment(), slots_per_chunk * sizeof(Node)) != 0)
+      throw std::bad_alloc();
+    char *chunk = static_cast<char *>(mem);
+
+    pthread_mutex_lock(&directory_lock);
+    Handle id;
+    if (!free_ids.empty()) {
+      id = free_ids.back();
+      free_ids.pop_back();
+    }
+    else if (next_id < max_chunks) {
+      id = next_id;
+      next_id += 1;
+    }
+    else {
+      pthread_mutex_unlock(&directory_lock);
+      std::free(chunk);
+      throw std::bad_alloc();
+    }
+    directory[id] = chunk;
+    pthread_mutex_unlock(&directory_lock);
+
+    reinterpret_cast<ChunkHeader *>(chunk)->id = id;
+    chunks.push_back(chunk);
+    current_chunk = chunks.size() - 1;
+    next_slot = chunk + sizeof(Node);
+    chunk_end = chunk + slots_per_chunk * sizeof(Node);
+  }
+
+  static void release_chunk(char *chunk)
+  {
+    const Handle id = reinterpret_cast<ChunkHeader *>(chunk)->id;
+
+    pthread_mutex_lock(&directory_lock);
+    assert(directory[id] == chunk);
+    directory[id] = NULL;
+    free_ids.push_back(id);
+    pthread_mutex_unlock(&directory_lock);
+
+    std::free(chunk);
+  }
+};
+
+
+template <class Node>
+const typename NodeArena<Node>::Handle NodeArena<Node>::null_handle;
+
+template <class Node>
+char *NodeArena<Node>::directory[NodeArena<Node>::max_chunks];
+
+template <class Node>
+std::vector<typename NodeArena<Node>::Handle> NodeArena<Node>::free_ids;
+
+template <class Node>
+typename NodeArena<Node>::Handle NodeArena<Node>::next_id = 0;
+
+template <class Node>
+pthread_mutex_t NodeArena<Node>::directory_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+#endif /* !_NODE_ARENA_HPP_ */
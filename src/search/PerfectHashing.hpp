@@ -0,0 +1,73 @@
+#ifndef _PERFECT_HASHING_HPP_
+#define _PERFECT_HASHING_HPP_
+
+
+#include <cstddef>
+
+#include "search/Constants.hpp"
+#include "util/PermutationRank.hpp"
+
+
+/*! \brief A perfect hash function for the states at one level of a
+    domain's abstraction hierarchy, given by the domain's rank().
+ */
+template <
+  class Domain,
+  class State
+  >
+class LevelRanker
+{
+public:
+  LevelRanker(const Domain &domain, unsigned level)
+    : domain(&domain)
+    , level(level)
+  {
+  }
+
+  std::size_t operator ()(const State &s) const
+  {
+    return domain->rank(level, s);
+  }
+
+private:
+  const Domain *domain;
+  unsigned level;
+};
+
+
+/*! \brief Switches the closed lists of the abstraction levels whose
+    state spaces fit in the given memory budget over to direct indexing
+    by state rank.
+
+    The top of a hierarchy is far smaller than the bottom, so levels
+    are considered from the top down.
+
+    \param closed  An array of ClosedTables, indexed by level
+ */
+template <
+  class Domain,
+  class ClosedArray
+  >
+void use_perfect_hashing(const Domain &domain,
+                         ClosedArray &closed,
+                         std::size_t budget = DENSE_CLOSED_MEMORY_BUDGET)
+{
+  typedef typename ClosedArray::value_type Closed;
+  typedef typename Closed::State State;
+
+  std::size_t bytes_used = 0;
+  for (unsigned level = closed.size(); level-- > 0; ) {
+    const PermutationRank num_states = domain.num_ranks(level);
+    const PermutationRank bytes =
+      num_states * Closed::perfect_hash_bytes_per_state();
+    if (bytes > budget - bytes_used)
+      continue;
+
+    closed[level].use_perfect_hash(num_states,
+                                   LevelRanker<Domain, State>(domain, level));
+    bytes_used += bytes;
+  }
+}
+
+
+#endif /* !_PERFECT_HASHING_HPP_ */
@@ -0,0 +1,202 @@
+#ifndef _SEARCH_BUDGET_HPP_
+#define _SEARCH_BUDGET_HPP_
+
+
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+
+
+//! Thrown by SearchBudget::check() when the budget has run out.
+class BudgetExhausted : public std::exception
+{
+public:
+  const char * what() const throw()
+  {
+    return "search budget exhausted";
+  }
+};
+
+
+/*! \brief Limits on the wall time, the expansions and the memory a
+    search may use.
+
+    A searcher given a budget calls check() at every expansion, with its
+    number of expansions so far.  The expansions are compared at every
+    call, but the clock and the memory use are only read every
+    SEARCH_BUDGET_CHECK_INTERVAL calls, which keeps the checks cheap.
+    Once the budget runs out, check() throws BudgetExhausted, which
+    leaves the searcher's counts and lists as they were, for its
+    statistics.  Nothing else should be asked of the searcher.
+
+    The memory use is the process's current resident set size, from
+    /proc/self/statm, so memory that a search has freed again does not
+    count against it.  Where /proc is missing, it is the peak resident
+    set size, the max_memory_mb of the search results.  As it is read
+    only now and then, the memory budget is soft: a search overshoots it
+    by what it allocates between readings, such as a closed list
+    doubling.
+
+    check() and is_exhausted() are for a single thread.  The threads of
+    a parallel searcher may instead call find_exhausted(), which only
+    reads the budget, every SEARCH_BUDGET_CHECK_INTERVAL of their
+    expansions.  The searcher then stops its threads itself, and
+    records the limit with set_exhausted().
+*/
+class SearchBudget : boost::noncopyable
+{
+public:
+  enum Limit { no_limit, time_limit, expansion_limit, memory_limit };
+
+private:
+  const double max_seconds;
+  const unsigned long max_expanded;
+  const std::size_t max_memory_bytes;
+
+  double start_time;
+  unsigned num_checks;
+  Limit exhausted;
+
+public:
+  /*! \param max_seconds       The wall time allowed, or 0 for no limit
+      \param max_expanded      The expansions allowed, or 0 for no limit
+      \param max_memory_bytes  The memory allowed, or 0 for no limit
+   */
+  SearchBudget(double max_seconds = 0,
+               unsigned long max_expanded = 0,
+               std::size_t max_memory_bytes = 0)
+    : max_seconds(max_seconds)
+    , max_expanded(max_expanded)
+    , max_memory_bytes(max_memory_bytes)
+    , start_time(now())
+    , num_checks(0)
+    , exhausted(no_limit)
+  {
+  }
+
+  bool is_limited() const
+  {
+    return max_seconds > 0 || max_expanded > 0 || max_memory_bytes > 0;
+  }
+
+  //! Starts the clock, which otherwise starts with the budget.
+  void start()
+  {
+    start_time = now();
+  }
+
+  //! Throws BudgetExhausted if the budget has run out.
+  void check(unsigned long num_expanded)
+  {
+    if (max_expanded > 0 && num_expanded >= max_expanded) {
+      exhausted = expansion_limit;
+      throw BudgetExhausted();
+    }
+
+    num_checks += 1;
+    if (num_checks < SEARCH_BUDGET_CHECK_INTERVAL)
+      return;
+    num_checks = 0;
+
+    if (is_exhausted(num_expanded))
+      throw BudgetExhausted();
+  }
+
+  /*! Whether the budget has run out, reading the clock and the memory
+      use now.
+   */
+  bool is_exhausted(unsigned long num_expanded)
+  {
+    if (exhausted == no_limit)
+      exhausted = find_exhausted(num_expanded);
+    return exhausted != no_limit;
+  }
+
+  /*! The limit that has run out, if any, reading the clock and the
+      memory use now, without recording it.  This may be called from
+      any thread.
+   */
+  Limit find_exhausted(unsigned long num_expanded) const
+  {
+    if (max_expanded > 0 && num_expanded >= max_expanded)
+      return expansion_limit;
+    if (max_seconds > 0 && now() - start_time >= max_seconds)
+      return time_limit;
+    if (max_memory_bytes > 0 && get_memory_usage() >= max_memory_bytes)
+      return memory_limit;
+    return no_limit;
+  }
+
+  //! Records the limit that ran out, as found by find_exhausted().
+  void set_exhausted(Limit limit)
+  {
+    exhausted = limit;
+  }
+
+  //! The limit that ran out, if any.
+  Limit get_exhausted() const
+  {
+    return exhausted;
+  }
+
+  static const char * limit_name(Limit limit)
+  {
+    switch (limit) {
+    case time_limit:
+      return "time";
+    case expansion_limit:
+      return "expansions";
+    case memory_limit:
+      return "memory";
+    default:
+      return "none";
+    }
+  }
+
+private:
+  static double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+
+  // The resident set size now, or the peak resident set size where the
+  // current one can not be read.
+  static std::size_t get_memory_usage()
+  {
+#ifdef __linux__
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+      unsigned long size_pages;
+      unsigned long resident_pages;
+      const int num_read = std::fscanf(statm, "%lu %lu",
+                                       &size_pages, &resident_pages);
+      std::fclose(statm);
+      if (num_read == 2)
+        return static_cast<std::size_t>(resident_pages) * sysconf(_SC_PAGESIZE);
+    }
+#endif
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+      return 0;
+#ifdef __APPLE__
+    // ru_maxrss is in bytes on Mac OS X, and kilobytes elsewhere.
+    return usage.ru_maxrss;
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+  }
+};
+
+
+#endif /* !_SEARCH_BUDGET_HPP_ */
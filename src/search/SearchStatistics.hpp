@@ -0,0 +1,238 @@
+#ifndef _SEARCH_STATISTICS_HPP_
+#define _SEARCH_STATISTICS_HPP_
+
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/*! \brief A flat record of named search statistics, written as a JSON
+    object or a CSV row.
+
+    Every searcher fills one of these the same way from
+    get_statistics(), and the driver adds the figures that are not the
+    searcher's business, such as times and memory use.  Fields keep the
+    order in which they were first set.  Statistics kept per abstraction
+    level are named level<N>_<name>, so that records stay flat enough for
+    CSV.
+*/
+class SearchStatistics
+{
+public:
+  enum Format { text_format, json_format, csv_format };
+
+  //! Parses "text", "json" or "csv".
+  static bool parse_format(const std::string &name, Format &format)
+  {
+    if (name == "text")
+      format = text_format;
+    else if (name == "json")
+      format = json_format;
+    else if (name == "csv")
+      format = csv_format;
+    else
+      return false;
+    return true;
+  }
+
+
+private:
+  struct Field
+  {
+    std::string key;
+    std::string value;
+    // Whether the value is a string, rather than a number or null.
+    bool is_string;
+  };
+
+  std::vector<Field> fields;
+
+
+public:
+  void set_count(const std::string &key, unsigned long long value)
+  {
+    std::ostringstream o;
+    o << value;
+    set(key, o.str(), false);
+  }
+
+  void set_real(const std::string &key, double value)
+  {
+    std::ostringstream o;
+    o << value;
+    set(key, o.str(), false);
+  }
+
+  void set_string(const std::string &key, const std::string &value)
+  {
+    set(key, value, true);
+  }
+
+  void set_null(const std::string &key)
+  {
+    set(key, "null", false);
+  }
+
+  void set_level_count(unsigned level,
+                       const std::string &key,
+                       unsigned long long value)
+  {
+    set_count(level_key(level, key), value);
+  }
+
+  static std::string level_key(unsigned level, const std::string &key)
+  {
+    std::ostringstream o;
+    o << "level" << level << "_" << key;
+    return o.str();
+  }
+
+
+  //! Writes the record as a single-line JSON object.
+  void write_json(std::ostream &o) const
+  {
+    o << "{";
+    for (unsigned i = 0; i < fields.size(); i += 1) {
+      if (i > 0)
+        o << ", ";
+      write_json_string(o, fields[i].key);
+      o << ": ";
+      if (fields[i].is_string)
+        write_json_string(o, fields[i].value);
+      else
+        o << fields[i].value;
+    }
+    o << "}" << std::endl;
+  }
+
+  void write_csv_header(std::ostream &o) const
+  {
+    for (unsigned i = 0; i < fields.size(); i += 1)
+      o << (i > 0 ? "," : "") << fields[i].key;
+    o << std::endl;
+  }
+
+  void write_csv_row(std::ostream &o) const
+  {
+    for (unsigned i = 0; i < fields.size(); i += 1) {
+      if (i > 0)
+        o << ",";
+      write_csv_value(o, fields[i]);
+    }
+    o << std::endl;
+  }
+
+  /*! \brief Writes the record as a row under the given header, leaving
+      empty the columns it has no field for.
+   */
+  void write_csv_row(std::ostream &o, const std::string &header) const
+  {
+    std::string::size_type begin = 0;
+    for (bool first = true; begin <= header.size(); first = false) {
+      std::string::size_type end = header.find(',', begin);
+      if (end == std::string::npos)
+        end = header.size();
+
+      if (!first)
+        o << ",";
+      const Field *field = find(header.substr(begin, end - begin));
+      if (field != NULL)
+        write_csv_value(o, *field);
+
+      begin = end + 1;
+    }
+    o << std::endl;
+  }
+
+  //! Writes the record as JSON, or as a CSV header and row.
+  void write(std::ostream &o, Format format) const
+  {
+    assert(format != text_format);
+    if (format == json_format) {
+      write_json(o);
+    }
+    else {
+      write_csv_header(o);
+      write_csv_row(o);
+    }
+  }
+
+
+private:
+  void set(const std::string &key, const std::string &value, bool is_string)
+  {
+    Field *field = find(key);
+    if (field == NULL) {
+      fields.push_back(Field());
+      field = &fields.back();
+      field->key = key;
+    }
+    field->value = value;
+    field->is_string = is_string;
+  }
+
+  Field * find(const std::string &key)
+  {
+    for (unsigned i = 0; i < fields.size(); i += 1)
+      if (fields[i].key == key)
+        return &fields[i];
+    return NULL;
+  }
+
+  const Field * find(const std::string &key) const
+  {
+    for (unsigned i = 0; i < fields.size(); i += 1)
+      if (fields[i].key == key)
+        return &fields[i];
+    return NULL;
+  }
+
+  static void write_json_string(std::ostream &o, const std::string &s)
+  {
+    o << '"';
+    for (unsigned i = 0; i < s.size(); i += 1) {
+      const unsigned char c = s[i];
+      if (c == '"' || c == '\\') {
+        o << '\\' << c;
+      }
+      else if (c < 0x20) {
+        char escape[8];
+        snprintf(escape, sizeof(escape), "\\u%04x", c);
+        o << escape;
+      }
+      else {
+        o << c;
+      }
+    }
+    o << '"';
+  }
+
+  static void write_csv_value(std::ostream &o, const Field &field)
+  {
+    if (!field.is_string) {
+      if (field.value != "null")
+        o << field.value;
+      return;
+    }
+
+    if (field.value.find_first_of(",\"\n") == std::string::npos) {
+      o << field.value;
+      return;
+    }
+
+    o << '"';
+    for (unsigned i = 0; i < field.value.size(); i += 1) {
+      if (field.value[i] == '"')
+        o << '"';
+      o << field.value[i];
+    }
+    o << '"';
+  }
+};
+
+
+#endif /* !_SEARCH_STATISTICS_HPP_ */
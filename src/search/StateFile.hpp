@@ -0,0 +1,320 @@
+#ifndef _STATE_FILE_HPP_
+#define _STATE_FILE_HPP_
+
+
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <time.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+
+/*! \brief The volume of, and time spent on, the reads and writes of
+    state files.
+*/
+struct IOStatistics
+{
+  boost::uint64_t bytes_read;
+  boost::uint64_t bytes_written;
+  double seconds;
+
+  IOStatistics()
+    : bytes_read(0)
+    , bytes_written(0)
+    , seconds(0)
+  {
+  }
+
+  static double now()
+  {
+#if defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+  }
+
+  static void fail(const char *what, const std::string &path)
+  {
+    throw std::runtime_error(std::string("cannot ") + what + " " + path
+                             + ": " + strerror(errno));
+  }
+};
+
+
+//! Orders states by their bytes, the order of sorted state files.
+template <class State>
+struct StateBytesLess
+{
+  bool operator ()(const State &a, const State &b) const
+  {
+    return memcmp(&a, &b, sizeof(State)) < 0;
+  }
+};
+
+
+/*! \brief Appends states to a file, in large sequential writes.
+
+    A state file is the bytes of its states, back to back, so the
+    states must be plain values with no padding, as the domains' states
+    are.
+*/
+template <class State>
+class StateFileWriter : boost::noncopyable
+{
+private:
+  std::string path;
+  int fd;
+  IOStatistics &io;
+
+  std::vector<State> buffer;
+  std::size_t buffered;
+  boost::uint64_t num_written;
+
+
+public:
+  /*! \param buffer_states  The number of states written at a time
+      \param append         Whether to add to the file, rather than
+                            replace it
+   */
+  StateFileWriter(const std::string &path,
+                  IOStatistics &io,
+                  std::size_t buffer_states,
+                  bool append = false)
+    : path(path)
+    , fd(-1)
+    , io(io)
+    , buffer(buffer_states)
+    , buffered(0)
+    , num_written(0)
+  {
+    assert(buffer_states > 0);
+    fd = open(path.c_str(),
+              O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC),
+              0644);
+    if (fd == -1)
+      IOStatistics::fail("create", path);
+  }
+
+  ~StateFileWriter()
+  {
+    if (fd != -1)
+      ::close(fd);
+  }
+
+  void put(const State &s)
+  {
+    buffer[buffered] = s;
+    buffered += 1;
+    num_written += 1;
+    if (buffered == buffer.size())
+      flush();
+  }
+
+  //! The number of states put.
+  boost::uint64_t size() const
+  {
+    return num_written;
+  }
+
+  void close()
+  {
+    flush();
+    if (::close(fd) != 0) {
+      fd = -1;
+      IOStatistics::fail("close", path);
+    }
+    fd = -1;
+  }
+
+
+private:
+  void flush()
+  {
+    if (buffered == 0)
+      return;
+
+    const double start = IOStatistics::now();
+    const char *p = reinterpret_cast<const char *>(&buffer[0]);
+    std::size_t left = buffered * sizeof(State);
+    while (left > 0) {
+      const ssize_t n = write(fd, p, left);
+      if (n == -1) {
+        if (errno == EINTR)
+          continue;
+        IOStatistics::fail("write", path);
+      }
+      p += n;
+      left -= n;
+    }
+    io.bytes_written += buffered * sizeof(State);
+    io.seconds += IOStatistics::now() - start;
+    buffered = 0;
+  }
+};
+
+
+/*! \brief Reads the states of a file, or of a run of them in memory,
+    in order, in large sequential reads.
+*/
+template <class State>
+class StateFileReader : boost::noncopyable
+{
+private:
+  std::string path;
+  int fd;
+  IOStatistics *io;
+
+  std::vector<State> buffer;
+  std::size_t pos;
+  std::size_t buffer_states;
+
+
+public:
+  StateFileReader(const std::string &path,
+                  IOStatistics &io,
+                  std::size_t buffer_states)
+    : path(path)
+    , fd(-1)
+    , io(&io)
+    , buffer()
+    , pos(0)
+    , buffer_states(buffer_states)
+  {
+    assert(buffer_states > 0);
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      IOStatistics::fail("open", path);
+    fill();
+  }
+
+  //! Reads the given states, which it takes, rather than a file.
+  StateFileReader(std::vector<State> &states)
+    : path()
+    , fd(-1)
+    , io(NULL)
+    , buffer()
+    , pos(0)
+    , buffer_states(0)
+  {
+    buffer.swap(states);
+  }
+
+  ~StateFileReader()
+  {
+    if (fd != -1)
+      ::close(fd);
+  }
+
+  bool empty() const
+  {
+    return pos == buffer.size();
+  }
+
+  const State & front() const
+  {
+    assert(!empty());
+    return buffer[pos];
+  }
+
+  void pop()
+  {
+    assert(!empty());
+    pos += 1;
+    if (pos == buffer.size() && fd != -1)
+      fill();
+  }
+
+
+  /*! \brief Whether the given file, of the given number of states in
+      increasing order of their bytes, holds the state.  This reads a
+      state at a time, and is for the odd lookup.
+   */
+  static bool contains(const std::string &path,
+                       boost::uint64_t num_states,
+                       const State &s,
+                       IOStatistics &io)
+  {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      IOStatistics::fail("open", path);
+
+    const double start = IOStatistics::now();
+    boost::uint64_t lo = 0;
+    boost::uint64_t hi = num_states;
+    bool found = false;
+    while (lo < hi && !found) {
+      const boost::uint64_t mid = lo + (hi - lo) / 2;
+      State t;
+      if (pread(fd, &t, sizeof(State), mid * sizeof(State))
+          != static_cast<ssize_t>(sizeof(State))) {
+        ::close(fd);
+        IOStatistics::fail("read", path);
+      }
+      io.bytes_read += sizeof(State);
+
+      const int c = memcmp(&t, &s, sizeof(State));
+      if (c < 0)
+        lo = mid + 1;
+      else if (c > 0)
+        hi = mid;
+      else
+        found = true;
+    }
+    io.seconds += IOStatistics::now() - start;
+
+    ::close(fd);
+    return found;
+  }
+
+
+private:
+  void fill()
+  {
+    buffer.resize(buffer_states);
+    pos = 0;
+
+    const double start = IOStatistics::now();
+    char *p = reinterpret_cast<char *>(&buffer[0]);
+    std::size_t got = 0;
+    const std::size_t want = buffer_states * sizeof(State);
+    while (got < want) {
+      const ssize_t n = read(fd, p + got, want - got);
+      if (n == -1) {
+        if (errno == EINTR)
+          continue;
+        IOStatistics::fail("read", path);
+      }
+      if (n == 0)
+        break;
+      got += n;
+    }
+    assert(got % sizeof(State) == 0);
+    io->bytes_read += got;
+    io->seconds += IOStatistics::now() - start;
+
+    buffer.resize(got / sizeof(State));
+    if (buffer.empty()) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+};
+
+
+#endif /* !_STATE_FILE_HPP_ */
@@ -0,0 +1,94 @@
+#ifndef _SUCCESSOR_BUFFER_HPP_
+#define _SUCCESSOR_BUFFER_HPP_
+
+
+#include <cassert>
+
+#include <boost/array.hpp>
+#include <boost/utility.hpp>
+
+
+/*! \brief A fixed-capacity list of successors, given as states rather
+    than nodes.
+
+    Domains fill one of these from compute_successor_states() (and
+    compute_predecessor_states()), so that a searcher can look each
+    successor up in its closed list and allocate a node only for those
+    it keeps.  The buffer lives on the stack and never allocates.
+
+    \tparam StateT    The domain's state type
+    \tparam CostT     The domain's cost type
+    \tparam Capacity  The largest number of successors of any state
+*/
+template <
+  class StateT,
+  class CostT,
+  unsigned Capacity
+  >
+class SuccessorBuffer : boost::noncopyable
+{
+public:
+  typedef StateT State;
+  typedef CostT Cost;
+
+  static const unsigned capacity = Capacity;
+
+  struct Successor
+  {
+    State state;
+    Cost g;
+    // The domain-specific operator that generated the state, such as
+    // the new position of the blank or the number of pancakes flipped.
+    unsigned char op;
+  };
+
+
+private:
+  boost::array<Successor, Capacity> successors;
+  unsigned num_successors;
+
+
+public:
+  SuccessorBuffer()
+    : num_successors(0)
+  {
+  }
+
+  void clear()
+  {
+    num_successors = 0;
+  }
+
+  void push_back(const State &state, Cost g, unsigned op)
+  {
+    assert(num_successors < Capacity);
+    Successor &s = successors[num_successors];
+    s.state = state;
+    s.g = g;
+    s.op = op;
+    num_successors += 1;
+  }
+
+  unsigned size() const
+  {
+    return num_successors;
+  }
+
+  bool empty() const
+  {
+    return num_successors == 0;
+  }
+
+  const Successor & operator [](unsigned i) const
+  {
+    assert(i < num_successors);
+    return successors[i];
+  }
+};
+
+
+template <class StateT, class CostT, unsigned Capacity>
+const unsigned SuccessorBuffer<StateT, CostT, Capacity>::capacity;
+
+
+#endif /* !_SUCCESSOR_BUFFER_HPP_ */
@@ -0,0 +1,156 @@
+#ifndef _TRANSPOSITION_TABLE_HPP_
+#define _TRANSPOSITION_TABLE_HPP_
+
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility.hpp>
+
+
+/*! \brief A fixed-size transposition table for iterative-deepening
+    searches.
+
+    Each slot holds at most one state, with what the last search of it
+    learned: the depth (g-value) it was searched at, the iteration it
+    was searched in, a backed-up heuristic value, and the move state it
+    was searched with.  A state hashes to a single slot, and when two
+    states want the same slot the replacement policy decides which one
+    keeps it, so the table never grows past the memory it was given.
+
+    \tparam State      The type of the states
+    \tparam Cost       The type of g and heuristic values
+    \tparam MoveState  The type of the domain's move states
+*/
+template <
+  class State,
+  class Cost,
+  class MoveState
+  >
+class TranspositionTable : boost::noncopyable
+{
+public:
+  enum ReplacementPolicy {
+    //! A new entry always takes the slot.
+    replace_always,
+    //! A new entry takes the slot from one made in an earlier
+    //! iteration, or at a greater or equal depth, so the entries for
+    //! the larger subtrees are kept.
+    prefer_shallow
+  };
+
+  struct Entry
+  {
+    State state;
+    // The iteration the state was last searched in, with 0 for none.
+    unsigned iteration;
+    Cost g;
+    Cost h;
+    MoveState ms;
+  };
+
+
+private:
+  std::vector<Entry> slots;
+  std::size_t mask;
+  const ReplacementPolicy policy;
+
+  unsigned num_stored;
+  unsigned num_replaced;
+
+
+public:
+  /*! \param max_bytes  The memory the slots may take, which is rounded
+                        down to a power of two slots
+   */
+  TranspositionTable(std::size_t max_bytes, ReplacementPolicy policy)
+    : slots()
+    , mask(0)
+    , policy(policy)
+    , num_stored(0)
+    , num_replaced(0)
+  {
+    std::size_t num_slots = 1;
+    while (num_slots * 2 * sizeof(Entry) <= max_bytes)
+      num_slots *= 2;
+
+    Entry empty;
+    empty.iteration = 0;
+    slots.assign(num_slots, empty);
+    mask = num_slots - 1;
+  }
+
+  static bool parse_policy(const std::string &name, ReplacementPolicy &policy)
+  {
+    if (name == "always")
+      policy = replace_always;
+    else if (name == "shallow")
+      policy = prefer_shallow;
+    else
+      return false;
+    return true;
+  }
+
+  std::size_t size() const
+  {
+    return slots.size();
+  }
+
+  std::size_t get_bytes() const
+  {
+    return slots.size() * sizeof(Entry);
+  }
+
+  unsigned get_num_stored() const
+  {
+    return num_stored;
+  }
+
+  unsigned get_num_replaced() const
+  {
+    return num_replaced;
+  }
+
+  //! The entry for the given state, or NULL if it is not in the table.
+  const Entry * find(const State &s) const
+  {
+    const Entry &e = slots[slot_of(s)];
+    return e.iteration != 0 && e.state == s ? &e : NULL;
+  }
+
+  void store(const State &s, unsigned iteration, Cost g, Cost h, MoveState ms)
+  {
+    assert(iteration != 0);
+    Entry &e = slots[slot_of(s)];
+
+    if (e.iteration != 0 && !(e.state == s)) {
+      if (policy == prefer_shallow && e.iteration == iteration && e.g < g)
+        return;
+      num_replaced += 1;
+    }
+
+    num_stored += 1;
+    e.state = s;
+    e.iteration = iteration;
+    e.g = g;
+    e.h = h;
+    e.ms = ms;
+  }
+
+
+private:
+  std::size_t slot_of(const State &s) const
+  {
+    // Mixed, as the states' hashes need not spread over the low bits.
+    const boost::uint64_t h =
+      static_cast<boost::uint64_t>(hash_value(s)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<std::size_t>(h >> 32) & mask;
+  }
+};
+
+
+#endif /* !_TRANSPOSITION_TABLE_HPP_ */
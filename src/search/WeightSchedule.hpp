@@ -0,0 +1,228 @@
+#ifndef _WEIGHT_SCHEDULE_HPP_
+#define _WEIGHT_SCHEDULE_HPP_
+
+
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief The weights of an anytime weighted search, lowered as in
+    ARA* (Likhachev, Gordon and Thrun, 2003), and the solutions found
+    with them.
+
+    The search starts with the initial weight, and each time it runs out
+    of nodes that could improve on its solution at the current weight,
+    it lowers the weight by the step, down to one, and goes on with the
+    same open list.  A step of zero keeps the initial weight: the search
+    is then plain weighted A*, and stops at its first solution.
+
+    The searcher records each solution as it finds it, with the smallest
+    f-value on its open list.  That gives the solution's suboptimality
+    bound, which is reported on the given stream, so that the search
+    can be stopped at any time for the best solution so far.  At the end
+    of each weight, the searcher finishes it with the smallest f-value
+    of the nodes that may still improve on the solution, which can only
+    tighten the bound.
+*/
+class WeightSchedule
+{
+public:
+  //! Weights are in thousandths of this.
+  static const unsigned unit = 1000;
+
+private:
+  struct Solution
+  {
+    unsigned weight;
+    unsigned cost;
+    double bound;
+    unsigned long expanded;
+    double seconds;
+  };
+
+  unsigned initial_weight;
+  unsigned step;
+  unsigned weight;
+  unsigned num_weights_searched;
+
+  double start_time;
+  std::vector<Solution> solutions;
+
+  std::ostream *progress;
+
+public:
+  /*! \param initial_weight  The first weight, in thousandths
+      \param step            How much to lower the weight after each
+                             solution, in thousandths
+      \param progress        The stream to report solutions on, or NULL
+   */
+  WeightSchedule(unsigned initial_weight = unit,
+                 unsigned step = 0,
+                 std::ostream *progress = NULL)
+    : initial_weight(initial_weight)
+    , step(step)
+    , weight(initial_weight)
+    , num_weights_searched(0)
+    , start_time(0)
+    , solutions()
+    , progress(progress)
+  {
+    assert(initial_weight >= unit);
+  }
+
+  //! Whether the search is weighted at all.
+  bool is_weighted() const
+  {
+    return initial_weight != unit;
+  }
+
+  unsigned get_weight() const
+  {
+    return weight;
+  }
+
+  void start()
+  {
+    start_time = now();
+  }
+
+  /*! Records a solution found at the current weight, given the
+      smallest f-value on the open list (at most the cost).
+   */
+  void record(unsigned cost, unsigned lower_bound, unsigned long expanded)
+  {
+    Solution s;
+    s.weight = weight;
+    s.cost = cost;
+    s.bound = compute_bound(cost, lower_bound);
+    s.expanded = expanded;
+    s.seconds = now() - start_time;
+    solutions.push_back(s);
+    report(s);
+  }
+
+  /*! Ends the search at the current weight, given the smallest f-value
+      of the nodes that may still improve on the solution (its cost if
+      there are none), and lowers the weight.  Returns whether to search
+      again, which there is no need to once the weight was the last one,
+      or the solution is known to be optimal.
+   */
+  bool finish_weight(unsigned lower_bound)
+  {
+    assert(has_solution());
+    num_weights_searched += 1;
+
+    Solution &s = solutions.back();
+    const double bound = compute_bound(s.cost, lower_bound);
+    if (bound < s.bound) {
+      s.bound = bound;
+      report(s);
+    }
+
+    if (weight == unit || step == 0 || lower_bound == s.cost)
+      return false;
+    if (weight - unit > step)
+      weight -= step;
+    else
+      weight = unit;
+    return true;
+  }
+
+  bool has_solution() const
+  {
+    return !solutions.empty();
+  }
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    stats.set_real("initial_weight", static_cast<double>(initial_weight) / unit);
+    stats.set_count("weights_searched", num_weights_searched);
+    if (solutions.empty())
+      return;
+
+    stats.set_real("final_weight", static_cast<double>(weight) / unit);
+    stats.set_real("suboptimality_bound", solutions.back().bound);
+    stats.set_count("first_solution_cost", solutions.front().cost);
+    stats.set_count("first_solution_expanded", solutions.front().expanded);
+    stats.set_real("first_solution_time", solutions.front().seconds);
+  }
+
+  void output(std::ostream &o) const
+  {
+    o << "solutions, by the weight they were found with:" << std::endl;
+    for (unsigned i = 0; i < solutions.size(); i += 1)
+      write_solution(o, solutions[i]);
+  }
+
+private:
+  static double compute_bound(unsigned cost, unsigned lower_bound)
+  {
+    return lower_bound == 0 ? 1.0 : static_cast<double>(cost) / lower_bound;
+  }
+
+  void report(const Solution &s) const
+  {
+    if (progress != NULL) {
+      write_solution(*progress, s);
+      progress->flush();
+    }
+  }
+
+  static void write_solution(std::ostream &o, const Solution &s)
+  {
+    const std::ios::fmtflags flags = o.flags();
+    const std::streamsize precision = o.precision();
+    o << std::fixed << std::setprecision(3)
+      << "  weight " << static_cast<double>(s.weight) / unit
+      << ": cost " << s.cost
+      << ", bound " << s.bound
+      << ", " << s.expanded << " expanded, "
+      << s.seconds << " s" << std::endl;
+    o.flags(flags);
+    o.precision(precision);
+  }
+
+  static double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+};
+
+
+/*! \brief The priority g + w * h of weighted A*, for a
+    BucketPriorityQueue.
+
+    The weight is in thousandths, and w * h is rounded down, which keeps
+    the cost of a solution found within w times the optimal cost.  With
+    a weight of one, the priority is the f-value.
+*/
+template <class Node>
+class WeightedPriority
+{
+private:
+  unsigned weight;
+
+public:
+  WeightedPriority(unsigned weight = WeightSchedule::unit)
+    : weight(weight)
+  {
+  }
+
+  unsigned operator ()(const Node &n) const
+  {
+    if (weight == WeightSchedule::unit)
+      return n.get_f();
+    return n.get_g() + n.get_h() * weight / WeightSchedule::unit;
+  }
+};
+
+
+#endif /* !_WEIGHT_SCHEDULE_HPP_ */
@@ -2,21 +2,40 @@
 #define _A_STAR_HPP_
 
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
 #include <boost/none.hpp>
 #include <boost/optional.hpp>
 #include <boost/pool/pool.hpp>
-#include <boost/pool/pool_alloc.hpp>
-#include <boost/unordered_map.hpp>
 #include <boost/utility.hpp>
 
 #include "search/Constants.hpp"
 #include "search/BucketPriorityQueue.hpp"
-#include "util/PointerOps.hpp"
-
-
+#include "search/ClosedTable.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+#include "search/WeightSchedule.hpp"
+
+
+/*! \brief A*, or, given a weight schedule, anytime weighted A*.
+
+    With a weight over one, the search orders its open list by
+    g + w * h, and at each weight stops once no open node has a priority
+    under the cost of the best solution so far.  The weight is then
+    lowered, and the open list refiled by the new priority, as in ARA*.
+    Unlike ARA*, an expanded node reached again by a cheaper path goes
+    straight back on the open list, as in anytime weighted A* (Hansen and
+    Zhou, 2007), so that every solution is within its weight of the
+    optimal cost, and the smallest f-value on the open list bounds the
+    optimal cost from below.  The old copy of a reopened node stays
+    allocated, as its children may point to it, so memory grows with
+    each reopening, not just once.  Nodes whose f-value is at least the
+    solution's cost can not improve on it, and are dropped.  The best
+    solution so far is the goal, so the search can be stopped at any
+    time.  The heuristic must be consistent, as A*'s.
+*/
 template <
   class DomainT,
   class NodeT
@@ -32,21 +51,21 @@ public:
 
 
 private:
+  // Successors are generated as states, and become nodes only once
+  // they pass the duplicate check.
+  typedef typename Domain::Successors Successors;
+  typedef typename Successors::Successor Successor;
+
   // The priority queue type for the open list.
-  typedef BucketPriorityQueue<Node> Open;
+  typedef WeightedPriority<Node> Priority;
+  typedef BucketPriorityQueue<Node, Priority> Open;
   typedef boost::optional<typename Open::ItemPointer> MaybeItemPointer;
 
   // The `closed set' type.  This is a misnomer, as this
   // implementation of A* does pruning at node generation rather than
   // at node expansion, causing the `closed set' to contain nodes
   // whose states have been generated before, but not expanded.
-  typedef boost::unordered_map<
-    Node *,
-    MaybeItemPointer,
-    PointerHash<Node>,
-    PointerEq<Node>
-    , boost::fast_pool_allocator< std::pair<Node * const, MaybeItemPointer > >
-    > Closed;
+  typedef ClosedTable<Node, MaybeItemPointer> Closed;
 
   typedef typename Closed::iterator ClosedIterator;
   typedef typename Closed::const_iterator ClosedConstIterator;
@@ -76,20 +95,38 @@ private:
   unsigned num_expanded;
   // Search statistic for number of nodes generated.
   unsigned num_generated;
+  // The largest f-value expanded.
+  unsigned f_reached;
+  // The expanded nodes reached again by a cheaper path, in an anytime
+  // search.  Each leaves its old copy allocated.
+  unsigned num_reopened;
+
+  // The budget to check at each expansion, or NULL for none.
+  SearchBudget *budget;
+
+  // The weights to search with, and the solutions found with them.
+  WeightSchedule weights;
 
   // A memory pool to allow fast node allocation and deallocation.
-  boost::pool<> node_pool;
+  typename Node::Pool node_pool;
 
 
 public:
-  AStar(Domain &domain)
-    : open()
+  /*! \param weights  The weights to search with, by default just one,
+                      for optimal A*
+   */
+  AStar(Domain &domain, const WeightSchedule &weights = WeightSchedule())
+    : open(Priority(weights.get_weight()))
     , closed(INITIAL_CLOSED_SET_SIZE)
     , goal(NULL)
     , searched(false)
     , domain(domain)
     , num_expanded(0)
     , num_generated(0)
+    , f_reached(0)
+    , num_reopened(0)
+    , budget(NULL)
+    , weights(weights)
     , node_pool(sizeof(Node))
   {
   }
@@ -98,16 +135,19 @@ public:
   {
   }
 
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
   void search()
   {
     if (searched)
       return;
     searched = true;
 
-    std::vector<Node *> succs;    // re-use a stack-allocated vector
-                                  // for successor nodes, thus
-                                  // avoiding repeated heap
-                                  // allocation.
+    Successors succs;
 
     {
       assert(all_closed_item_ptrs_valid());
@@ -125,6 +165,11 @@ public:
       assert(all_closed_item_ptrs_valid());
     }
 
+    if (weights.is_weighted()) {
+      anytime_search(succs);
+      return;
+    }
+
     while (!open.empty())
     {
 #ifdef OUTPUT_SEARCH_PROGRESS
@@ -133,6 +178,8 @@ public:
                   << get_num_generated() << " total nodes generated" << std::endl;
       }
 #endif
+      if (budget != NULL)
+        budget->check(num_expanded);
 
       Node *n = open.top();
       open.pop();
@@ -145,9 +192,11 @@ public:
         return;
       }
 
-      domain.compute_successors(*n, succs, node_pool);
+      domain.compute_successor_states(*n, succs);
       num_expanded += 1;
       num_generated += succs.size();
+      if (n->get_f() > f_reached)
+        f_reached = n->get_f();
 
       for (unsigned succ_i = 0; succ_i < succs.size(); succ_i += 1)
       {
@@ -178,12 +227,30 @@ public:
   }
 
 
+  void get_statistics(SearchStatistics &stats) const
+  {
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("open_size", open.size());
+    stats.set_count("closed_size", closed.size());
+    stats.set_count("f_reached", f_reached);
+    if (weights.is_weighted()) {
+      stats.set_count("reopened", num_reopened);
+      weights.get_statistics(stats);
+    }
+  }
+
   void output_statistics(std::ostream &o) const
   {
     o << open.size() << " nodes in open at end of search" << std::endl
-      << closed.size() << " nodes in closed at end of search" << std::endl;
+      << closed.size() << " nodes in closed at end of search" << std::endl
+      << "largest f-value expanded is " << f_reached << std::endl;
 
-    if (get_goal() != NULL) {
+    if (weights.is_weighted()) {
+      o << num_reopened << " expanded nodes reopened" << std::endl;
+      weights.output(o);
+    }
+    else if (get_goal() != NULL) {
       const typename Node::Cost goal_f = get_goal()->get_f();
       unsigned num_expanded_less_than_goal_f = 0;
       for (ClosedConstIterator closed_it = closed.begin();
@@ -204,31 +271,156 @@ public:
 
 
 private:
-  void process_child(Node *parent, Node *child)
+  // Searches at each weight in turn, until the last one, or until the
+  // solution is known to be optimal.
+  void anytime_search(Successors &succs)
+  {
+    weights.start();
+
+    for (;;) {
+      improve_solution(succs);
+      if (goal == NULL)
+        return;
+
+      // Take every node that may still improve on the solution off the
+      // open list, to refile them by the next weight.
+      const unsigned cost = goal->get_g();
+      std::vector<Node *> improving;
+      unsigned lower_bound = cost;
+      while (!open.empty()) {
+        Node *n = open.top();
+        open.pop();
+        closed[n] = boost::none;
+        if (n->get_f() < cost) {
+          improving.push_back(n);
+          lower_bound = std::min<unsigned>(lower_bound, n->get_f());
+        }
+      }
+
+      const bool again = weights.finish_weight(lower_bound);
+      if (again)
+        open.set_priority(Priority(weights.get_weight()));
+      for (unsigned i = 0; i < improving.size(); i += 1)
+        closed[improving[i]] = open.push(improving[i]);
+
+      if (!again)
+        return;
+    }
+  }
+
+  // Expands nodes until none on the open list has a priority under the
+  // cost of the best solution, which becomes the goal.  Each solution is
+  // recorded when it is found, bounded by the smallest f-value on the
+  // open list, so that a search stopped mid-weight reports the goal it
+  // has.
+  void improve_solution(Successors &succs)
   {
+    while (!open.empty()) {
+      if (budget != NULL)
+        budget->check(num_expanded);
+
+      Node *n = open.top();
+      if (goal != NULL && open.get_priority()(*n) >= goal->get_g())
+        return;
+      open.pop();
+      closed[n] = boost::none;
+
+      if (domain.is_goal(n->get_state())) {
+        // Only nodes that could improve on the goal are kept.
+        assert(goal == NULL || n->get_g() < goal->get_g());
+        goal = n;
+        const unsigned cost = goal->get_g();
+        const unsigned lower_bound = open.empty()
+          ? cost
+          : std::min<unsigned>(cost, open.min_value(FPriority<Node>()));
+        weights.record(cost, lower_bound, num_expanded);
+        continue;
+      }
+
+      domain.compute_successor_states(*n, succs);
+      num_expanded += 1;
+      num_generated += succs.size();
+      if (n->get_f() > f_reached)
+        f_reached = n->get_f();
+
+      for (unsigned succ_i = 0; succ_i < succs.size(); succ_i += 1)
+        process_anytime_child(n, succs[succ_i]);
+    }
+  }
+
+  // As process_child(), but a child may be reached by a cheaper path
+  // after it has been expanded, and children that can not lead to a
+  // cheaper solution than the goal are not kept.
+  void process_anytime_child(Node *parent, const Successor &succ)
+  {
+    ClosedIterator closed_it = closed.find(succ.state);
+    if (closed_it != closed.end() && succ.g >= closed_it->first->get_g())
+      return;
+
+    Node *child = make_child(parent, succ);
+    if (goal != NULL && child->get_f() >= goal->get_g()) {
+      node_pool.free(child);
+      return;
+    }
+
+    if (closed_it == closed.end()) {
+      closed[child] = open.push(child);
+    }
+    else if (closed_it->second) {
+      open.erase(*closed_it->second);
+      node_pool.free(closed_it->first);
+      closed_it->first = child;
+      closed_it->second = open.push(child);
+    }
+    else {
+      // The old copy was expanded, and may be on the goal's path, so it
+      // is kept, and the child reopens its state.  Nothing refers to the
+      // old copy but its children, so it stays allocated until the
+      // search is destroyed: every reopening leaves one more node behind.
+      closed_it->first = child;
+      closed_it->second = open.push(child);
+      num_reopened += 1;
+    }
+  }
+
+  Node * make_child(Node *parent, const Successor &succ)
+  {
+    Node *child = new (node_pool.malloc()) Node(succ.state,
+                                                succ.g,
+                                                0,
+                                                parent);
     domain.compute_heuristic(*parent, *child);
+    return child;
+  }
+
+  void process_child(Node *parent, const Successor &succ)
+  {
     assert(open.size() <= closed.size());
     assert(all_closed_item_ptrs_valid());
 
-    ClosedIterator closed_it = closed.find(child);
+    // Copies of a state share its heuristic value, so comparing g
+    // values is the same as comparing f values.
+    ClosedIterator closed_it = closed.find(succ.state);
     if (closed_it == closed.end()) {
       // The child has not been generated before.
+      Node *child = make_child(parent, succ);
       closed[child] = open.push(child);
     }
-    else if (closed_it->second && child->get_f() < closed_it->first->get_f()) {
+    else if (closed_it->second && succ.g < closed_it->first->get_g()) {
       // A worse version of the child is in the open list.
+      Node *child = make_child(parent, succ);
       open.erase(*closed_it->second);  // remove old one from the open list
       // free the old, worse copy
       node_pool.free(closed_it->first);
-      closed.erase(closed_it);
 
-      closed[child] = open.push(child);  // insert better version of child
-    }
-    else {
-      // The child has either already been expanded, or is worse
-      // than the version in the open list.
-      node_pool.free(child);
+      // The child has the same state as the old copy, so it can take
+      // over the old copy's closed entry.
+      closed_it->first = child;
+      closed_it->second = open.push(child);  // insert better version of child
     }
+    // Otherwise the child has either already been expanded, or is no
+    // better than the version in the open list, and no node is made
+    // for it.
 
     assert(all_closed_item_ptrs_valid());
     assert(open.invariants_satisfied());
@@ -0,0 +1,620 @@
+#ifndef _EXTERNAL_A_STAR_HPP_
+#define _EXTERNAL_A_STAR_HPP_
+
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+#include "search/StateFile.hpp"
+
+
+/*! \brief External-memory A*, with delayed duplicate detection
+    (Edelkamp, Jabbar and Schroedl, 2004).
+
+    The open and closed lists are files in a scratch directory, one of
+    each for every (g, h) bucket, the same buckets that
+    BucketPriorityQueue keeps in memory.  Buckets are expanded in order
+    of f, and within an f-value in order of g, so that every child goes
+    to a bucket that is yet to be expanded.
+
+    A child is appended to its bucket's open file as it is generated,
+    with no duplicate check.  When the bucket comes up, its open file is
+    sorted, in runs that fit in the memory given, and the runs merged.
+    The merge drops the duplicates within the bucket, and, in a single
+    pass over the sorted closed files of buckets (g - 1, h) and
+    (g - 2, h), the states expanded before: in an undirected graph with
+    unit costs and a consistent heuristic, a state cannot have been
+    expanded anywhere else.  Each state that survives is written to the
+    bucket's closed file and expanded right away.  All reads and writes
+    of the search are sequential.
+
+    The solution is rebuilt backward from the goal: a predecessor of a
+    state at depth g is looked up in the closed file of depth g - 1 and
+    of its heuristic value, by binary search.
+
+    The domain must provide the in-place moves of IDAStar, with none
+    pruned in initial_move_state, and its states must be plain values
+    with no padding.  Every move must cost one.
+*/
+template <
+  class DomainT,
+  class NodeT
+  >
+class ExternalAStar : boost::noncopyable
+{
+public:
+  typedef DomainT Domain;
+  typedef NodeT Node;
+
+
+private:
+  typedef typename Node::State State;
+  typedef typename Node::Cost Cost;
+
+  typedef typename Domain::Move Move;
+  typedef typename Domain::Moves Moves;
+
+  typedef StateFileReader<State> Reader;
+  typedef StateFileWriter<State> Writer;
+
+  struct Bucket
+  {
+    // The states in the open file, duplicates and all, and in the
+    // closed file.
+    boost::uint64_t num_open;
+    boost::uint64_t num_closed;
+
+    Bucket()
+      : num_open(0)
+      , num_closed(0)
+    {
+    }
+  };
+
+
+private:
+  const Node *goal;
+  bool searched;
+
+  Domain &domain;
+
+  // The directory given, and the one made in it for this search.
+  const std::string base_dir;
+  std::string dir;
+
+  // The number of states sorted at a time, and read or written to a
+  // file at a time.
+  const std::size_t run_states;
+  const std::size_t buffer_states;
+
+  // buckets[g][h]
+  std::vector<std::vector<Bucket> > buckets;
+
+  IOStatistics io;
+
+  unsigned num_expanded;
+  unsigned num_generated;
+  unsigned num_buckets_expanded;
+  boost::uint64_t num_duplicates;
+  boost::uint64_t max_bucket_states;
+  boost::uint64_t disk_states;
+  boost::uint64_t max_disk_states;
+  // The f-value of the buckets expanded last.
+  unsigned f_reached;
+
+  // The budget to check at each expansion, or NULL for none.
+  SearchBudget *budget;
+
+  typename Node::Pool node_pool;
+
+
+public:
+  /*! \param dir           The directory in which to make the scratch
+                           directory for the search's files
+      \param memory_bytes  The memory for sorting a bucket
+   */
+  ExternalAStar(Domain &domain,
+                const std::string &dir,
+                std::size_t memory_bytes)
+    : goal(NULL)
+    , searched(false)
+    , domain(domain)
+    , base_dir(dir)
+    , dir()
+    , run_states(std::max<std::size_t>(1, memory_bytes / sizeof(State)))
+    , buffer_states(std::max<std::size_t>(1, EXTERNAL_A_STAR_IO_BUFFER_BYTES
+                                             / sizeof(State)))
+    , buckets()
+    , io()
+    , num_expanded(0)
+    , num_generated(0)
+    , num_buckets_expanded(0)
+    , num_duplicates(0)
+    , max_bucket_states(0)
+    , disk_states(0)
+    , max_disk_states(0)
+    , f_reached(0)
+    , budget(NULL)
+    , node_pool(sizeof(Node))
+  {
+  }
+
+  ~ExternalAStar()
+  {
+    remove_files();
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  void search()
+  {
+    if (searched)
+      return;
+    searched = true;
+
+    make_dir();
+    try {
+      external_search();
+    }
+    catch (...) {
+      remove_files();
+      throw;
+    }
+    remove_files();
+  }
+
+
+  const Node * get_goal() const
+  {
+    return goal;
+  }
+
+  const Domain & get_domain() const
+  {
+    return domain;
+  }
+
+  unsigned get_num_generated() const
+  {
+    return num_generated;
+  }
+
+  unsigned get_num_expanded() const
+  {
+    return num_expanded;
+  }
+
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("buckets_expanded", num_buckets_expanded);
+    stats.set_count("f_reached", f_reached);
+    stats.set_count("duplicates", num_duplicates);
+    stats.set_count("max_bucket_states", max_bucket_states);
+    stats.set_count("max_disk_bytes", max_disk_states * sizeof(State));
+    stats.set_count("io_bytes_read", io.bytes_read);
+    stats.set_count("io_bytes_written", io.bytes_written);
+    stats.set_real("io_time", io.seconds);
+    stats.set_real("io_mb_per_second", get_io_throughput());
+  }
+
+  void output_statistics(std::ostream &o) const
+  {
+    o << num_buckets_expanded << " buckets expanded, "
+      << num_duplicates << " duplicates dropped" << std::endl
+      << "last f-value expanded is " << f_reached << std::endl
+      << "largest bucket: " << max_bucket_states << " states" << std::endl
+      << "most disk used: "
+      << max_disk_states * sizeof(State) / (1024.0 * 1024.0) << " MB"
+      << std::endl
+      << "I/O: " << io.bytes_read / (1024.0 * 1024.0) << " MB read, "
+      << io.bytes_written / (1024.0 * 1024.0) << " MB written in "
+      << io.seconds << " seconds (" << get_io_throughput() << " MB/s)"
+      << std::endl;
+  }
+
+
+private:
+  double get_io_throughput() const
+  {
+    if (io.seconds == 0)
+      return 0;
+    return (io.bytes_read + io.bytes_written) / (1024.0 * 1024.0) / io.seconds;
+  }
+
+  static bool same(const State &a, const State &b)
+  {
+    return memcmp(&a, &b, sizeof(State)) == 0;
+  }
+
+  Bucket & get_bucket(unsigned g, unsigned h)
+  {
+    if (g >= buckets.size())
+      buckets.resize(g + 1);
+    if (h >= buckets[g].size())
+      buckets[g].resize(h + 1);
+    return buckets[g][h];
+  }
+
+  bool has_closed(unsigned g, unsigned h) const
+  {
+    return g < buckets.size() && h < buckets[g].size()
+      && buckets[g][h].num_closed > 0;
+  }
+
+  std::string get_path(unsigned g, unsigned h, const char *kind) const
+  {
+    std::ostringstream o;
+    o << dir << "/" << g << "-" << h << "." << kind;
+    return o.str();
+  }
+
+  std::string get_run_path(unsigned g, unsigned h, unsigned run) const
+  {
+    std::ostringstream o;
+    o << dir << "/" << g << "-" << h << ".run" << run;
+    return o.str();
+  }
+
+  void make_dir()
+  {
+    std::string name = base_dir + "/external-astar-XXXXXX";
+    std::vector<char> buf(name.begin(), name.end());
+    buf.push_back('\0');
+    if (mkdtemp(&buf[0]) == NULL)
+      IOStatistics::fail("make a directory in", base_dir);
+    dir = &buf[0];
+  }
+
+  void remove_files()
+  {
+    if (dir.empty())
+      return;
+
+    for (unsigned g = 0; g < buckets.size(); g += 1)
+      for (unsigned h = 0; h < buckets[g].size(); h += 1) {
+        unlink(get_path(g, h, "open").c_str());
+        unlink(get_path(g, h, "closed").c_str());
+        // Only a failed search leaves any runs behind.
+        for (unsigned i = 0; unlink(get_run_path(g, h, i).c_str()) == 0; i += 1)
+          ;
+      }
+    rmdir(dir.c_str());
+    dir.clear();
+  }
+
+
+  void external_search()
+  {
+    Node start_node(domain.get_start_state(), 0, 0);
+    domain.compute_heuristic(start_node);
+    {
+      Writer start_file(get_path(0, start_node.get_h(), "open"),
+                        io,
+                        buffer_states);
+      start_file.put(start_node.get_state());
+      start_file.close();
+    }
+    get_bucket(0, start_node.get_h()).num_open = 1;
+    disk_states = max_disk_states = 1;
+
+    unsigned f = start_node.get_h();
+    for (;;) {
+#ifdef OUTPUT_SEARCH_PROGRESS
+      std::cerr << "expanding the buckets of f = " << f << std::endl
+                << get_num_expanded() << " total nodes expanded" << std::endl
+                << get_num_generated() << " total nodes generated" << std::endl;
+#endif
+      f_reached = f;
+      for (unsigned g = 0; g <= f && g < buckets.size(); g += 1) {
+        const unsigned h = f - g;
+        if (h >= buckets[g].size() || buckets[g][h].num_open == 0)
+          continue;
+
+        State goal_state;
+        if (expand_bucket(g, h, goal_state)) {
+          goal = make_solution_path(goal_state, g, h);
+          return;
+        }
+      }
+
+      // With a consistent heuristic, the children of a bucket are at
+      // no smaller an f-value.
+      unsigned next_f = std::numeric_limits<unsigned>::max();
+      for (unsigned g = 0; g < buckets.size(); g += 1)
+        for (unsigned h = 0; h < buckets[g].size(); h += 1)
+          if (buckets[g][h].num_open > 0) {
+            assert(g + h > f);
+            next_f = std::min(next_f, g + h);
+          }
+
+      if (next_f == std::numeric_limits<unsigned>::max())
+        return;
+      f = next_f;
+    }
+  }
+
+
+  // Removes the duplicates from bucket (g, h), expanding the rest and
+  // making its closed file.  Returns true, with the state in
+  // goal_state, if a goal is found.
+  bool expand_bucket(unsigned g, unsigned h, State &goal_state)
+  {
+    // The buckets of the children are made as they are needed, so the
+    // bucket is looked up again after each step that adds some.
+    num_buckets_expanded += 1;
+    max_bucket_states = std::max(max_bucket_states, get_bucket(g, h).num_open);
+
+    std::vector<Reader *> runs;
+    std::vector<Reader *> expanded;
+    std::map<Cost, Writer *> children;
+    unsigned num_run_files = 0;
+    bool found = false;
+
+    try {
+      num_run_files = sort_runs(g, h, runs);
+
+      if (g >= 1 && has_closed(g - 1, h))
+        expanded.push_back(new Reader(get_path(g - 1, h, "closed"),
+                                      io,
+                                      buffer_states));
+      if (g >= 2 && has_closed(g - 2, h))
+        expanded.push_back(new Reader(get_path(g - 2, h, "closed"),
+                                      io,
+                                      buffer_states));
+
+      Writer closed(get_path(g, h, "closed"), io, buffer_states);
+      StateBytesLess<State> less;
+      State last;
+      bool have_last = false;
+
+      for (;;) {
+        Reader *min_run = NULL;
+        for (unsigned i = 0; i < runs.size(); i += 1)
+          if (!runs[i]->empty()
+              && (min_run == NULL || less(runs[i]->front(), min_run->front())))
+            min_run = runs[i];
+        if (min_run == NULL)
+          break;
+
+        const State s = min_run->front();
+        min_run->pop();
+
+        if (have_last && same(s, last)) {
+          num_duplicates += 1;
+          continue;
+        }
+        last = s;
+        have_last = true;
+
+        bool is_duplicate = false;
+        for (unsigned i = 0; i < expanded.size() && !is_duplicate; i += 1) {
+          Reader &e = *expanded[i];
+          while (!e.empty() && less(e.front(), s))
+            e.pop();
+          is_duplicate = !e.empty() && same(e.front(), s);
+        }
+        if (is_duplicate) {
+          num_duplicates += 1;
+          continue;
+        }
+
+        closed.put(s);
+        if (domain.is_goal(s)) {
+          goal_state = s;
+          found = true;
+          break;
+        }
+        expand(s, g, h, children);
+      }
+
+      closed.close();
+      get_bucket(g, h).num_closed = closed.size();
+      disk_states += closed.size();
+
+      for (typename std::map<Cost, Writer *>::iterator it = children.begin();
+           it != children.end();
+           ++it) {
+        it->second->close();
+        get_bucket(g + 1, it->first).num_open += it->second->size();
+        disk_states += it->second->size();
+      }
+    }
+    catch (...) {
+      free_files(runs, expanded, children);
+      throw;
+    }
+    free_files(runs, expanded, children);
+
+    for (unsigned i = 0; i < num_run_files; i += 1)
+      unlink(get_run_path(g, h, i).c_str());
+    unlink(get_path(g, h, "open").c_str());
+    max_disk_states = std::max(max_disk_states, disk_states);
+    disk_states -= get_bucket(g, h).num_open;
+    get_bucket(g, h).num_open = 0;
+
+    return found;
+  }
+
+  // Sorts the open file of bucket (g, h) into runs, without duplicates,
+  // each of which fits in memory.  All but the last are written to run
+  // files.  Returns the number of run files.
+  unsigned sort_runs(unsigned g, unsigned h, std::vector<Reader *> &runs)
+  {
+    const Bucket &bucket = get_bucket(g, h);
+    Reader in(get_path(g, h, "open"), io, buffer_states);
+
+    std::vector<State> run;
+    run.reserve(std::min<boost::uint64_t>(run_states, bucket.num_open));
+
+    unsigned num_run_files = 0;
+    while (!in.empty()) {
+      run.clear();
+      while (!in.empty() && run.size() < run_states) {
+        run.push_back(in.front());
+        in.pop();
+      }
+
+      std::sort(run.begin(), run.end(), StateBytesLess<State>());
+      const typename std::vector<State>::iterator end =
+        std::unique(run.begin(), run.end(), same);
+      num_duplicates += run.end() - end;
+      run.erase(end, run.end());
+
+      if (in.empty()) {
+        // The last run is read from memory.  The reader swaps the run's
+        // states into its buffer, rather than copying them, so that the
+        // bucket is only held once within the memory given.
+        runs.push_back(new Reader(run));
+        assert(run.empty());
+      }
+      else {
+        Writer out(get_run_path(g, h, num_run_files), io, buffer_states);
+        for (unsigned i = 0; i < run.size(); i += 1)
+          out.put(run[i]);
+        out.close();
+        num_run_files += 1;
+      }
+    }
+
+    for (unsigned i = 0; i < num_run_files; i += 1)
+      runs.push_back(new Reader(get_run_path(g, h, i), io, buffer_states));
+    return num_run_files;
+  }
+
+  static void free_files(std::vector<Reader *> &runs,
+                         std::vector<Reader *> &expanded,
+                         std::map<Cost, Writer *> &children)
+  {
+    for (unsigned i = 0; i < runs.size(); i += 1)
+      delete runs[i];
+    for (unsigned i = 0; i < expanded.size(); i += 1)
+      delete expanded[i];
+    for (typename std::map<Cost, Writer *>::iterator it = children.begin();
+         it != children.end();
+         ++it)
+      delete it->second;
+    runs.clear();
+    expanded.clear();
+    children.clear();
+  }
+
+  // Appends the children of state s, of bucket (g, h), to the open
+  // files of their buckets.
+  void expand(const State &s,
+              unsigned g,
+              Cost h,
+              std::map<Cost, Writer *> &children)
+  {
+    if (budget != NULL)
+      budget->check(num_expanded);
+
+    State t = s;
+    Moves moves;
+    const unsigned num_moves =
+      domain.compute_moves(t, Domain::initial_move_state, moves);
+    num_expanded += 1;
+    num_generated += num_moves;
+
+#ifdef OUTPUT_SEARCH_PROGRESS
+    if (get_num_expanded() % 1000000 == 0) {
+      std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                << get_num_generated() << " total nodes generated" << std::endl;
+    }
+#endif
+
+    for (unsigned i = 0; i < num_moves; i += 1) {
+      Cost child_h = h;
+      const Move undo = domain.apply_move(t, moves[i], child_h);
+      assert(child_h + 1 >= h);
+
+      typename std::map<Cost, Writer *>::iterator it = children.find(child_h);
+      if (it == children.end()) {
+        Writer *w = new Writer(get_path(g + 1, child_h, "open"),
+                               io,
+                               buffer_states,
+                               true);
+        it = children.insert(std::make_pair(child_h, w)).first;
+        get_bucket(g + 1, child_h);
+      }
+      it->second->put(t);
+
+      domain.undo_move(t, undo);
+    }
+  }
+
+
+  // Makes nodes for the path to the given goal state, of bucket (g, h),
+  // following it back through the closed files.  Returns the goal node.
+  const Node * make_solution_path(const State &goal_state,
+                                  unsigned goal_g,
+                                  Cost goal_h)
+  {
+    std::vector<State> path(goal_g + 1);
+    path[goal_g] = goal_state;
+
+    State s = goal_state;
+    Cost h = goal_h;
+    for (unsigned g = goal_g; g > 0; g -= 1) {
+      Moves moves;
+      const unsigned num_moves =
+        domain.compute_moves(s, Domain::initial_move_state, moves);
+
+      bool found = false;
+      for (unsigned i = 0; i < num_moves && !found; i += 1) {
+        Cost pred_h = h;
+        const Move undo = domain.apply_move(s, moves[i], pred_h);
+        if (has_closed(g - 1, pred_h)
+            && Reader::contains(get_path(g - 1, pred_h, "closed"),
+                                buckets[g - 1][pred_h].num_closed,
+                                s,
+                                io)) {
+          path[g - 1] = s;
+          h = pred_h;
+          found = true;
+        }
+        else {
+          domain.undo_move(s, undo);
+        }
+      }
+      assert(found);
+    }
+    assert(path[0] == domain.get_start_state());
+
+    const Node *n = NULL;
+    for (unsigned i = 0; i < path.size(); i += 1) {
+      Node *child = new (node_pool.malloc()) Node(path[i], i, 0, n);
+      domain.compute_heuristic(*child);
+      n = child;
+    }
+
+    assert(domain.is_goal(n->get_state()));
+    return n;
+  }
+};
+
+
+#endif /* !_EXTERNAL_A_STAR_HPP_ */
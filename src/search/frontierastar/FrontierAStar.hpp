@@ -0,0 +1,352 @@
+#ifndef _FRONTIER_A_STAR_HPP_
+#define _FRONTIER_A_STAR_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+#include "search/BucketPriorityQueue.hpp"
+#include "search/ClosedTable.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief Frontier A*, with divide-and-conquer solution
+    reconstruction (Korf, Zhang, Thayer and Hohwald, 2005).
+
+    Only the open nodes are kept: a node is freed once it has been
+    expanded.  In place of a closed list, each open node has a bit for
+    each move from its state, set once the move's result is known to
+    have been generated.  Generating a node sets the bit of the move
+    back to its parent, and finding it again on the open list sets the
+    bit for the move back to the new parent, so that, in an undirected
+    graph, no expanded state is ever generated again.  With a
+    consistent heuristic, an expanded node has its optimal g-value, so
+    nothing is lost by forgetting it.
+
+    As the nodes have no parents to follow, the solution is rebuilt by
+    divide and conquer.  Each node at or beyond the relay depth, half
+    the start's heuristic value, carries the state of its ancestor at
+    that depth, so the goal gives a state on an optimal path from
+    the start.  The searches from the start to that state, and from it
+    to the goal, are then solved the same way, down to problems of a
+    single move.
+
+    The domain must provide the in-place moves of IDAStar (with the
+    moves numbered below 32, and none pruned in initial_move_state),
+    and a constructor Domain(const Domain &, start, goal), for the same
+    domain between two other states.  Every move must cost one.
+*/
+template <
+  class DomainT,
+  class NodeT
+  >
+class FrontierAStar : boost::noncopyable
+{
+public:
+  typedef DomainT Domain;
+  typedef NodeT Node;
+
+
+private:
+  typedef typename Node::State State;
+  typedef typename Node::Cost Cost;
+
+  typedef typename Domain::Move Move;
+  typedef typename Domain::Moves Moves;
+
+  typedef BucketPriorityQueue<Node> Open;
+
+  // What the frontier knows of an open node's state.
+  struct FrontierEntry
+  {
+    // Bit m is set if move m leads to a generated state.
+    unsigned used_moves;
+    // The state of the node's ancestor at the relay depth, if the
+    // node is at least that deep.
+    State relay;
+
+    FrontierEntry()
+      : used_moves(0)
+      , relay()
+    {
+    }
+  };
+
+  typedef ClosedTable<Node, FrontierEntry> Frontier;
+  typedef typename Frontier::iterator FrontierIterator;
+
+
+private:
+  const Node *goal;
+  bool searched;
+
+  Domain &domain;
+
+  unsigned num_expanded;
+  unsigned num_generated;
+  unsigned num_searches;
+  unsigned first_expanded;
+  unsigned max_frontier_size;
+  // The largest f-value expanded by the first search.
+  unsigned f_reached;
+
+  // The budget to check at each expansion, or NULL for none.
+  SearchBudget *budget;
+
+  typename Node::Pool node_pool;
+
+
+public:
+  FrontierAStar(Domain &domain)
+    : goal(NULL)
+    , searched(false)
+    , domain(domain)
+    , num_expanded(0)
+    , num_generated(0)
+    , num_searches(0)
+    , first_expanded(0)
+    , max_frontier_size(0)
+    , f_reached(0)
+    , budget(NULL)
+    , node_pool(sizeof(Node))
+  {
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  void search()
+  {
+    if (searched)
+      return;
+    searched = true;
+
+    std::vector<State> path(1, domain.get_start_state());
+    if (solve(domain, path))
+      goal = make_solution_path(path);
+  }
+
+
+  const Node * get_goal() const
+  {
+    return goal;
+  }
+
+  const Domain & get_domain() const
+  {
+    return domain;
+  }
+
+  unsigned get_num_generated() const
+  {
+    return num_generated;
+  }
+
+  unsigned get_num_expanded() const
+  {
+    return num_expanded;
+  }
+
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("searches", num_searches);
+    stats.set_count("first_search_expanded", first_expanded);
+    stats.set_count("max_frontier_size", max_frontier_size);
+    stats.set_count("f_reached", f_reached);
+  }
+
+  void output_statistics(std::ostream &o) const
+  {
+    o << num_searches << " searches, the first expanding "
+      << first_expanded << " nodes" << std::endl
+      << max_frontier_size << " nodes in the largest frontier" << std::endl
+      << "largest f-value expanded by the first search is " << f_reached
+      << std::endl;
+  }
+
+
+private:
+  static unsigned move_bit(Move m)
+  {
+    assert(m < 32);
+    return 1u << m;
+  }
+
+  // Appends to path, whose last state must be d's start state, the
+  // states after it on an optimal path to d's goal.  Returns false if
+  // there is no path.
+  bool solve(const Domain &d, std::vector<State> &path)
+  {
+    assert(path.back() == d.get_start_state());
+
+    Node start_node(d.get_start_state(), 0, 0);
+    d.compute_heuristic(start_node);
+    const unsigned relay_depth = std::max<unsigned>(1, start_node.get_h() / 2);
+
+    unsigned cost = 0;
+    State relay;
+    if (!frontier_search(d, start_node.get_h(), relay_depth, cost, relay))
+      return false;
+
+    if (cost == 1) {
+      path.push_back(d.get_goal_state());
+    }
+    else if (cost > 1) {
+      // The relay depth is at most half the cost, so both halves are
+      // smaller problems.
+      assert(relay_depth < cost);
+      {
+        const Domain first(d, d.get_start_state(), relay);
+        solve(first, path);
+      }
+      {
+        const Domain second(d, relay, d.get_goal_state());
+        solve(second, path);
+      }
+    }
+
+    return true;
+  }
+
+  // A* from d's start state, keeping only the frontier.  If a goal is
+  // found, sets cost to its g-value and relay to the state of its
+  // ancestor at the given depth, which must be at most that cost, and
+  // returns true.
+  bool frontier_search(const Domain &d,
+                       Cost start_h,
+                       unsigned relay_depth,
+                       unsigned &cost,
+                       State &relay)
+  {
+    num_searches += 1;
+    const bool is_first = num_searches == 1;
+
+    // The nodes go with the pool, which must outlive the queue.
+    typename Node::Pool pool(sizeof(Node));
+    Open open;
+    Frontier frontier(INITIAL_CLOSED_SET_SIZE);
+
+    Node *start_node = new (pool.malloc()) Node(d.get_start_state(),
+                                                0,
+                                                start_h);
+    frontier[start_node] = FrontierEntry();
+    open.push(start_node);
+
+    bool found = false;
+    while (!open.empty()) {
+#ifdef OUTPUT_SEARCH_PROGRESS
+      if (get_num_expanded() % 1000000 == 0) {
+        std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                  << get_num_generated() << " total nodes generated" << std::endl;
+      }
+#endif
+      if (budget != NULL)
+        budget->check(num_expanded);
+      if (frontier.size() > max_frontier_size)
+        max_frontier_size = frontier.size();
+
+      Node *n = open.top();
+      open.pop();
+      FrontierIterator it = frontier.find(n);
+      assert(it != frontier.end());
+      const FrontierEntry entry = it->second;
+      frontier.erase(it);
+
+      if (d.is_goal(n->get_state())) {
+        assert(n->get_g() >= relay_depth || n->get_g() == 0);
+        cost = n->get_g();
+        relay = entry.relay;
+        found = true;
+        break;
+      }
+
+      expand(d, n, entry, relay_depth, open, frontier, pool);
+      if (is_first) {
+        first_expanded += 1;
+        if (n->get_f() > f_reached)
+          f_reached = n->get_f();
+      }
+      pool.free(n);
+    }
+
+    return found;
+  }
+
+  void expand(const Domain &d,
+              const Node *n,
+              const FrontierEntry &entry,
+              unsigned relay_depth,
+              Open &open,
+              Frontier &frontier,
+              typename Node::Pool &pool)
+  {
+    State s = n->get_state();
+    const Cost g = n->get_g() + 1;
+
+    Moves moves;
+    const unsigned num_moves =
+      d.compute_moves(s, Domain::initial_move_state, moves);
+    num_expanded += 1;
+
+    for (unsigned i = 0; i < num_moves; i += 1) {
+      if (entry.used_moves & move_bit(moves[i]))
+        continue;
+      num_generated += 1;
+
+      Cost h = n->get_h();
+      const Move undo = d.apply_move(s, moves[i], h);
+
+      FrontierIterator it = frontier.find(s);
+      if (it == frontier.end()) {
+        Node *child = new (pool.malloc()) Node(s, g, h);
+        FrontierEntry &child_entry = frontier[child];
+        child_entry.used_moves = move_bit(undo);
+        child_entry.relay = g == relay_depth ? s : entry.relay;
+        open.push(child);
+      }
+      else {
+        it->second.used_moves |= move_bit(undo);
+        if (g < it->first->get_g()) {
+          Node *child = new (pool.malloc()) Node(s, g, h);
+          open.erase(typename Open::ItemPointer(it->first));
+          pool.free(it->first);
+          it->first = child;
+          it->second.relay = g == relay_depth ? s : entry.relay;
+          open.push(child);
+        }
+      }
+
+      d.undo_move(s, undo);
+    }
+  }
+
+  // Makes nodes for the states of the solution path, returning the
+  // goal node.
+  const Node * make_solution_path(const std::vector<State> &path)
+  {
+    const Node *n = NULL;
+    for (unsigned i = 0; i < path.size(); i += 1) {
+      Node *child = new (node_pool.malloc()) Node(path[i], i, 0, n);
+      domain.compute_heuristic(*child);
+      n = child;
+    }
+
+    assert(domain.is_goal(n->get_state()));
+    return n;
+  }
+};
+
+
+#endif /* !_FRONTIER_A_STAR_HPP_ */
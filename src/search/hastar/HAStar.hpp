@@ -37,7 +37,13 @@
 #include <boost/utility.hpp>
 
 #include "search/BucketPriorityQueue.hpp"
-#include "util/PointerOps.hpp"
+#include "search/ClosedTable.hpp"
+#include "search/HeuristicCacheFile.hpp"
+#include "search/LevelProfile.hpp"
+#include "search/NodeArena.hpp"
+#include "search/PerfectHashing.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
 
 
 template <
@@ -55,16 +61,19 @@ private:
   typedef typename Node::Cost Cost;
   typedef typename Node::State State;
 
+  // Successors are generated as states, and become nodes only once
+  // they pass the duplicate check.
+  typedef typename Domain::Successors Successors;
+  typedef typename Successors::Successor Successor;
+
   typedef BucketPriorityQueue<Node> Open;
   typedef boost::optional<typename Open::ItemPointer> MaybeItemPointer;
 
-  typedef boost::unordered_map<
-    Node *,
-    MaybeItemPointer,
-    PointerHash<Node>,
-    PointerEq<Node>,
-    boost::fast_pool_allocator< std::pair<Node * const, MaybeItemPointer > >
-    > Closed;
+  typedef ClosedTable<Node, MaybeItemPointer> Closed;
+
+  // Each level's nodes come from an arena, so that they can be freed
+  // all at once, keeping the memory for the level's next search.
+  typedef NodeArena<Node> NodePool;
   typedef typename Closed::iterator ClosedIterator;
   typedef typename Closed::const_iterator ClosedConstIterator;
 
@@ -117,11 +126,18 @@ private:
   {
     p = c;
   }
+
+  static bool is_exact_cost(Cost c)
+  {
+    return false;
+  }
 #endif
 
   typedef typename Cache::iterator CacheIterator;
   typedef typename Cache::const_iterator CacheConstIterator;
 
+  typedef HeuristicCacheFile<State, Cost> CacheFile;
+
 
 private:
   const static unsigned hierarchy_height = Domain::num_abstraction_levels + 1;
@@ -134,6 +150,15 @@ private:
   boost::array<unsigned, hierarchy_height> num_expanded;
   boost::array<unsigned, hierarchy_height> num_generated;
 
+  // The largest f-value expanded at the base level.
+  unsigned f_reached;
+  // The budget to check at each expansion, at any level, or NULL for
+  // none.
+  SearchBudget *budget;
+
+  typedef LevelProfile<hierarchy_height> Profile;
+  Profile profile;
+
   boost::array<unsigned, hierarchy_height> cache_lookups;
   boost::array<unsigned, hierarchy_height> cache_hits;
 
@@ -141,13 +166,14 @@ private:
   boost::array<Closed, hierarchy_height> closed;
 
   Cache cache;
+  unsigned num_preloaded;
 
   // The abstractions of the goal node at each level.  It makes sense
   // to compute these once up front, rather than repeatedly computing
   // them.
   boost::array<State, hierarchy_height> goal_abstractions;
 
-  boost::array<boost::pool<> *, hierarchy_height> node_pool;
+  boost::array<NodePool *, hierarchy_height> node_pool;
 
 #ifdef HIERARCHICAL_A_STAR_CACHE_P_MINUS_G
   // A per-level vector of nodes that were expanded during a search,
@@ -172,11 +198,15 @@ public:
     , domain(domain)
     , num_expanded()
     , num_generated()
+    , f_reached(0)
+    , budget(NULL)
+    , profile()
     , cache_lookups()
     , cache_hits()
     , open()
     , closed()
     , cache()
+    , num_preloaded(0)
     , goal_abstractions()
     , node_pool()
 #ifdef HIERARCHICAL_A_STAR_CACHE_P_MINUS_G
@@ -193,7 +223,9 @@ public:
       goal_abstractions[i] = domain.abstract(i, domain.get_goal_state());
 
     for (unsigned i = 0; i < hierarchy_height; i += 1)
-      node_pool[i] = new boost::pool<>(sizeof(Node));
+      node_pool[i] = new NodePool(sizeof(Node));
+
+    use_perfect_hashing(domain, closed);
   }
 
   ~HAStar()
@@ -202,6 +234,12 @@ public:
       delete node_pool[i];
   }
 
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
   void search()
   {
     if (searched)
@@ -212,6 +250,63 @@ public:
   }
 
 
+  /*! \brief Preloads the cache with the entries saved by earlier runs
+      in the given directory, under the given name.
+   */
+  void load_cache(const std::string &dir,
+                  const std::string &name,
+                  std::ostream &log)
+  {
+    assert(!searched);
+    CacheFile file(dir, name, goal_abstractions);
+    if (!file.map(log))
+      return;
+
+    for (boost::uint64_t i = 0; i < file.size(); i += 1) {
+      State s;
+      Cost c;
+      bool is_exact;
+      file.get(i, s, c, is_exact);
+      set_cost(cache[s], c);
+#ifdef HIERARCHICAL_A_STAR_CACHE_OPTIMAL_PATHS
+      if (is_exact)
+        set_exact(cache[s]);
+#endif
+    }
+    num_preloaded = file.size();
+  }
+
+  /*! \brief Saves the cache entries of abstract states in the given
+      directory, under the given name.
+
+      Entries saved by other runs since this one loaded the cache are
+      kept.
+   */
+  void save_cache(const std::string &dir,
+                  const std::string &name,
+                  std::ostream &log) const
+  {
+    CacheFile file(dir, name, goal_abstractions);
+    for (CacheConstIterator it = cache.begin(); it != cache.end(); ++it) {
+      if (is_abstract_state(it->first))
+        file.add(it->first, get_cost(it->second), is_exact_cost(it->second));
+    }
+
+    if (file.map(log)) {
+      for (boost::uint64_t i = 0; i < file.size(); i += 1) {
+        State s;
+        Cost c;
+        bool is_exact;
+        file.get(i, s, c, is_exact);
+        if (cache.find(s) == cache.end())
+          file.add(s, c, is_exact);
+      }
+    }
+
+    file.save(log);
+  }
+
+
   const Node * get_goal() const
   {
     return goal;
@@ -253,6 +348,25 @@ public:
   }
 
 
+  void get_statistics(SearchStatistics &stats) const
+  {
+    assert(searched);
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("cache_size", cache.size());
+    stats.set_count("cache_preloaded", num_preloaded);
+    stats.set_count("f_reached", f_reached);
+    for (unsigned level = 0; level < hierarchy_height; level += 1) {
+      stats.set_level_count(level, "expanded", num_expanded[level]);
+      stats.set_level_count(level, "generated", num_generated[level]);
+      stats.set_level_count(level, "open_size", open[level].size());
+      stats.set_level_count(level, "closed_size", closed[level].size());
+      stats.set_level_count(level, "cache_lookups", cache_lookups[level]);
+      stats.set_level_count(level, "cache_hits", cache_hits[level]);
+    }
+    profile.get_statistics(stats);
+  }
+
   void output_statistics(std::ostream &o) const
   {
     assert(searched);
@@ -267,8 +381,12 @@ public:
         << " / " << num_generated[level] << std::endl;
     }
 
+    o << "largest f-value expanded at the base level is " << f_reached
+      << std::endl;
+
     dump_cache_size(o);
     dump_cache_information(o);
+    profile.output(o);
 
 #ifdef HIERARCHICAL_A_STAR_REEXPANSION_COUNTING
     dump_reexpansion_information(o);
@@ -280,6 +398,7 @@ private:
   Node * search_at_level(const unsigned level, const State &start_state)
   {
     assert(domain.is_valid_level(level));
+    typename Profile::Scope profile_scope(profile, level, num_expanded[level]);
     assert(open[level].empty());
     assert(closed[level].empty());
 #ifdef HIERARCHICAL_A_STAR_CACHE_P_MINUS_G
@@ -298,7 +417,7 @@ private:
 
     Node *goal_node = NULL;
 
-    std::vector<Node *> succs;
+    Successors succs;
     while (!open[level].empty()) {
 #ifdef OUTPUT_SEARCH_PROGRESS
       if (get_num_expanded() % 1000000 == 0) {
@@ -309,6 +428,8 @@ private:
         dump_cache_size(std::cerr);
       }
 #endif
+      if (budget != NULL)
+        budget->check(get_num_expanded());
 
       Node *n = open[level].top();
       open[level].pop();
@@ -359,15 +480,17 @@ private:
       }
 #endif      
 
-      domain.compute_successors(*n, succs, *node_pool[level]);
+      domain.compute_successor_states(*n, succs);
       num_expanded[level] += 1;
       num_generated[level] += succs.size();
+      if (level == 0 && n->get_f() > f_reached)
+        f_reached = n->get_f();
 #ifdef HIERARCHICAL_A_STAR_REEXPANSION_COUNTING
       expansion_count[n->get_state()] += 1;
 #endif
 
       for (unsigned succ_i = 0; succ_i < succs.size(); succ_i += 1)
-        process_child(level, succs[succ_i]);
+        process_child(level, n, succs[succ_i]);
     } /* end while */
 
     if (goal_node == NULL) {
@@ -380,54 +503,63 @@ private:
   }
 
 
-  void process_child(const unsigned level, Node *child)
+  void process_child(const unsigned level, Node *parent, const Successor &succ)
   {
     assert(domain.is_valid_level(level));
     assert(open[level].size() <= closed[level].size());
 
-    compute_heuristic(level, child);
-    assert(child->get_state() != goal_abstractions[level] || child->get_h() == 0);
+    ClosedIterator closed_it = closed[level].find(succ.state);
+    if (closed_it != closed[level].end() && !closed_it->second) {
+      // The child has already been expanded.
+      return;
+    }
+
+    // The heuristic only searches the levels above this one, so
+    // closed_it stays valid.
+    const Cost h = heuristic(level, succ.state);
+    assert(succ.state != goal_abstractions[level] || h == 0);
 
-    ClosedIterator closed_it = closed[level].find(child);
     if (closed_it == closed[level].end()) {
       // The child has not been generated before.
+      Node *child = new (node_pool[level]->malloc()) Node(succ.state,
+                                                          succ.g,
+                                                          h,
+                                                          parent);
       closed[level][child] = open[level].push(child);
     }
-    else if (closed_it->second && child->get_f() < closed_it->first->get_f()) {
+    else if (succ.g + h < closed_it->first->get_f()) {
       // A worse version of the child is in the open list.
+      Node *child = new (node_pool[level]->malloc()) Node(succ.state,
+                                                          succ.g,
+                                                          h,
+                                                          parent);
       open[level].erase(*closed_it->second);  // knock out the old one from
-                                       // the open list
+                                              // the open list
 
       // free the old, worse copy
       node_pool[level]->free(closed_it->first);
-      closed[level].erase(closed_it);
 
-      closed[level][child] = open[level].push(child);  // insert better version of
-                                         // child
-    }
-    else {
-      // The child has either already been expanded, or is worse
-      // than the version in the open list.
-      node_pool[level]->free(child);
+      // The child has the same state as the old copy, so it can take
+      // over the old copy's closed entry.
+      closed_it->first = child;
+      closed_it->second = open[level].push(child);  // insert better version of
+                                                    // child
     }
+    // Otherwise the child is no better than the version in the open
+    // list, and no node is made for it.
   }
 
 
-  void compute_heuristic (const unsigned level, Node *start_node)
+  Cost heuristic (const unsigned level, const State &start_state)
   {
     assert(domain.is_valid_level(level));
-    assert(start_node != NULL);
 
     const State &goal_state = goal_abstractions[level];
     assert(goal_state == domain.abstract(level, domain.get_goal_state()));
 
-    const State &start_state = start_node->get_state();
-
     // This conditional shouldn't have to be here, I think!
-    if (start_state == goal_state) {
-      start_node->set_h(0);
-      return;
-    }
+    if (start_state == goal_state)
+      return 0;
 
     // The following code checks the cache for the given node.  This
     // is different from the other hierarchical heuristic search
@@ -445,16 +577,13 @@ private:
     CacheIterator cache_it = cache.find(start_state);
     if (cache_it != cache.end()) {
       cache_hits[level] += 1;
-      start_node->set_h(get_cost(cache_it->second));
-      return;
+      return get_cost(cache_it->second);
     }
 
     const Cost epsilon = domain.get_epsilon(start_state);
 
-    if (level == Domain::num_abstraction_levels) {
-      start_node->set_h(start_state == goal_state ? 0 : epsilon);
-      return;
-    }
+    if (level == Domain::num_abstraction_levels)
+      return start_state == goal_state ? 0 : epsilon;
 
     const unsigned next_level = level + 1u;
     const State abstract_start = domain.abstract(next_level,
@@ -492,17 +621,16 @@ private:
     expanded_nodes[next_level].clear();
 #endif
 
-    // TODO: rather than calling purge_memory here, if closed at each
-    // level is itself allocated by a memory pool, the pool could be
-    // cleared, and the expensive closed[next_level].clear() operation
-    // could be avoided.  ~25% of the time is spent on that!
-    node_pool[next_level]->purge_memory();
+    // Each of these takes constant time (or time in the size of the
+    // open list), rather than time in the level's peak size, and keeps
+    // the level's memory for its next search.
+    node_pool[next_level]->reset();
     closed[next_level].clear();
     assert(closed[next_level].empty());
-    open[next_level].reset();
+    open[next_level].clear();
     assert(open[next_level].empty());
 
-    start_node->set_h(hval);
+    return hval;
   }
 
 
@@ -596,12 +724,15 @@ private:
   {
     o << "closed sizes: " << std::endl;
     for (unsigned level = 0; level < hierarchy_height; level += 1)
-      o << "  " << level << ": " << closed[level].size() << std::endl;
+      o << "  " << level << ": " << closed[level].size()
+        << (closed[level].uses_perfect_hash() ? " (dense)" : "") << std::endl;
   }
 
   void dump_cache_size(std::ostream &o) const
   {
     o << "cache size: " << cache.size() << std::endl;
+    if (num_preloaded > 0)
+      o << "preloaded cache entries: " << num_preloaded << std::endl;
   }
 
   void dump_cache_information(std::ostream &o) const
@@ -617,6 +748,15 @@ private:
     }
   }
 
+  // Whether the given state is at an abstract level.  The cached
+  // values of base-level states are of little use to other instances,
+  // so they are not saved.  Abstractions are nested, so abstracting a
+  // state that is already abstract to level 1 leaves it unchanged.
+  bool is_abstract_state(const State &s) const
+  {
+    return domain.abstract(1, s) == s;
+  }
+
 #ifdef HIERARCHICAL_A_STAR_REEXPANSION_COUNTING
   void dump_reexpansion_information(std::ostream &o) const
   {
@@ -0,0 +1,577 @@
+#ifndef _HDA_STAR_HPP_
+#define _HDA_STAR_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/none.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+#include "search/BucketPriorityQueue.hpp"
+#include "search/ClosedTable.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief Hash-distributed A* (HDA*), a multi-threaded A*.
+
+    Every state has an owning thread, chosen by hashing the state.  Each
+    thread keeps the open list, closed list and node pool for the states
+    it owns, and is the only one to touch them.  A thread expands its
+    best open node, and hands each successor to the successor's owner,
+    which does the duplicate check and makes a node if the successor is
+    kept.
+
+    Successors for other threads are gathered into per-destination
+    batches of up to HDA_STAR_BATCH_SIZE.  A full batch is pushed onto
+    its owner's inbox, a lock-free stack that the owner empties in one
+    atomic exchange.  Partial batches are sent every HDA_STAR_BATCH_SIZE
+    expansions, and whenever a thread runs out of work.
+
+    Threads do not expand nodes in global f order, so the first goal
+    expanded need not be optimal.  The cost of the best goal found so
+    far bounds the search: no thread expands a node whose f-value is
+    not below it, and states reached again more cheaply after their
+    expansion are reopened.  The search ends when no thread has a node
+    to expand and no batch is in flight, at which point the best goal
+    is optimal, given an admissible heuristic.
+
+    Termination is detected with a single shared count of the busy
+    threads plus the batches in flight.  A batch is counted before it is
+    sent, and a thread counts itself busy again before it uncounts the
+    batches it received, so the count only reaches zero once there is no
+    work left anywhere.
+
+    The domain is shared by the threads, so its successor, heuristic and
+    goal test functions must be safe to call concurrently.
+*/
+template <
+  class DomainT,
+  class NodeT
+  >
+class HDAStar : boost::noncopyable
+{
+public:
+  typedef DomainT Domain;
+  typedef NodeT Node;
+
+
+private:
+  typedef typename Node::State State;
+  typedef typename Node::Cost Cost;
+
+  typedef typename Domain::Successors Successors;
+  typedef typename Successors::Successor Successor;
+
+  typedef BucketPriorityQueue<Node> Open;
+  typedef boost::optional<typename Open::ItemPointer> MaybeItemPointer;
+
+  // As in A*, the closed list holds every generated state, mapped to
+  // its open list entry until the state is expanded.
+  typedef ClosedTable<Node, MaybeItemPointer> Closed;
+
+  typedef typename Closed::iterator ClosedIterator;
+  typedef typename Closed::const_iterator ClosedConstIterator;
+
+
+  // A successor on its way to its owning thread.
+  struct Message
+  {
+    Successor succ;
+    const Node *parent;
+  };
+
+  struct Batch
+  {
+    Batch *next;
+    unsigned size;
+    Message messages[HDA_STAR_BATCH_SIZE];
+  };
+
+
+  // The state owned by one thread.
+  struct Worker : boost::noncopyable
+  {
+    // Batches sent to this thread, pushed by the other threads.  It is
+    // padded out to a cache line of its own, as it is the only part of
+    // a worker written by other threads.
+    Batch * volatile inbox;
+    char inbox_padding[64 - sizeof(Batch *)];
+
+    Open open;
+    Closed closed;
+    typename Node::Pool node_pool;
+
+    // The batch being filled for each other thread, or NULL.
+    std::vector<Batch *> outgoing;
+
+    unsigned num_expanded;
+    unsigned num_generated;
+    unsigned num_reopened;
+    // The largest f-value this thread expanded.
+    unsigned f_reached;
+
+    Worker(unsigned num_threads)
+      : inbox(NULL)
+      , open()
+      , closed(INITIAL_CLOSED_SET_SIZE)
+      , node_pool(sizeof(Node))
+      , outgoing(num_threads, static_cast<Batch *>(NULL))
+      , num_expanded(0)
+      , num_generated(0)
+      , num_reopened(0)
+      , f_reached(0)
+    {
+    }
+
+    // Batches are only left over if the search was stopped.
+    ~Worker()
+    {
+      for (unsigned i = 0; i < outgoing.size(); i += 1)
+        delete outgoing[i];
+      while (inbox != NULL) {
+        Batch *next = inbox->next;
+        delete inbox;
+        inbox = next;
+      }
+    }
+  };
+
+  struct ThreadStart
+  {
+    HDAStar *search;
+    unsigned thread;
+  };
+
+
+private:
+  const Node *goal;
+  bool searched;
+
+  Domain &domain;
+
+  const unsigned max_threads;
+  // The number of threads actually running the search, which is less
+  // than max_threads if some could not be created.
+  unsigned num_threads;
+  std::vector<Worker *> workers;
+
+  // The number of busy threads plus the number of batches in flight.
+  volatile unsigned num_active;
+  // The cost of the best goal found so far.  It is only written with
+  // goal_lock held, and read without it.
+  volatile unsigned goal_cost;
+  pthread_mutex_t goal_lock;
+  // Held by the calling thread while it starts the others, so that they
+  // see the final num_threads.
+  pthread_mutex_t start_lock;
+
+  // The budget, or NULL for none.  Only thread 0 reads it, and sets
+  // stopped once it runs out, which ends every thread's loop.
+  SearchBudget *budget;
+  volatile bool stopped;
+
+
+public:
+  HDAStar(Domain &domain, unsigned num_threads)
+    : goal(NULL)
+    , searched(false)
+    , domain(domain)
+    , max_threads(num_threads > 0 ? num_threads : 1)
+    , num_threads(0)
+    , workers()
+    , num_active(0)
+    , goal_cost(std::numeric_limits<unsigned>::max())
+    , budget(NULL)
+    , stopped(false)
+  {
+    pthread_mutex_init(&goal_lock, NULL);
+    pthread_mutex_init(&start_lock, NULL);
+  }
+
+  ~HDAStar()
+  {
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      delete workers[i];
+    pthread_mutex_destroy(&start_lock);
+    pthread_mutex_destroy(&goal_lock);
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  void search()
+  {
+    if (searched)
+      return;
+    searched = true;
+
+    std::vector<pthread_t> threads(max_threads);
+    std::vector<ThreadStart> starts(max_threads);
+
+    // The calling thread runs thread 0.
+    pthread_mutex_lock(&start_lock);
+    unsigned num_started = 1;
+    for (; num_started < max_threads; num_started += 1) {
+      starts[num_started].search = this;
+      starts[num_started].thread = num_started;
+      if (pthread_create(&threads[num_started],
+                         NULL,
+                         thread_main,
+                         &starts[num_started]) != 0)
+        break;
+    }
+
+    num_threads = num_started;
+    for (unsigned i = 0; i < num_threads; i += 1)
+      workers.push_back(new Worker(num_threads));
+    num_active = num_threads;
+    pthread_mutex_unlock(&start_lock);
+
+    run_thread(0);
+
+    for (unsigned i = 1; i < num_threads; i += 1)
+      pthread_join(threads[i], NULL);
+
+    if (stopped)
+      throw BudgetExhausted();
+  }
+
+
+  const Node * get_goal() const
+  {
+    return goal;
+  }
+
+  const Domain & get_domain() const
+  {
+    return domain;
+  }
+
+  unsigned get_num_threads() const
+  {
+    return num_threads;
+  }
+
+  unsigned get_num_generated() const
+  {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_generated;
+    return sum;
+  }
+
+  unsigned get_num_expanded() const
+  {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_expanded;
+    return sum;
+  }
+
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    unsigned open_size = 0;
+    unsigned closed_size = 0;
+    unsigned num_reopened = 0;
+    unsigned f_reached = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1) {
+      open_size += workers[i]->open.size();
+      closed_size += workers[i]->closed.size();
+      num_reopened += workers[i]->num_reopened;
+      f_reached = std::max(f_reached, workers[i]->f_reached);
+    }
+
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("open_size", open_size);
+    stats.set_count("closed_size", closed_size);
+    stats.set_count("threads", num_threads);
+    stats.set_count("reopened", num_reopened);
+    stats.set_count("f_reached", f_reached);
+    for (unsigned i = 0; i < workers.size(); i += 1) {
+      std::ostringstream key;
+      key << "thread" << i << "_expanded";
+      stats.set_count(key.str(), workers[i]->num_expanded);
+    }
+  }
+
+  void output_statistics(std::ostream &o) const
+  {
+    unsigned open_size = 0;
+    unsigned closed_size = 0;
+    unsigned num_reopened = 0;
+    unsigned f_reached = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1) {
+      open_size += workers[i]->open.size();
+      closed_size += workers[i]->closed.size();
+      num_reopened += workers[i]->num_reopened;
+      f_reached = std::max(f_reached, workers[i]->f_reached);
+    }
+
+    o << num_threads << " threads" << std::endl
+      << open_size << " nodes in open at end of search" << std::endl
+      << closed_size << " nodes in closed at end of search" << std::endl
+      << num_reopened << " states reopened" << std::endl
+      << "largest f-value expanded is " << f_reached << std::endl;
+
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      o << "  thread " << i << ": "
+        << workers[i]->num_expanded << " expanded, "
+        << workers[i]->closed.size() << " in closed" << std::endl;
+
+    if (get_goal() != NULL) {
+      const Cost goal_f = get_goal()->get_f();
+      unsigned num_expanded_less_than_goal_f = 0;
+      for (unsigned i = 0; i < workers.size(); i += 1) {
+        const Closed &closed = workers[i]->closed;
+        for (ClosedConstIterator closed_it = closed.begin();
+             closed_it != closed.end();
+             ++closed_it) {
+          if (!closed_it->second && closed_it->first->get_f() < goal_f)
+            num_expanded_less_than_goal_f += 1;
+        }
+      }
+
+      o << "goal f-value is " << goal_f << std::endl;
+      o << num_expanded_less_than_goal_f
+        << " nodes expanded with f-value less than goal's" << std::endl;
+    }
+  }
+
+
+private:
+  static void * thread_main(void *arg)
+  {
+    const ThreadStart *start = static_cast<const ThreadStart *>(arg);
+    HDAStar *search = start->search;
+
+    pthread_mutex_lock(&search->start_lock);
+    pthread_mutex_unlock(&search->start_lock);
+
+    // The thread may have been started before a later one failed to
+    // be, leaving it out of the search.
+    if (start->thread < search->num_threads)
+      search->run_thread(start->thread);
+    return NULL;
+  }
+
+  unsigned owner(const State &s) const
+  {
+    // The closed lists index their slots with the low bits of the same
+    // hash, so it is mixed again before picking a thread; otherwise
+    // each thread would only ever fill some of its slots.
+    const boost::uint64_t h =
+      static_cast<boost::uint64_t>(hash_value(s)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<unsigned>(h >> 32) % num_threads;
+  }
+
+  void run_thread(unsigned thread)
+  {
+    Worker &w = *workers[thread];
+    Successors succs;
+    bool busy = true;
+    unsigned expanded_since_send = 0;
+    unsigned num_loops = 0;
+
+    const State &start_state = domain.get_start_state();
+    if (owner(start_state) == thread) {
+      Node *start_node = new (w.node_pool.malloc()) Node(start_state,
+                                                         0,
+                                                         0,
+                                                         NULL);
+      domain.compute_heuristic(*start_node);
+      w.closed[start_node] = w.open.push(start_node);
+    }
+
+    for (;;) {
+      if (stopped)
+        break;
+      if (thread == 0 && budget != NULL) {
+        num_loops += 1;
+        if (num_loops == SEARCH_BUDGET_CHECK_INTERVAL) {
+          num_loops = 0;
+          if (budget->is_exhausted(get_num_expanded())) {
+            stopped = true;
+            break;
+          }
+        }
+      }
+
+      if (w.inbox != NULL) {
+        if (!busy) {
+          busy = true;
+          __sync_fetch_and_add(&num_active, 1);
+        }
+        receive(w);
+      }
+
+      if (!w.open.empty() && w.open.top()->get_f() < goal_cost) {
+        expand(thread, w, succs);
+
+        expanded_since_send += 1;
+        if (expanded_since_send == HDA_STAR_BATCH_SIZE) {
+          send_all(w);
+          expanded_since_send = 0;
+        }
+      }
+      else {
+        send_all(w);
+        expanded_since_send = 0;
+
+        if (busy) {
+          busy = false;
+          __sync_fetch_and_sub(&num_active, 1);
+        }
+        if (num_active == 0)
+          break;
+        sched_yield();
+      }
+    }
+  }
+
+  void expand(unsigned thread, Worker &w, Successors &succs)
+  {
+    Node *n = w.open.top();
+    w.open.pop();
+    assert(w.closed.find(n) != w.closed.end());
+    w.closed[n] = boost::none;
+
+    if (domain.is_goal(n->get_state())) {
+      pthread_mutex_lock(&goal_lock);
+      if (n->get_g() < goal_cost) {
+        goal = n;
+        goal_cost = n->get_g();
+      }
+      pthread_mutex_unlock(&goal_lock);
+      return;
+    }
+
+    domain.compute_successor_states(*n, succs);
+    w.num_expanded += 1;
+    w.num_generated += succs.size();
+    if (n->get_f() > w.f_reached)
+      w.f_reached = n->get_f();
+
+    for (unsigned succ_i = 0; succ_i < succs.size(); succ_i += 1) {
+      const unsigned dest = owner(succs[succ_i].state);
+      if (dest == thread)
+        process_child(w, n, succs[succ_i]);
+      else
+        post(w, dest, n, succs[succ_i]);
+    }
+  }
+
+  void post(Worker &w, unsigned dest, const Node *parent, const Successor &succ)
+  {
+    Batch *&batch = w.outgoing[dest];
+    if (batch == NULL) {
+      batch = new Batch;
+      batch->size = 0;
+    }
+
+    Message &m = batch->messages[batch->size];
+    m.succ = succ;
+    m.parent = parent;
+    batch->size += 1;
+
+    if (batch->size == HDA_STAR_BATCH_SIZE)
+      send(w, dest);
+  }
+
+  void send(Worker &w, unsigned dest)
+  {
+    Batch *batch = w.outgoing[dest];
+    if (batch == NULL)
+      return;
+    w.outgoing[dest] = NULL;
+
+    // Counted before it can be seen, while the sender is still busy.
+    __sync_fetch_and_add(&num_active, 1);
+
+    Worker &to = *workers[dest];
+    Batch *head;
+    do {
+      head = to.inbox;
+      batch->next = head;
+    } while (!__sync_bool_compare_and_swap(&to.inbox, head, batch));
+  }
+
+  void send_all(Worker &w)
+  {
+    for (unsigned dest = 0; dest < num_threads; dest += 1)
+      send(w, dest);
+  }
+
+  void receive(Worker &w)
+  {
+    Batch *batch = __sync_lock_test_and_set(&w.inbox, static_cast<Batch *>(NULL));
+    while (batch != NULL) {
+      for (unsigned i = 0; i < batch->size; i += 1)
+        process_child(w, batch->messages[i].parent, batch->messages[i].succ);
+
+      Batch *next = batch->next;
+      delete batch;
+      batch = next;
+      __sync_fetch_and_sub(&num_active, 1);
+    }
+  }
+
+  Node * make_child(Worker &w, const Node *parent, const Successor &succ)
+  {
+    Node *child = new (w.node_pool.malloc()) Node(succ.state,
+                                                  succ.g,
+                                                  0,
+                                                  parent);
+    domain.compute_heuristic(*parent, *child);
+    return child;
+  }
+
+  void process_child(Worker &w, const Node *parent, const Successor &succ)
+  {
+    ClosedIterator closed_it = w.closed.find(succ.state);
+    if (closed_it == w.closed.end()) {
+      Node *child = make_child(w, parent, succ);
+      if (child->get_f() >= goal_cost) {
+        // No better goal lies beyond the child.
+        w.node_pool.free(child);
+        return;
+      }
+      w.closed[child] = w.open.push(child);
+    }
+    else if (succ.g < closed_it->first->get_g()) {
+      Node *child = make_child(w, parent, succ);
+      if (closed_it->second) {
+        // A worse copy is in the open list, and has no children yet.
+        w.open.erase(*closed_it->second);
+        w.node_pool.free(closed_it->first);
+      }
+      else {
+        // The state was expanded by a worse path.  The old copy is left
+        // allocated, as it may be the parent of other nodes.
+        w.num_reopened += 1;
+      }
+      closed_it->first = child;
+      closed_it->second = w.open.push(child);
+    }
+  }
+};
+
+
+#endif /* !_HDA_STAR_HPP_ */
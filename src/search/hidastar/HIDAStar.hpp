@@ -12,7 +12,11 @@
 #include <boost/utility.hpp>
 
 #include "search/Constants.hpp"
+#include "search/HeuristicCacheFile.hpp"
+#include "search/LevelProfile.hpp"
 #include "search/BoundedSearchResult.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
 #include "util/PointerOps.hpp"
 
 
@@ -58,6 +62,8 @@ private:
   typedef typename Cache::iterator CacheIterator;
   typedef typename Cache::const_iterator CacheConstIterator;
 
+  typedef HeuristicCacheFile<State, Cost> CacheFile;
+
 
 #ifdef HIDA_STAR_DUPLICATE_DETECTION
   typedef boost::unordered_map<
@@ -80,6 +86,7 @@ private:
   const static unsigned hierarchy_height = Domain::num_abstraction_levels + 1;
 
   Node goal;
+  bool solved;        //!< does goal hold the solution?
   bool searched;      //!< has the search() method been called?
 
   Domain &domain;
@@ -87,6 +94,15 @@ private:
   boost::array<unsigned, hierarchy_height> num_expanded;
   boost::array<unsigned, hierarchy_height> num_generated;
 
+  // The cost bound of the base-level iteration searched last.
+  Cost f_reached;
+  // The budget to check at each expansion, at any level, or NULL for
+  // none.
+  SearchBudget *budget;
+
+  typedef LevelProfile<hierarchy_height> Profile;
+  Profile profile;
+
   boost::array<unsigned, hierarchy_height> num_iterations;
 
   boost::array<unsigned, hierarchy_height> cache_lookups;
@@ -95,9 +111,10 @@ private:
   boost::array<State, hierarchy_height> abstract_goals;
 
   Cache cache;
+  unsigned num_preloaded;
 
   // One node pool for each level of the hierarchy.
-  boost::array<boost::pool<> *, hierarchy_height> node_pool;
+  boost::array<typename Node::Pool *, hierarchy_height> node_pool;
 
 #ifdef HIDA_STAR_REEXPANSION_COUNTING
   ExpansionCount expansion_count;
@@ -107,15 +124,20 @@ private:
 public:
   HIDAStar(Domain &domain)
     : goal(domain.get_goal_state(), 0, 0)
+    , solved(false)
     , searched(false)
     , domain(domain)
     , num_expanded()
     , num_generated()
+    , f_reached(0)
+    , budget(NULL)
+    , profile()
     , num_iterations()
     , cache_lookups()
     , cache_hits()
     , abstract_goals()
     , cache()
+    , num_preloaded(0)
     , node_pool()
 #ifdef HIDA_STAR_REEXPANSION_COUNTING
     , expansion_count()
@@ -128,7 +150,7 @@ public:
     cache_hits.assign(0);
     for (unsigned level = 0; level < hierarchy_height; level += 1) {
       abstract_goals[level] = domain.abstract(level, domain.get_goal_state());
-      node_pool[level] = new boost::pool<>(sizeof(Node));
+      node_pool[level] = new typename Node::Pool(sizeof(Node));
     }
   }
 
@@ -138,9 +160,68 @@ public:
       delete node_pool[i];
   }
 
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  /*! \brief Preloads the cache with the entries saved by earlier runs
+      in the given directory, under the given name.
+   */
+  void load_cache(const std::string &dir,
+                  const std::string &name,
+                  std::ostream &log)
+  {
+    assert(!searched);
+    CacheFile file(dir, name, abstract_goals);
+    if (!file.map(log))
+      return;
+
+    for (boost::uint64_t i = 0; i < file.size(); i += 1) {
+      State s;
+      Cost c;
+      bool is_exact;
+      file.get(i, s, c, is_exact);
+      cache[s] = std::make_pair(c, is_exact);
+    }
+    num_preloaded = file.size();
+  }
+
+  /*! \brief Saves the cache entries of abstract states in the given
+      directory, under the given name.
+
+      Entries saved by other runs since this one loaded the cache are
+      kept.
+   */
+  void save_cache(const std::string &dir,
+                  const std::string &name,
+                  std::ostream &log) const
+  {
+    CacheFile file(dir, name, abstract_goals);
+    for (CacheConstIterator it = cache.begin(); it != cache.end(); ++it) {
+      if (is_abstract_state(it->first))
+        file.add(it->first, it->second.first, it->second.second);
+    }
+
+    if (file.map(log)) {
+      for (boost::uint64_t i = 0; i < file.size(); i += 1) {
+        State s;
+        Cost c;
+        bool is_exact;
+        file.get(i, s, c, is_exact);
+        if (cache.find(s) == cache.end())
+          file.add(s, c, is_exact);
+      }
+    }
+
+    file.save(log);
+  }
+
+
   const Node * get_goal() const
   {
-    return &goal;
+    return solved ? &goal : NULL;
   }
 
   const Domain & get_domain() const
@@ -192,9 +273,28 @@ public:
     hidastar_search(0, start_node, &goal_node);
 
     goal = goal_node;
+    solved = true;
   }
 
 
+  void get_statistics(SearchStatistics &stats) const
+  {
+    assert(searched);
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("cache_size", cache.size());
+    stats.set_count("cache_preloaded", num_preloaded);
+    stats.set_count("f_reached", f_reached);
+    for (unsigned level = 0; level < hierarchy_height; level += 1) {
+      stats.set_level_count(level, "iterations", num_iterations[level]);
+      stats.set_level_count(level, "expanded", num_expanded[level]);
+      stats.set_level_count(level, "generated", num_generated[level]);
+      stats.set_level_count(level, "cache_lookups", cache_lookups[level]);
+      stats.set_level_count(level, "cache_hits", cache_hits[level]);
+    }
+    profile.get_statistics(stats);
+  }
+
   void output_statistics(std::ostream &o) const
   {
     assert(searched);
@@ -209,8 +309,12 @@ public:
         << " / " << num_generated[level] << std::endl;
     }
 
+    o << "last cost bound searched at the base level is " << f_reached
+      << std::endl;
+
     dump_cache_size(o);
     dump_cache_information(o);
+    profile.output(o);
 
 #ifdef HIDA_STAR_REEXPANSION_COUNTING
     dump_reexpansion_information(o);
@@ -224,6 +328,7 @@ private:
   // returns true if a goal was found.
   bool hidastar_search(const unsigned level, Node *start_node, Node *goal_node)
   {
+    typename Profile::Scope profile_scope(profile, level, num_expanded[level]);
     assert(start_node != NULL);
     assert(goal_node != NULL);
     assert(start_node->num_nodes_to_start() == 1);
@@ -245,6 +350,8 @@ private:
       }
 #endif
       num_iterations[level] += 1;
+      if (level == 0)
+        f_reached = bound;
 
 #ifdef HIDA_STAR_DUPLICATE_DETECTION
       BoundedResult res = cost_bounded_search(level, start_node, bound, gcache);
@@ -300,6 +407,9 @@ private:
       return res;
     }
 
+    if (budget != NULL)
+      budget->check(get_num_expanded());
+
     std::vector<Node *> succs;
     domain.compute_successors(*start_node, succs, *node_pool[level]);
 
@@ -509,26 +619,30 @@ private:
       return domain.get_epsilon(node->get_state());
 
     const unsigned next_level = level + 1;
-    Node node_abstraction(domain.abstract(next_level, node->get_state()),
-                          0,
-                          0);
+    // The abstract start node comes from the level's pool like any
+    // other, since the nodes generated from it refer back to it as
+    // their parent (and compact nodes can only refer to pool nodes).
+    Node *node_abstraction = new (node_pool[next_level]->malloc())
+      Node(domain.abstract(next_level, node->get_state()),
+           0,
+           0);
 
     cache_lookups[level] += 1;
     Cost hval;
-    CacheConstIterator cache_it = cache.find(node_abstraction.get_state());
+    CacheConstIterator cache_it = cache.find(node_abstraction->get_state());
     if (cache_it == cache.end() || !cache_it->second.second) {
       cache_hits[level] += 1;
-      cache[node_abstraction.get_state()] = std::make_pair(0, true);
+      cache[node_abstraction->get_state()] = std::make_pair(0, true);
       Node goal_abstraction(abstract_goals[next_level], 0, 0);
-      bool goal_found = hidastar_search(next_level, &node_abstraction, &goal_abstraction);
+      bool goal_found = hidastar_search(next_level, node_abstraction, &goal_abstraction);
       if (!goal_found) {
         std::cerr << "infinite heuristic estimate!" << std::endl;
         assert(false);
       }
-      assert(cache.find(node_abstraction.get_state())->second.second);
+      assert(cache.find(node_abstraction->get_state())->second.second);
       assert(goal_abstraction.get_h() == 0);
       assert(goal_abstraction.get_state() == abstract_goals[next_level]);
-      cache[node_abstraction.get_state()].first = goal_abstraction.get_g();
+      cache[node_abstraction->get_state()].first = goal_abstraction.get_g();
       hval = goal_abstraction.get_g();
 
       // TODO: I think this code leaks all the nodes along the goal
@@ -540,7 +654,7 @@ private:
       hval = cache_it->second.first;
     }
 
-    assert(cache.find(node_abstraction.get_state()) != cache.end());
+    assert(cache.find(node_abstraction->get_state()) != cache.end());
 
     node_pool[next_level]->purge_memory();
     return hval;
@@ -550,6 +664,18 @@ private:
   void dump_cache_size(std::ostream &o) const
   {
     o << "cache size: " << cache.size() << std::endl;
+    if (num_preloaded > 0)
+      o << "preloaded cache entries: " << num_preloaded << std::endl;
+  }
+
+
+  // Whether the given state is at an abstract level.  The cached
+  // values of base-level states are of little use to other instances,
+  // so they are not saved.  Abstractions are nested, so abstracting a
+  // state that is already abstract to level 1 leaves it unchanged.
+  bool is_abstract_state(const State &s) const
+  {
+    return domain.abstract(1, s) == s;
   }
 
 
@@ -2,22 +2,65 @@
 #define _IDA_STAR_HPP_
 
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 #include <vector>
 
-#include <boost/array.hpp>
-#include <boost/optional.hpp>
-#include <boost/pool/pool_alloc.hpp>
 #include <boost/utility.hpp>
 
 #include "search/Constants.hpp"
-#include "search/BoundedSearchResult.hpp"
-#include "util/PointerOps.hpp"
-
-
-#define IDA_STAR_CYCLE_CHECKING
-
-
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+#include "search/TranspositionTable.hpp"
+
+
+/*! \brief Iterative-deepening A*, searching in place.
+
+    The searcher keeps a single state, which it changes by applying a
+    move on the way down and undoing it on the way back up, so nothing
+    is allocated during the search.  Heuristic values are updated along
+    with the state, and the path is kept as the moves from the start,
+    in an array sized once per iteration.  Nodes are only made for the
+    solution path, once it is found.
+
+    Cycles and transpositions are not checked for, beyond the domain's
+    move pruning: each frame carries a move state, which tells the
+    domain what it may prune after the moves made so far (for the
+    tiles, the state of a MovePruningFSM).
+
+    Beyond the usual interface, the domain must provide these, in terms
+    of Move, the type of a move, Moves, a fixed-size array of them, and
+    MoveState:
+
+    - initial_move_state, the move state of the start state;
+    - compute_moves(s, ms, moves), which lists in moves the moves from
+      state s that are not pruned in move state ms, and returns their
+      number;
+    - next_move_state(s, ms, m), the move state after making move m
+      from state s in move state ms;
+    - apply_move(s, m, h), which applies the move m to s, updates h from
+      the heuristic value of s to that of the new state, and returns the
+      move that undoes m;
+    - undo_move(s, undo), which undoes a move given its undo move.
+
+    Every move must cost one.
+
+    The searcher can be given a TranspositionTable, consulted on
+    entering each state.  A state already searched in this iteration at
+    no greater depth is not searched again: a state on the first
+    shortest path in move order to a goal is always reached first by
+    that path, so this loses no solution.  A state's backed-up
+    heuristic, the smallest f-value over the bound below it less its g,
+    raises its heuristic value when it is reached again with the same
+    move state, as the moves searched below it depend on that.  Only
+    subtrees that were searched in full, with no state skipped as a
+    transposition, back up a value.  States whose f-value is within
+    IDA_STAR_TT_MIN_SLACK of the bound are left out of the table.
+
+    \tparam DomainT  The type of the search domain
+    \tparam NodeT    The type of the search node, used for the solution
+*/
 template <
   class DomainT,
   class NodeT
@@ -33,7 +76,17 @@ private:
   typedef typename Node::Cost Cost;
   typedef typename Node::State State;
 
-  typedef BoundedSearchResult<Cost, Node> BoundedResult;
+  typedef typename Domain::Move Move;
+  typedef typename Domain::Moves Moves;
+  typedef typename Domain::MoveState MoveState;
+
+public:
+  typedef TranspositionTable<State, Cost, MoveState> Table;
+
+private:
+
+  // Stands for an infinite bound.
+  static const unsigned no_bound = std::numeric_limits<unsigned>::max();
 
 private:
   const Node *goal;
@@ -45,21 +98,62 @@ private:
   unsigned num_generated;
   unsigned num_iterations;
 
-  boost::pool<> node_pool;
+  // The state being searched, the current iteration's bound, and the
+  // smallest f-value over it seen so far in the iteration.
+  State state;
+  unsigned bound;
+  unsigned next_bound;
+
+  // path[i] is the move made at depth i.
+  std::vector<Move> path;
+  unsigned path_length;
+
+  // The transposition table, or NULL for none.
+  Table *table;
+  unsigned num_transpositions;
+  unsigned num_raised;
+
+  // The budget to check at each expansion, or NULL for none.
+  SearchBudget *budget;
+
+  typename Node::Pool node_pool;
 
 
 public:
-  IDAStar(Domain &domain)
+  /*! \param table  The transposition table to use, which the searcher
+                    then owns, or NULL for none
+   */
+  IDAStar(Domain &domain, Table *table = NULL)
     : goal(NULL)
     , searched(false)
     , domain(domain)
     , num_expanded(0)
     , num_generated(0)
     , num_iterations(0)
+    , state(domain.get_start_state())
+    , bound(0)
+    , next_bound(no_bound)
+    , path()
+    , path_length(0)
+    , table(table)
+    , num_transpositions(0)
+    , num_raised(0)
+    , budget(NULL)
     , node_pool(sizeof(Node))
   {
   }
 
+  ~IDAStar()
+  {
+    delete table;
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
   const Node * get_goal() const
   {
     return goal;
@@ -81,10 +175,34 @@ public:
   }
 
 
+  void get_statistics(SearchStatistics &stats) const
+  {
+    assert(searched);
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("iterations", num_iterations);
+    stats.set_count("f_reached", bound);
+    if (table != NULL) {
+      stats.set_count("tt_slots", table->size());
+      stats.set_count("tt_stored", table->get_num_stored());
+      stats.set_count("tt_replaced", table->get_num_replaced());
+      stats.set_count("tt_transpositions", num_transpositions);
+      stats.set_count("tt_raised", num_raised);
+    }
+  }
+
   void output_statistics(std::ostream &o) const
   {
     assert(searched);
-    o << "iterations: " << num_iterations << std::endl;
+    o << "iterations: " << num_iterations << std::endl
+      << "last cost bound searched is " << bound << std::endl;
+    if (table != NULL)
+      o << "transposition table: " << table->size() << " slots ("
+        << table->get_bytes() / (1024 * 1024) << " MB), "
+        << table->get_num_stored() << " stored, "
+        << table->get_num_replaced() << " replaced" << std::endl
+        << num_transpositions << " transpositions skipped, "
+        << num_raised << " heuristic values raised" << std::endl;
   }
 
 
@@ -94,140 +212,179 @@ public:
       return;
     searched = true;
 
-    Node *start_node = new (node_pool.malloc()) Node(domain.get_start_state(),
-                                                     0,
-                                                     0);
-    domain.compute_heuristic(*start_node);
-    goal = idastar_search(start_node);
+    Node start_node(domain.get_start_state(), 0, 0);
+    domain.compute_heuristic(start_node);
+    if (idastar_search(start_node.get_h()))
+      goal = make_solution_path();
   }
 
 
 private:
-  const Node * idastar_search(Node *start_node)
+  bool idastar_search(Cost start_h)
   {
-    Cost bound = start_node->get_h();
-    bool failed = false;
-
-    const Node *goal_node = NULL;
+    state = domain.get_start_state();
+    bound = start_h;
 
-    while ( goal_node == NULL && !failed ) {
+    for (;;) {
 #ifdef OUTPUT_SEARCH_PROGRESS
-    std::cerr << "doing cost-bounded search with cutoff " << bound << std::endl;
-    std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
-              << get_num_generated() << " total nodes generated" << std::endl;
+      std::cerr << "doing cost-bounded search with cutoff " << bound << std::endl;
+      std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                << get_num_generated() << " total nodes generated" << std::endl;
 #endif
       num_iterations += 1;
-      BoundedResult res = cost_bounded_search(start_node, bound);
+      next_bound = no_bound;
 
-      if (res.is_failure()) {
-        assert(!res.is_goal());
-        assert(!res.is_cutoff());
-        failed = true;
-      }
-      else if (res.is_goal()) {
-        assert(!res.is_cutoff());
-        assert(!res.is_failure());
-        goal_node = res.get_goal();
-        assert(goal_node != NULL);
-      }
-      else if (res.is_cutoff()) {
-        assert(!res.is_goal());
-        assert(!res.is_failure());
-        bound = res.get_cutoff();
-      }
-      else {
-        assert(false);
+      // With unit moves, no path within the bound is longer than it.
+      if (path.size() < bound)
+        path.resize(bound);
+
+      if (cost_bounded_search(0, start_h, Domain::initial_move_state)) {
+        assert(state == domain.get_start_state());
+        return true;
       }
-    }
+      assert(state == domain.get_start_state());
 
-    return goal_node;
+      if (next_bound == no_bound)
+        return false;
+      bound = next_bound;
+    }
   }
 
-  
-  BoundedResult
-  cost_bounded_search(Node *start_node,
-                      const Cost bound)
+
+  // Searches below the current state, at the given depth (which is
+  // also its g-value), with the given heuristic value and move state.
+  // Returns true, with the path to a
+  // goal in path[0, path_length), if one is found within the bound.
+  bool cost_bounded_search(unsigned depth, Cost h, MoveState ms)
   {
-    if (start_node->get_state() == domain.get_goal_state()) {
-      BoundedResult res(start_node);
-      assert(res.is_goal());
-      return res;
+    if (domain.is_goal(state)) {
+      path_length = depth;
+      return true;
     }
 
-    std::vector<Node *> succs;
-    domain.compute_successors(*start_node, succs, node_pool);
+    if (table != NULL && depth + h + IDA_STAR_TT_MIN_SLACK <= bound)
+      return table_search(depth, h, ms);
 
-    num_expanded += 1;
-    num_generated += succs.size();
+    return search_children(depth, h, ms);
+  }
 
 
+  // Searches the children of the current state, as
+  // cost_bounded_search().
+  bool search_children(unsigned depth, Cost h, MoveState ms)
+  {
+    if (budget != NULL)
+      budget->check(num_expanded);
+
+    Moves moves;
+    const unsigned num_moves = domain.compute_moves(state, ms, moves);
+
+    num_expanded += 1;
+    num_generated += num_moves;
+
 #ifdef OUTPUT_SEARCH_PROGRESS
-      if (get_num_expanded() % 1000000 == 0) {
-        std::cerr << "progress update:" << std::endl;
-        std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
-                  << get_num_generated() << " total nodes generated" << std::endl;
-      }
+    if (get_num_expanded() % 1000000 == 0) {
+      std::cerr << "progress update:" << std::endl;
+      std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                << get_num_generated() << " total nodes generated" << std::endl;
+    }
 #endif
 
+    for (unsigned i = 0; i < num_moves; i += 1) {
+      const MoveState child_ms = domain.next_move_state(state, ms, moves[i]);
+      Cost child_h = h;
+      const Move child_undo = domain.apply_move(state, moves[i], child_h);
+      const unsigned child_f = depth + 1 + child_h;
 
-    boost::optional<Cost> new_cutoff;
-    
-    for (unsigned i = 0; i < succs.size(); i += 1) {
-      Node *succ = succs[i];
-
-#ifdef IDA_STAR_CYCLE_CHECKING
-      if (start_node->is_descendent_of(succ)) {
-        node_pool.free(succ);
-        continue;
+      bool found = false;
+      if (child_f <= bound) {
+        path[depth] = moves[i];
+        found = cost_bounded_search(depth + 1, child_h, child_ms);
+      }
+      else if (child_f < next_bound) {
+        next_bound = child_f;
       }
-#endif      
 
-      domain.compute_heuristic(*start_node, *succ);
+      domain.undo_move(state, child_undo);
+      if (found)
+        return true;
+    }
 
-      if (succ->get_f() <= bound) {
-        BoundedResult res = cost_bounded_search(succ, bound);
-        if (res.is_goal()) {
-          assert(!res.is_cutoff());
-          assert(!res.is_failure());
-          return res;
-        }
-        else if (res.is_cutoff()) {
-          assert(!res.is_goal());
-          assert(!res.is_failure());
-
-          if (new_cutoff)
-            new_cutoff = std::min(*new_cutoff, res.get_cutoff());
-          else
-            new_cutoff = res.get_cutoff();
-        }
+    return false;
+  }
+
+
+  // As cost_bounded_search(), for a state that is not a goal,
+  // consulting and updating the transposition table.
+  bool table_search(unsigned depth, Cost h, MoveState ms)
+  {
+    // The children's heuristic values are updated from h, so a raised
+    // value is kept apart from it.
+    Cost raised_h = h;
+
+    const typename Table::Entry *entry = table->find(state);
+    if (entry != NULL) {
+      if (entry->iteration == num_iterations && entry->g <= depth) {
+        num_transpositions += 1;
+        return false;
       }
-      else {
-        if (new_cutoff)
-          new_cutoff = std::min(*new_cutoff, succ->get_f());
-        else
-          new_cutoff = succ->get_f();
+
+      if (entry->ms == ms && entry->h > h) {
+        num_raised += 1;
+        raised_h = entry->h;
+        if (depth + raised_h > bound) {
+          if (depth + raised_h < next_bound)
+            next_bound = depth + raised_h;
+          return false;
+        }
       }
+    }
 
-      node_pool.free(succ);
-    } /* end for */
+    // The search below is bracketed so that its own smallest pruned
+    // f-value, and whether it skipped any transposition, are known.
+    const unsigned outer_next_bound = next_bound;
+    const unsigned outer_transpositions = num_transpositions;
+    next_bound = no_bound;
+
+    if (search_children(depth, h, ms))
+      return true;
+
+    Cost backed_up_h = raised_h;
+    if (num_transpositions == outer_transpositions
+        && next_bound != no_bound
+        && next_bound - depth > raised_h)
+      backed_up_h = std::min<unsigned>(next_bound - depth,
+                                       std::numeric_limits<Cost>::max());
+    table->store(state, num_iterations, depth, backed_up_h, ms);
+
+    if (outer_next_bound < next_bound)
+      next_bound = outer_next_bound;
+    return false;
+  }
 
-    if (new_cutoff) {
-      BoundedResult res(*new_cutoff);
-      assert(res.is_cutoff());
-      assert(!res.is_goal());
-      assert(!res.is_failure());
-      return res;
-    }
-    else {
-      // std::cerr << "returning failure!" << std::endl;
-      BoundedResult res;
-      assert(res.is_failure());
-      assert(!res.is_cutoff());
-      assert(!res.is_failure());
-      return res;
+
+  // Makes nodes for the path found by the last iteration, returning
+  // the goal node.
+  const Node * make_solution_path()
+  {
+    State s = domain.get_start_state();
+    Node *n = new (node_pool.malloc()) Node(s, 0, 0);
+    domain.compute_heuristic(*n);
+
+    for (unsigned i = 0; i < path_length; i += 1) {
+      Cost h = n->get_h();
+      domain.apply_move(s, path[i], h);
+      n = new (node_pool.malloc()) Node(s, i + 1, h, n);
     }
+
+    assert(domain.is_goal(n->get_state()));
+    return n;
   }
 };
 
 
+template <class DomainT, class NodeT>
+const unsigned IDAStar<DomainT, NodeT>::no_bound;
+
+
 #endif /* !_IDA_STAR_HPP_ */
@@ -0,0 +1,454 @@
+#ifndef _MM_HPP_
+#define _MM_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <boost/none.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+#include "search/BucketPriorityQueue.hpp"
+#include "search/ClosedTable.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief MM, the bidirectional heuristic search that meets in the
+    middle (Holte, Felner, Sharon and Sturtevant, 2016).
+
+    A forward search from the start and a backward search from the goal
+    take turns, each expanding a node of the smallest priority
+    max(f, 2g) over both open lists; the forward search uses the
+    domain's heuristic, and the backward one its heuristic for the cost
+    from the start (compute_start_heuristic()).  Neither search expands
+    a node beyond the midpoint of a solution, since 2g would then be
+    over its cost.
+
+    Each search's closed list holds every state it has generated, as in
+    AStar.  When a search generates a state the other has generated, the
+    two paths make a solution, and the best one so far costs U.  With C
+    the smallest priority over both open lists, and fmin and gmin the
+    smallest f and g on each, the search stops once U is at most
+    max(C, fmin_f, fmin_b, gmin_f + gmin_b + 1): no solution through an
+    open node can then be cheaper.
+
+    The open lists are BucketPriorityQueues ordered by the priority, and
+    within a priority by largest g first.  The nodes keep the domain's
+    h-values, so the smallest f on each open list is tracked by counting
+    its nodes by f, as the smallest g is by counting them by g.
+
+    Neither search reopens a closed node.  The heuristic must be
+    consistent, as A*'s.  Moves must cost one, and the domain must
+    provide compute_predecessor_states().
+*/
+template <
+  class DomainT,
+  class NodeT
+  >
+class MM : boost::noncopyable
+{
+public:
+  typedef DomainT Domain;
+  typedef NodeT Node;
+
+
+private:
+  typedef typename Node::State State;
+  typedef typename Node::Cost Cost;
+
+  typedef typename Domain::Successors Successors;
+  typedef typename Successors::Successor Successor;
+
+  // The priority max(f, 2g) of a node.
+  struct MMPriority
+  {
+    unsigned operator ()(const Node &n) const
+    {
+      return std::max<unsigned>(n.get_f(), 2 * n.get_g());
+    }
+  };
+
+  typedef BucketPriorityQueue<Node, MMPriority> Open;
+  typedef boost::optional<typename Open::ItemPointer> MaybeItemPointer;
+  typedef ClosedTable<Node, MaybeItemPointer> Closed;
+
+  typedef typename Closed::iterator ClosedIterator;
+  typedef typename Closed::const_iterator ClosedConstIterator;
+
+  static const unsigned no_solution = std::numeric_limits<unsigned>::max();
+
+  // The number of open nodes with each value, of g or f, and the
+  // smallest value of any open node.
+  struct ValueCounts
+  {
+    // counts[v] is the number of open nodes with value v, and no open
+    // node has a value below min.
+    std::vector<unsigned> counts;
+    unsigned min;
+
+    ValueCounts()
+      : counts()
+      , min(0)
+    {
+    }
+
+    void add(unsigned v)
+    {
+      if (v >= counts.size())
+        counts.resize(v + 1, 0);
+      counts[v] += 1;
+      if (v < min)
+        min = v;
+    }
+
+    void remove(unsigned v)
+    {
+      assert(counts[v] > 0);
+      counts[v] -= 1;
+    }
+
+    // The smallest value, which there must be a node with.
+    unsigned get_min()
+    {
+      while (counts[min] == 0)
+        min += 1;
+      return min;
+    }
+  };
+
+  // One direction's search.
+  struct Frontier : boost::noncopyable
+  {
+    const bool backward;
+    Open open;
+    Closed closed;
+
+    // The g- and f-values of the open nodes.
+    ValueCounts g_counts;
+    ValueCounts f_counts;
+
+    unsigned num_expanded;
+    unsigned num_generated;
+
+    Frontier(bool backward)
+      : backward(backward)
+      , open()
+      , closed(INITIAL_CLOSED_SET_SIZE)
+      , g_counts()
+      , f_counts()
+      , num_expanded(0)
+      , num_generated(0)
+    {
+    }
+
+    MaybeItemPointer push(Node *n)
+    {
+      g_counts.add(n->get_g());
+      f_counts.add(n->get_f());
+      return open.push(n);
+    }
+
+    void removed(const Node *n)
+    {
+      g_counts.remove(n->get_g());
+      f_counts.remove(n->get_f());
+    }
+
+    // The smallest g-value on the open list, which must not be empty.
+    unsigned get_min_g()
+    {
+      assert(!open.empty());
+      return g_counts.get_min();
+    }
+
+    // The smallest f-value on the open list, which must not be empty.
+    unsigned get_min_f()
+    {
+      assert(!open.empty());
+      return f_counts.get_min();
+    }
+
+    // The smallest priority on the open list, which must not be empty.
+    unsigned get_min_priority() const
+    {
+      assert(!open.empty());
+      return open.get_priority()(*open.top());
+    }
+  };
+
+
+private:
+  const Node *goal;
+  bool searched;
+
+  Domain &domain;
+
+  Frontier forward;
+  Frontier backward;
+
+  // The cost of the best solution found so far, and the nodes where
+  // its two halves meet: meet_forward is in the forward search, and
+  // meet_backward, with the same state, in the backward one.
+  unsigned best_cost;
+  const Node *meet_forward;
+  const Node *meet_backward;
+
+  // The largest lower bound on the solution cost, from the priorities,
+  // f-values and g-values of the two open lists, before each expansion.
+  unsigned f_reached;
+  // The budget to check at each expansion, or NULL for none.
+  SearchBudget *budget;
+
+  typename Node::Pool node_pool;
+
+
+public:
+  MM(Domain &domain)
+    : goal(NULL)
+    , searched(false)
+    , domain(domain)
+    , forward(false)
+    , backward(true)
+    , best_cost(no_solution)
+    , meet_forward(NULL)
+    , meet_backward(NULL)
+    , f_reached(0)
+    , budget(NULL)
+    , node_pool(sizeof(Node))
+  {
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  void search()
+  {
+    if (searched)
+      return;
+    searched = true;
+
+    Successors succs;
+
+    Node *start_node = new (node_pool.malloc()) Node(domain.get_start_state(),
+                                                     0,
+                                                     0,
+                                                     NULL);
+    compute_h(forward, *start_node);
+    forward.closed[start_node] = forward.push(start_node);
+
+    Node *goal_node = new (node_pool.malloc()) Node(domain.get_goal_state(),
+                                                    0,
+                                                    0,
+                                                    NULL);
+    compute_h(backward, *goal_node);
+    backward.closed[goal_node] = backward.push(goal_node);
+
+    if (domain.is_goal(start_node->get_state())) {
+      best_cost = 0;
+      meet_forward = start_node;
+      meet_backward = goal_node;
+    }
+
+    while (!forward.open.empty() && !backward.open.empty()) {
+#ifdef OUTPUT_SEARCH_PROGRESS
+      if (get_num_expanded() % 1000000 == 0) {
+        std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                  << get_num_generated() << " total nodes generated" << std::endl;
+      }
+#endif
+
+      const unsigned forward_priority = forward.get_min_priority();
+      const unsigned backward_priority = backward.get_min_priority();
+      const unsigned c = std::min(forward_priority, backward_priority);
+      const unsigned min_cost =
+        std::max(std::max(c, forward.get_min_g() + backward.get_min_g() + 1),
+                 std::max(forward.get_min_f(), backward.get_min_f()));
+      if (best_cost <= min_cost)
+        break;
+      f_reached = min_cost;
+
+      if (budget != NULL) {
+        try {
+          budget->check(get_num_expanded());
+        }
+        catch (const BudgetExhausted &) {
+          // The best solution so far is kept.
+          if (meet_forward != NULL)
+            goal = make_solution_path();
+          throw;
+        }
+      }
+
+      if (forward_priority <= backward_priority)
+        expand(forward, backward, succs);
+      else
+        expand(backward, forward, succs);
+    }
+
+    if (meet_forward != NULL)
+      goal = make_solution_path();
+  }
+
+
+  const Node * get_goal() const
+  {
+    return goal;
+  }
+
+  const Domain & get_domain() const
+  {
+    return domain;
+  }
+
+  unsigned get_num_generated() const
+  {
+    return forward.num_generated + backward.num_generated;
+  }
+
+  unsigned get_num_expanded() const
+  {
+    return forward.num_expanded + backward.num_expanded;
+  }
+
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("forward_expanded", forward.num_expanded);
+    stats.set_count("backward_expanded", backward.num_expanded);
+    stats.set_count("open_size", forward.open.size() + backward.open.size());
+    stats.set_count("closed_size",
+                    forward.closed.size() + backward.closed.size());
+    stats.set_count("f_reached", f_reached);
+    if (meet_forward != NULL)
+      stats.set_count("meeting_g", meet_forward->get_g());
+  }
+
+  void output_statistics(std::ostream &o) const
+  {
+    o << forward.num_expanded << " expanded forward, "
+      << backward.num_expanded << " expanded backward" << std::endl
+      << forward.open.size() + backward.open.size()
+      << " nodes in open at end of search" << std::endl
+      << forward.closed.size() + backward.closed.size()
+      << " nodes in closed at end of search" << std::endl
+      << "largest lower bound on the solution cost is " << f_reached
+      << std::endl;
+    if (meet_forward != NULL)
+      o << "the searches met at g = " << meet_forward->get_g()
+        << " from the start" << std::endl;
+  }
+
+
+private:
+  void compute_h(const Frontier &f, Node &n) const
+  {
+    if (f.backward)
+      domain.compute_start_heuristic(n);
+    else
+      domain.compute_heuristic(n);
+  }
+
+  void expand(Frontier &f, Frontier &other, Successors &succs)
+  {
+    Node *n = f.open.top();
+    f.open.pop();
+    f.removed(n);
+    assert(f.closed.find(n) != f.closed.end());
+    f.closed[n] = boost::none;
+
+    if (f.backward)
+      domain.compute_predecessor_states(*n, succs);
+    else
+      domain.compute_successor_states(*n, succs);
+    f.num_expanded += 1;
+    f.num_generated += succs.size();
+
+    for (unsigned succ_i = 0; succ_i < succs.size(); succ_i += 1)
+      process_child(f, other, n, succs[succ_i]);
+  }
+
+  Node * make_child(const Frontier &f, Node *parent, const Successor &succ)
+  {
+    Node *child = new (node_pool.malloc()) Node(succ.state,
+                                                succ.g,
+                                                0,
+                                                parent);
+    compute_h(f, *child);
+    return child;
+  }
+
+  void process_child(Frontier &f,
+                     Frontier &other,
+                     Node *parent,
+                     const Successor &succ)
+  {
+    Node *child = NULL;
+
+    ClosedIterator closed_it = f.closed.find(succ.state);
+    if (closed_it == f.closed.end()) {
+      child = make_child(f, parent, succ);
+      f.closed[child] = f.push(child);
+    }
+    else if (closed_it->second && succ.g < closed_it->first->get_g()) {
+      // A worse copy is on the open list.  It is left allocated, as it
+      // may be half of the best solution so far.
+      child = make_child(f, parent, succ);
+      f.open.erase(*closed_it->second);
+      f.removed(closed_it->first);
+      closed_it->first = child;
+      closed_it->second = f.push(child);
+    }
+    else {
+      return;
+    }
+
+    ClosedConstIterator other_it = other.closed.find(child->get_state());
+    if (other_it != other.closed.end()) {
+      const unsigned cost = child->get_g() + other_it->first->get_g();
+      if (cost < best_cost) {
+        best_cost = cost;
+        meet_forward = f.backward ? other_it->first : child;
+        meet_backward = f.backward ? child : other_it->first;
+      }
+    }
+  }
+
+  // Makes the nodes for the best solution: the forward search's path to
+  // the meeting state, followed by the backward search's path from it
+  // to the goal.  Returns the goal node.
+  const Node * make_solution_path()
+  {
+    assert(meet_forward->get_state() == meet_backward->get_state());
+
+    const Node *n = meet_forward;
+    Cost g = n->get_g();
+    for (const Node *b = meet_backward->get_parent();
+         b != NULL;
+         b = b->get_parent()) {
+      g += 1;
+      n = new (node_pool.malloc()) Node(b->get_state(), g, 0, n);
+    }
+
+    assert(g == best_cost);
+    assert(domain.is_goal(n->get_state()));
+    return n;
+  }
+};
+
+
+template <class DomainT, class NodeT>
+const unsigned MM<DomainT, NodeT>::no_solution;
+
+
+#endif /* !_MM_HPP_ */
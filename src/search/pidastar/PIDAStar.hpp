@@ -0,0 +1,722 @@
+#ifndef _PIDA_STAR_HPP_
+#define _PIDA_STAR_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <pthread.h>
+
+#include <boost/utility.hpp>
+
+#include "search/Constants.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief Parallel iterative-deepening A*, with work stealing.
+
+    Each cost-bounded iteration starts with the calling thread searching
+    the tree, as IDAStar does, down to the split depth.  The nodes it
+    reaches at that depth within the bound become the iteration's work
+    items, numbered in depth-first order.  The split depth is either
+    given, or, by default, the smallest that makes at least
+    PIDA_STAR_ITEMS_PER_THREAD items for each thread, found by splitting
+    ever deeper, which costs little next to searching the items.
+
+    Each thread is handed a contiguous range of the items and searches
+    them in order, from the front.  A thread that runs out steals the
+    back half of the largest range left.  The threads are started once,
+    by search(), and wait between iterations for the next one's items.
+
+    The first goal found at the bound ends the iteration: the other
+    threads see the flag and unwind.  So does a budget that runs out,
+    which every thread checks every SEARCH_BUDGET_CHECK_INTERVAL of its
+    expansions.  A goal within the bound costs
+    exactly the bound, as the bounds are the smallest f-values that were
+    pruned, so the solution cost does not depend on which thread finds a
+    goal first, though the path may.  Otherwise the next bound is the
+    smallest f-value pruned by any thread.
+
+    The domain must provide the in-place move interface that IDAStar
+    uses, and it is shared by the threads, so those functions must be
+    safe to call concurrently.
+
+    \tparam DomainT  The type of the search domain
+    \tparam NodeT    The type of the search node, used for the solution
+*/
+template <
+  class DomainT,
+  class NodeT
+  >
+class PIDAStar : boost::noncopyable
+{
+public:
+  typedef DomainT Domain;
+  typedef NodeT Node;
+
+
+private:
+  typedef typename Node::Cost Cost;
+  typedef typename Node::State State;
+
+  typedef typename Domain::Move Move;
+  typedef typename Domain::Moves Moves;
+  typedef typename Domain::MoveState MoveState;
+
+  // Stands for an infinite bound.
+  static const unsigned no_bound = std::numeric_limits<unsigned>::max();
+
+  // A node at the split depth, whose subtree is searched by one thread.
+  // Its path from the start is in item_paths.
+  struct WorkItem
+  {
+    State state;
+    Cost h;
+    MoveState ms;
+  };
+
+  struct Worker : boost::noncopyable
+  {
+    // Guards next_item and end_item, the work items still to be taken
+    // from this worker's range.
+    pthread_mutex_t lock;
+    unsigned next_item;
+    unsigned end_item;
+
+    // The state being searched, and path[i], the move made at depth i.
+    State state;
+    std::vector<Move> path;
+
+    // The smallest f-value over the bound that this worker pruned.
+    unsigned next_bound;
+
+    unsigned num_expanded;
+    unsigned num_generated;
+    unsigned num_items;
+    unsigned num_steals;
+    // num_expanded as of the worker's last budget check, which other
+    // threads may read while it searches.  It is only accessed
+    // atomically.
+    unsigned published_expanded;
+
+    Worker(const State &s)
+      : next_item(0)
+      , end_item(0)
+      , state(s)
+      , path()
+      , next_bound(no_bound)
+      , num_expanded(0)
+      , num_generated(0)
+      , num_items(0)
+      , num_steals(0)
+      , published_expanded(0)
+    {
+      pthread_mutex_init(&lock, NULL);
+    }
+
+    ~Worker()
+    {
+      pthread_mutex_destroy(&lock);
+    }
+  };
+
+  struct ThreadStart
+  {
+    PIDAStar *search;
+    unsigned thread;
+  };
+
+
+private:
+  const Node *goal;
+  bool searched;
+
+  Domain &domain;
+
+  const unsigned num_threads;
+  // The given split depth, or 0 to pick one each iteration.
+  const unsigned split_depth;
+  std::vector<Worker *> workers;
+
+  unsigned num_iterations;
+  unsigned bound;
+
+  // The calling thread's search down to the split depth.
+  State split_state;
+  std::vector<Move> split_path;
+  unsigned split_next_bound;
+  unsigned num_split_expanded;
+  unsigned num_split_generated;
+
+  // The current iteration's work items, at item_depth, and
+  // item_paths[i * item_depth, (i + 1) * item_depth), the path to item i.
+  unsigned item_depth;
+  std::vector<WorkItem> items;
+  std::vector<Move> item_paths;
+
+  // Set once a goal is found at the bound.  The moves to it are in
+  // solution, which is only written with goal_lock held.
+  volatile bool solved;
+  pthread_mutex_t goal_lock;
+  std::vector<Move> solution;
+
+  // The budget, or NULL for none.  The first thread to find it run
+  // out sets stopped, which the others see as they would a goal, and
+  // stop_limit, with goal_lock held.
+  SearchBudget *budget;
+  volatile bool stopped;
+  SearchBudget::Limit stop_limit;
+
+  // The threads other than the calling one, which run thread i + 1.
+  // pool_lock guards the rest: each iteration bumps pool_iteration and
+  // signals pool_start, and the last thread to finish it signals
+  // pool_done.
+  std::vector<pthread_t> pool_threads;
+  std::vector<ThreadStart> pool_starts;
+  pthread_mutex_t pool_lock;
+  pthread_cond_t pool_start;
+  pthread_cond_t pool_done;
+  unsigned pool_iteration;
+  unsigned pool_running;
+  bool pool_stopping;
+
+  typename Node::Pool node_pool;
+
+
+public:
+  /*! \param num_threads  The number of threads to search with
+      \param split_depth  The depth of the work items, or 0 to pick it
+                          each iteration
+   */
+  PIDAStar(Domain &domain, unsigned num_threads, unsigned split_depth)
+    : goal(NULL)
+    , searched(false)
+    , domain(domain)
+    , num_threads(num_threads > 0 ? num_threads : 1)
+    , split_depth(split_depth)
+    , workers()
+    , num_iterations(0)
+    , bound(0)
+    , split_state(domain.get_start_state())
+    , split_path()
+    , split_next_bound(no_bound)
+    , num_split_expanded(0)
+    , num_split_generated(0)
+    , item_depth(0)
+    , items()
+    , item_paths()
+    , solved(false)
+    , solution()
+    , budget(NULL)
+    , stopped(false)
+    , stop_limit(SearchBudget::no_limit)
+    , pool_threads()
+    , pool_starts()
+    , pool_iteration(0)
+    , pool_running(0)
+    , pool_stopping(false)
+    , node_pool(sizeof(Node))
+  {
+    pthread_mutex_init(&goal_lock, NULL);
+    pthread_mutex_init(&pool_lock, NULL);
+    pthread_cond_init(&pool_start, NULL);
+    pthread_cond_init(&pool_done, NULL);
+    for (unsigned i = 0; i < this->num_threads; i += 1)
+      workers.push_back(new Worker(domain.get_start_state()));
+  }
+
+  ~PIDAStar()
+  {
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      delete workers[i];
+    pthread_cond_destroy(&pool_done);
+    pthread_cond_destroy(&pool_start);
+    pthread_mutex_destroy(&pool_lock);
+    pthread_mutex_destroy(&goal_lock);
+  }
+
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
+  const Node * get_goal() const
+  {
+    return goal;
+  }
+
+  const Domain & get_domain() const
+  {
+    return domain;
+  }
+
+  unsigned get_num_generated() const
+  {
+    unsigned sum = num_split_generated;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_generated;
+    return sum;
+  }
+
+  unsigned get_num_expanded() const
+  {
+    unsigned sum = num_split_expanded;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_expanded;
+    return sum;
+  }
+
+
+  void get_statistics(SearchStatistics &stats) const
+  {
+    assert(searched);
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("iterations", num_iterations);
+    stats.set_count("f_reached", bound);
+    stats.set_count("threads", num_threads);
+    stats.set_count("split_depth", item_depth);
+    stats.set_count("split_expanded", num_split_expanded);
+    stats.set_count("work_items", get_num_items());
+    stats.set_count("steals", get_num_steals());
+    for (unsigned i = 0; i < workers.size(); i += 1) {
+      std::ostringstream key;
+      key << "thread" << i << "_expanded";
+      stats.set_count(key.str(), workers[i]->num_expanded);
+    }
+  }
+
+  void output_statistics(std::ostream &o) const
+  {
+    assert(searched);
+    o << "iterations: " << num_iterations << std::endl
+      << "last cost bound searched is " << bound << std::endl
+      << num_threads << " threads, last split at depth " << item_depth
+      << std::endl
+      << num_split_expanded << " nodes expanded above the split" << std::endl
+      << get_num_items() << " work items, " << get_num_steals() << " steals"
+      << std::endl;
+
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      o << "  thread " << i << ": "
+        << workers[i]->num_expanded << " expanded, "
+        << workers[i]->num_items << " work items" << std::endl;
+  }
+
+
+  void search()
+  {
+    if (searched)
+      return;
+    searched = true;
+
+    Node start_node(domain.get_start_state(), 0, 0);
+    domain.compute_heuristic(start_node);
+
+    start_pool();
+    try {
+      if (pidastar_search(start_node.get_h()))
+        goal = make_solution_path();
+    }
+    catch (...) {
+      stop_pool();
+      throw;
+    }
+    stop_pool();
+  }
+
+
+private:
+  unsigned get_num_items() const
+  {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_items;
+    return sum;
+  }
+
+  // The expansions as of each thread's last budget check, which, unlike
+  // get_num_expanded(), may be read while the threads search.
+  unsigned get_published_expanded()
+  {
+    unsigned sum = num_split_expanded;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += __sync_fetch_and_add(&workers[i]->published_expanded, 0);
+    return sum;
+  }
+
+  unsigned get_num_steals() const
+  {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < workers.size(); i += 1)
+      sum += workers[i]->num_steals;
+    return sum;
+  }
+
+
+  bool pidastar_search(Cost start_h)
+  {
+    bound = start_h;
+
+    for (;;) {
+#ifdef OUTPUT_SEARCH_PROGRESS
+      std::cerr << "doing cost-bounded search with cutoff " << bound << std::endl;
+      std::cerr << get_num_expanded() << " total nodes expanded" << std::endl
+                << get_num_generated() << " total nodes generated" << std::endl;
+#endif
+      num_iterations += 1;
+
+      if (search_iteration(start_h))
+        return true;
+
+      unsigned next_bound = split_next_bound;
+      for (unsigned i = 0; i < workers.size(); i += 1)
+        if (workers[i]->next_bound < next_bound)
+          next_bound = workers[i]->next_bound;
+
+      if (next_bound == no_bound)
+        return false;
+      bound = next_bound;
+    }
+  }
+
+
+  // Does one cost-bounded iteration, returning true, with the moves to
+  // a goal in solution, if one is found within the bound.
+  bool search_iteration(Cost start_h)
+  {
+    // No path within the bound is longer than it, so neither are the
+    // paths to items.
+    if (split_path.size() < bound)
+      split_path.resize(bound);
+
+    const unsigned target_items = PIDA_STAR_ITEMS_PER_THREAD * num_threads;
+    item_depth = split_depth != 0 ? split_depth : 1;
+    for (;;) {
+      items.clear();
+      item_paths.clear();
+      split_next_bound = no_bound;
+
+      split_state = domain.get_start_state();
+      if (split_search(0, start_h, Domain::initial_move_state))
+        return true;
+      assert(split_state == domain.get_start_state());
+
+      if (split_depth != 0 || items.size() >= target_items
+          || items.empty() || item_depth >= bound)
+        break;
+      item_depth += 1;
+    }
+
+    // Hand out the items in contiguous ranges, so that each thread
+    // starts on its own part of the tree.
+    const unsigned num_items = items.size();
+    for (unsigned i = 0; i < num_threads; i += 1) {
+      Worker &w = *workers[i];
+      w.next_item = static_cast<unsigned long long>(num_items) * i / num_threads;
+      w.end_item = static_cast<unsigned long long>(num_items) * (i + 1) / num_threads;
+      w.next_bound = no_bound;
+      // With unit moves, no path within the bound is longer than it.
+      if (w.path.size() < bound)
+        w.path.resize(bound);
+    }
+
+    // The calling thread runs thread 0.
+    pthread_mutex_lock(&pool_lock);
+    pool_iteration += 1;
+    pool_running = pool_threads.size();
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_lock);
+
+    run_thread(0);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_running > 0)
+      pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+
+    if (stopped && !solved) {
+      budget->set_exhausted(stop_limit);
+      throw BudgetExhausted();
+    }
+
+    return solved;
+  }
+
+
+  // Searches from the start, as IDAStar does, down to the split depth,
+  // where the nodes within the bound are made into work items.
+  bool split_search(unsigned depth, Cost h, MoveState ms)
+  {
+    if (domain.is_goal(split_state)) {
+      solution.assign(split_path.begin(), split_path.begin() + depth);
+      solved = true;
+      return true;
+    }
+
+    if (depth == item_depth) {
+      WorkItem item;
+      item.state = split_state;
+      item.h = h;
+      item.ms = ms;
+      items.push_back(item);
+      item_paths.insert(item_paths.end(),
+                        split_path.begin(),
+                        split_path.begin() + item_depth);
+      return false;
+    }
+
+    if (budget != NULL)
+      budget->check(get_num_expanded());
+
+    Moves moves;
+    const unsigned num_moves = domain.compute_moves(split_state, ms, moves);
+
+    num_split_expanded += 1;
+    num_split_generated += num_moves;
+
+    for (unsigned i = 0; i < num_moves; i += 1) {
+      const MoveState child_ms = domain.next_move_state(split_state, ms, moves[i]);
+      Cost child_h = h;
+      const Move child_undo = domain.apply_move(split_state, moves[i], child_h);
+      const unsigned child_f = depth + 1 + child_h;
+
+      bool found = false;
+      if (child_f <= bound) {
+        split_path[depth] = moves[i];
+        found = split_search(depth + 1, child_h, child_ms);
+      }
+      else if (child_f < split_next_bound) {
+        split_next_bound = child_f;
+      }
+
+      domain.undo_move(split_state, child_undo);
+      if (found)
+        return true;
+    }
+
+    return false;
+  }
+
+
+  // Starts the threads other than the calling one.  The items of a
+  // thread that cannot be started are stolen by the others.
+  void start_pool()
+  {
+    pool_starts.resize(num_threads - 1);
+    for (unsigned i = 1; i < num_threads; i += 1) {
+      pool_starts[i - 1].search = this;
+      pool_starts[i - 1].thread = i;
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, thread_main, &pool_starts[i - 1]) != 0)
+        break;
+      pool_threads.push_back(thread);
+    }
+  }
+
+  void stop_pool()
+  {
+    pthread_mutex_lock(&pool_lock);
+    pool_stopping = true;
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (unsigned i = 0; i < pool_threads.size(); i += 1)
+      pthread_join(pool_threads[i], NULL);
+    pool_threads.clear();
+  }
+
+  static void * thread_main(void *arg)
+  {
+    const ThreadStart *start = static_cast<const ThreadStart *>(arg);
+    start->search->run_pool_thread(start->thread);
+    return NULL;
+  }
+
+  // Runs the given thread in each iteration, until the pool is stopped.
+  void run_pool_thread(unsigned thread)
+  {
+    unsigned iteration = 0;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+      while (pool_iteration == iteration && !pool_stopping)
+        pthread_cond_wait(&pool_start, &pool_lock);
+      if (pool_stopping)
+        break;
+      iteration = pool_iteration;
+      pthread_mutex_unlock(&pool_lock);
+
+      run_thread(thread);
+
+      pthread_mutex_lock(&pool_lock);
+      pool_running -= 1;
+      if (pool_running == 0)
+        pthread_cond_signal(&pool_done);
+    }
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  void run_thread(unsigned thread)
+  {
+    Worker &w = *workers[thread];
+    unsigned item;
+    while (!solved && !stopped && take_item(thread, item)) {
+      const WorkItem &work = items[item];
+      w.state = work.state;
+      std::copy(item_paths.begin() + item * item_depth,
+                item_paths.begin() + (item + 1) * item_depth,
+                w.path.begin());
+      w.num_items += 1;
+
+      if (cost_bounded_search(w, item_depth, work.h, work.ms))
+        break;
+    }
+  }
+
+  // Takes the next item of the thread's own range, or else steals the
+  // back half of the largest range left.  Returns false once there are
+  // no items left.
+  bool take_item(unsigned thread, unsigned &item)
+  {
+    Worker &w = *workers[thread];
+
+    pthread_mutex_lock(&w.lock);
+    const bool have_item = w.next_item < w.end_item;
+    if (have_item)
+      item = w.next_item++;
+    pthread_mutex_unlock(&w.lock);
+    if (have_item)
+      return true;
+
+    for (;;) {
+      // Picked without the locks, so it is checked again under them.
+      unsigned victim = thread;
+      unsigned victim_size = 0;
+      for (unsigned i = 0; i < num_threads; i += 1) {
+        const unsigned size = workers[i]->end_item - workers[i]->next_item;
+        if (i != thread && workers[i]->next_item < workers[i]->end_item
+            && size > victim_size) {
+          victim = i;
+          victim_size = size;
+        }
+      }
+      if (victim == thread)
+        return false;
+
+      Worker &v = *workers[victim];
+      pthread_mutex_lock(&v.lock);
+      unsigned begin = v.end_item;
+      const unsigned end = v.end_item;
+      if (v.next_item < v.end_item) {
+        begin = v.end_item - (v.end_item - v.next_item + 1) / 2;
+        v.end_item = begin;
+      }
+      pthread_mutex_unlock(&v.lock);
+
+      if (begin == end)
+        continue;
+
+      w.num_steals += 1;
+      pthread_mutex_lock(&w.lock);
+      w.next_item = begin + 1;
+      w.end_item = end;
+      pthread_mutex_unlock(&w.lock);
+      item = begin;
+      return true;
+    }
+  }
+
+
+  // As IDAStar's cost_bounded_search(), in the given worker's state,
+  // giving up as soon as any thread finds a goal, or the budget runs
+  // out.
+  bool cost_bounded_search(Worker &w, unsigned depth, Cost h, MoveState ms)
+  {
+    if (domain.is_goal(w.state)) {
+      pthread_mutex_lock(&goal_lock);
+      if (!solved) {
+        solution.assign(w.path.begin(), w.path.begin() + depth);
+        solved = true;
+      }
+      pthread_mutex_unlock(&goal_lock);
+      return true;
+    }
+
+    if (solved || stopped)
+      return false;
+
+    if (budget != NULL && w.num_expanded % SEARCH_BUDGET_CHECK_INTERVAL == 0) {
+      __sync_lock_test_and_set(&w.published_expanded, w.num_expanded);
+      const SearchBudget::Limit limit =
+        budget->find_exhausted(get_published_expanded());
+      if (limit != SearchBudget::no_limit) {
+        pthread_mutex_lock(&goal_lock);
+        if (!stopped) {
+          stop_limit = limit;
+          stopped = true;
+        }
+        pthread_mutex_unlock(&goal_lock);
+        return false;
+      }
+    }
+
+    Moves moves;
+    const unsigned num_moves = domain.compute_moves(w.state, ms, moves);
+
+    w.num_expanded += 1;
+    w.num_generated += num_moves;
+
+    for (unsigned i = 0; i < num_moves; i += 1) {
+      const MoveState child_ms = domain.next_move_state(w.state, ms, moves[i]);
+      Cost child_h = h;
+      const Move child_undo = domain.apply_move(w.state, moves[i], child_h);
+      const unsigned child_f = depth + 1 + child_h;
+
+      bool found = false;
+      if (child_f <= bound) {
+        w.path[depth] = moves[i];
+        found = cost_bounded_search(w, depth + 1, child_h, child_ms);
+      }
+      else if (child_f < w.next_bound) {
+        w.next_bound = child_f;
+      }
+
+      domain.undo_move(w.state, child_undo);
+      if (found)
+        return true;
+    }
+
+    return false;
+  }
+
+
+  // Makes nodes for the moves in solution, returning the goal node.
+  const Node * make_solution_path()
+  {
+    State s = domain.get_start_state();
+    Node *n = new (node_pool.malloc()) Node(s, 0, 0);
+    domain.compute_heuristic(*n);
+
+    for (unsigned i = 0; i < solution.size(); i += 1) {
+      Cost h = n->get_h();
+      domain.apply_move(s, solution[i], h);
+      n = new (node_pool.malloc()) Node(s, i + 1, h, n);
+    }
+
+    assert(domain.is_goal(n->get_state()));
+    return n;
+  }
+};
+
+
+template <class DomainT, class NodeT>
+const unsigned PIDAStar<DomainT, NodeT>::no_bound;
+
+
+#endif /* !_PIDA_STAR_HPP_ */
@@ -2,21 +2,49 @@
 #define _SWITCHBACK_HPP_
 
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
 #include <boost/array.hpp>
 #include <boost/none.hpp>
 #include <boost/optional.hpp>
-#include <boost/pool/pool_alloc.hpp>
-#include <boost/unordered_map.hpp>
+#include <boost/pool/pool.hpp>
 #include <boost/utility.hpp>
 
 #include "search/BucketPriorityQueue.hpp"
+#include "search/ClosedTable.hpp"
 #include "search/Constants.hpp"
-#include "util/PointerOps.hpp"
-
-
+#include "search/LevelProfile.hpp"
+#include "search/PerfectHashing.hpp"
+#include "search/SearchBudget.hpp"
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief Switchback: hierarchical A* that searches backward and
+    forward on alternate levels, resuming each level's search where it
+    left off.
+
+    The searcher may be given a memory budget.  Every node at an
+    abstract level can be found again by searching that level anew, so
+    when the nodes and tables held exceed the budget, the searches at
+    abstract levels are thrown away, least recently used first, and
+    restarted from their start nodes when next needed.  The heuristic
+    values found by a restarted search are the same exact abstract
+    distances as before, so the base-level search still finds an optimal
+    solution; it just costs more abstract work.
+
+    The budget is checked before each base-level expansion, when no
+    abstract search is in progress, so that any abstract level may be
+    discarded.  Checking within the abstract searches as well would only
+    allow discarding the levels that they are about to need, and makes
+    them thrash.  The budget is therefore soft: the sub-searches for a
+    single base-level expansion can overshoot it, most of all when a
+    large closed list doubles.
+
+    \tparam DomainT  The type of the search domain
+    \tparam NodeT    The type of the search node
+*/
 template <
   class DomainT,
   class NodeT
@@ -32,16 +60,15 @@ private:
   typedef typename Node::Cost Cost;
   typedef typename Node::State State;
 
+  // Successors are generated as states, and become nodes only once
+  // they pass the duplicate check.
+  typedef typename Domain::Successors Successors;
+  typedef typename Successors::Successor Successor;
+
   typedef BucketPriorityQueue<Node> Open;
   typedef boost::optional<typename Open::ItemPointer> MaybeItemPointer;
 
-  typedef boost::unordered_map<
-    Node *,
-    MaybeItemPointer,
-    PointerHash<Node>,
-    PointerEq<Node>,
-    boost::fast_pool_allocator< std::pair<Node * const, MaybeItemPointer> >
-    > Closed;
+  typedef ClosedTable<Node, MaybeItemPointer> Closed;
 
   typedef typename Closed::iterator ClosedIterator;
   typedef typename Closed::const_iterator ClosedConstIterator;
@@ -58,6 +85,9 @@ private:
   boost::array<unsigned, hierarchy_height> num_expanded;
   boost::array<unsigned, hierarchy_height> num_generated;
 
+  typedef LevelProfile<hierarchy_height> Profile;
+  Profile profile;
+
   boost::array<unsigned, hierarchy_height> num_expanded_on_first_search_at_level;
   boost::array<unsigned, hierarchy_height> num_generated_on_first_search_at_level;
   boost::array<unsigned, hierarchy_height> num_searches;
@@ -65,28 +95,56 @@ private:
   boost::array<unsigned, hierarchy_height> cache_lookups;
   boost::array<unsigned, hierarchy_height> cache_hits;
 
+  // The bytes that the nodes and tables may take, or 0 for no limit.
+  const std::size_t memory_budget;
+  // The memory use at which abstract levels are next discarded.
+  std::size_t eviction_threshold;
+  boost::array<unsigned, hierarchy_height> num_evictions;
+  // When each level was last searched, by the count of searches.
+  boost::array<unsigned long, hierarchy_height> last_used;
+  unsigned long num_resumed;
+
+  // The largest f-value expanded at the base level.
+  unsigned f_reached;
+  // The budget to check at each expansion, at any level, or NULL for
+  // none.
+  SearchBudget *budget;
+
   boost::array<Open, hierarchy_height> open;
-  Closed closed;
+  boost::array<Closed, hierarchy_height> closed;
 
   boost::array<State, hierarchy_height> abstract_goals;
 
-  boost::pool<> node_pool;
+  typename Node::Pool node_pool;
 
 
 public:
-  Switchback(Domain &domain)
+  /*! \param domain         The search domain
+      \param memory_budget  The bytes that nodes, open lists and closed
+                            lists may take before abstract levels are
+                            discarded, or 0 for no limit
+   */
+  Switchback(Domain &domain, std::size_t memory_budget = 0)
     : goal(NULL)
     , searched(false)
     , domain(domain)
     , num_expanded()
     , num_generated()
+    , profile()
     , num_expanded_on_first_search_at_level()
     , num_generated_on_first_search_at_level()
     , num_searches()
     , cache_lookups()
     , cache_hits()
+    , memory_budget(memory_budget)
+    , eviction_threshold(memory_budget)
+    , num_evictions()
+    , last_used()
+    , num_resumed(0)
+    , f_reached(0)
+    , budget(NULL)
     , open()
-    , closed(INITIAL_CLOSED_SET_SIZE)
+    , closed()
     , abstract_goals()
     , node_pool(sizeof(Node))
   {
@@ -96,6 +154,9 @@ public:
     num_generated_on_first_search_at_level.assign(0);
     cache_lookups.assign(0);
     cache_hits.assign(0);
+    num_evictions.assign(0);
+    last_used.assign(0);
+    use_perfect_hashing(domain, closed);
     initialize();
   }
 
@@ -103,6 +164,12 @@ public:
   {
   }
 
+  //! Makes the search check the given budget, which it does not own.
+  void set_budget(SearchBudget *budget)
+  {
+    this->budget = budget;
+  }
+
   void search()
   {
     if (searched)
@@ -151,6 +218,28 @@ public:
   }
 
 
+  void get_statistics(SearchStatistics &stats) const
+  {
+    assert(searched);
+    stats.set_count("expanded", get_num_expanded());
+    stats.set_count("generated", get_num_generated());
+    stats.set_count("f_reached", f_reached);
+    for (unsigned level = 0; level < hierarchy_height; level += 1) {
+      stats.set_level_count(level, "expanded", num_expanded[level]);
+      stats.set_level_count(level, "generated", num_generated[level]);
+      stats.set_level_count(level, "open_size", open[level].size());
+      stats.set_level_count(level, "closed_size", closed[level].size());
+      stats.set_level_count(level, "cache_lookups", cache_lookups[level]);
+      stats.set_level_count(level, "cache_hits", cache_hits[level]);
+      stats.set_level_count(level, "first_search_expanded",
+                            num_expanded_on_first_search_at_level[level]);
+      stats.set_level_count(level, "first_search_generated",
+                            num_generated_on_first_search_at_level[level]);
+      stats.set_level_count(level, "evictions", num_evictions[level]);
+    }
+    profile.get_statistics(stats);
+  }
+
   void output_statistics(std::ostream &o) const
   {
     assert(searched);
@@ -163,11 +252,17 @@ public:
         << " / " << num_generated[level] << std::endl;
     }
 
+    o << "largest f-value expanded at the base level is " << f_reached
+      << std::endl;
+
     dump_open_sizes(o);
     dump_closed_sizes(o);
 
     dump_cache_information(o);
     dump_first_searches_information(o);
+    if (memory_budget != 0)
+      dump_eviction_information(o);
+    profile.output(o);
   }
 
 
@@ -184,15 +279,12 @@ private:
     if (level == Domain::num_abstraction_levels)
       return epsilon;
 
-    // Need to create a dummy goal node to look up in the hash table.
-    // This smells of bad design!
     const unsigned next_level = level + 1;
     const State abstract_goal_state = domain.abstract(next_level, goal_state);
-    Node abstract_goal_node(abstract_goal_state, 0, 0);
 
     cache_lookups[level] += 1;
-    ClosedIterator closed_it = closed.find(&abstract_goal_node);
-    if (closed_it != closed.end() && !closed_it->second) {
+    ClosedIterator closed_it = closed[next_level].find(abstract_goal_state);
+    if (closed_it != closed[next_level].end() && !closed_it->second) {
       cache_hits[level] += 1;
       return std::max(closed_it->first->get_g(), epsilon);
     }
@@ -203,8 +295,8 @@ private:
       assert(false);  // for the domains I am running on, there should
                       // never be an infinite heuristic estimate.
     }
-    assert(closed.find(&abstract_goal_node) != closed.end());
-    assert(!closed.find(&abstract_goal_node)->second);
+    assert(closed[next_level].find(abstract_goal_state) != closed[next_level].end());
+    assert(!closed[next_level].find(abstract_goal_state)->second);
 
     return std::max(result->get_g(), epsilon);
   }
@@ -213,18 +305,19 @@ private:
   Node * resume_search(const unsigned level, const State &goal_state)
   {
     assert(domain.is_valid_level(level));
+    typename Profile::Scope profile_scope(profile, level, num_expanded[level]);
 
     num_searches[level] += 1;
+    num_resumed += 1;
+    last_used[level] = num_resumed;
 
-    // Dummy goal node, for hash table lookup.
-    Node goal_node(goal_state, 0, 0);
-    ClosedIterator closed_it = closed.find(&goal_node);
+    ClosedIterator closed_it = closed[level].find(goal_state);
 
-    if (closed_it != closed.end() && !closed_it->second) {
+    if (closed_it != closed[level].end() && !closed_it->second) {
       return closed_it->first;
     }
 
-    std::vector<Node *> children;
+    Successors children;
 
     // A*-ish code ahead
     while (!open[level].empty()) {
@@ -237,20 +330,29 @@ private:
       }
 #endif
 
+      if (level == 0
+          && memory_budget != 0
+          && get_memory_usage() > eviction_threshold)
+        evict_abstract_levels();
+      if (budget != NULL)
+        budget->check(get_num_expanded());
+
       Node *n = open[level].top();
-      assert(closed.find(n) != closed.end());
-      assert(closed.find(n)->second);
-      assert(open[level].valid_item_pointer(*closed.find(n)->second));
+      assert(closed[level].find(n) != closed[level].end());
+      assert(closed[level].find(n)->second);
+      assert(open[level].valid_item_pointer(*closed[level].find(n)->second));
       open[level].pop();
 
-      closed[n] = boost::none;
+      closed[level][n] = boost::none;
 
       if (level % 2 == 0)
-        domain.compute_successors(*n, children, node_pool);
+        domain.compute_successor_states(*n, children);
       else
-        domain.compute_predecessors(*n, children, node_pool);
+        domain.compute_predecessor_states(*n, children);
       num_expanded[level] += 1;
       num_generated[level] += children.size();
+      if (level == 0 && n->get_f() > f_reached)
+        f_reached = n->get_f();
 
       if (num_searches[level] == 1) {
         num_expanded_on_first_search_at_level[level] += 1;
@@ -258,7 +360,7 @@ private:
       }
       
       for (unsigned child_idx = 0; child_idx < children.size(); child_idx += 1) {
-        process_child(level, children[child_idx]);
+        process_child(level, n, children[child_idx]);
       }
 
       if (n->get_state() == goal_state)
@@ -268,54 +370,130 @@ private:
     return NULL;
   }
 
-  void process_child(const unsigned level, Node *child)
+  void process_child(const unsigned level, Node *parent, const Successor &succ)
   {
-    assert(open[level].size() <= closed.size());
+    assert(open[level].size() <= closed[level].size());
+
+    ClosedIterator closed_it = closed[level].find(succ.state);
+    if (closed_it != closed[level].end() && !closed_it->second) {
+      // The child has already been expanded.
+      return;
+    }
 
-    child->set_h(heuristic(level, child->get_state()));
+    // The heuristic only searches the levels above this one, so
+    // closed_it stays valid.
+    const Cost h = heuristic(level, succ.state);
 
-    ClosedIterator closed_it = closed.find(child);
-    if (closed_it == closed.end()) {
+    if (closed_it == closed[level].end()) {
       // The child has not been generated before.
-      closed[child] = open[level].push(child);
+      Node *child = new (node_pool.malloc()) Node(succ.state, succ.g, h, parent);
+      closed[level][child] = open[level].push(child);
     }
-    else if (closed_it->second && child->get_f() < closed_it->first->get_f()) {
+    else if (succ.g + h < closed_it->first->get_f()) {
       // A worse version of the child is in the open list.
+      Node *child = new (node_pool.malloc()) Node(succ.state, succ.g, h, parent);
       open[level].erase(*closed_it->second);  // knock out the old
                                               // one from the open
                                               // list
 
      // free the old, worse copy
       node_pool.free(closed_it->first);
-      closed.erase(closed_it);
 
-      closed[child] = open[level].push(child);  // insert better version of child
-    }
-    else {
-      // The child has either already been expanded, or is worse
-      // than the version in the open list.
-      node_pool.free(child);
+      // The child has the same state as the old copy, so it can take
+      // over the old copy's closed entry.
+      closed_it->first = child;
+      closed_it->second = open[level].push(child);  // insert better version of child
     }
+    // Otherwise the child is no better than the version in the open
+    // list, and no node is made for it.
   }
 
   void initialize()
   {
     for (unsigned level = 0; level <= Domain::num_abstraction_levels; level += 1) {
-      num_generated[level] += 1;
       num_generated_on_first_search_at_level[level] += 1;
-      State start = level % 2 == 0
-                      ? domain.get_start_state()
-                      : domain.get_goal_state();
       State goal = level % 2 == 0
                       ? domain.get_goal_state()
                       : domain.get_start_state();
-      Node *start_node = new (node_pool.malloc()) Node(domain.abstract(level, start),
-                                                       0,
-                                                       0,
-                                                       NULL);
-      closed[start_node] = open[level].push(start_node);
       abstract_goals[level] = goal;
+      seed_level(level);
+    }
+  }
+
+  // Puts the start node of the given level's search on its open list.
+  void seed_level(const unsigned level)
+  {
+    assert(open[level].empty());
+    assert(closed[level].empty());
+
+    num_generated[level] += 1;
+    State start = level % 2 == 0
+                    ? domain.get_start_state()
+                    : domain.get_goal_state();
+    Node *start_node = new (node_pool.malloc()) Node(domain.abstract(level, start),
+                                                     0,
+                                                     0,
+                                                     NULL);
+    closed[level][start_node] = open[level].push(start_node);
+  }
+
+
+  // The bytes taken by the nodes and the open and closed lists.
+  std::size_t get_memory_usage() const
+  {
+    std::size_t bytes = 0;
+    for (unsigned level = 0; level < hierarchy_height; level += 1) {
+      bytes += closed[level].size() * sizeof(Node)
+        + closed[level].memory_usage()
+        + open[level].size() * sizeof(Node *);
+    }
+    return bytes;
+  }
+
+  /*! Discards the searches at the abstract levels, least recently
+      used first, until the memory budget is met or none are left.  No
+      abstract search may be in progress.
+
+      If the budget cannot be met, the base level holds most of the
+      memory, and discarding the abstract levels again at every
+      expansion would only redo their searches over and over.  So the
+      next round waits until the memory use has grown by an eighth of
+      the budget.
+   */
+  void evict_abstract_levels()
+  {
+    std::size_t usage = get_memory_usage();
+    while (usage > memory_budget) {
+      unsigned victim = hierarchy_height;
+      for (unsigned l = 1; l < hierarchy_height; l += 1) {
+        // A level holding just its start node has nothing to give up.
+        if (closed[l].size() > 1
+            && (victim == hierarchy_height || last_used[l] < last_used[victim]))
+          victim = l;
+      }
+
+      if (victim == hierarchy_height)
+        break;
+
+      evict_level(victim);
+      usage = get_memory_usage();
     }
+
+    eviction_threshold = std::max(memory_budget, usage + memory_budget / 8);
+  }
+
+  // Discards the search at the given level, and restarts it.
+  void evict_level(const unsigned level)
+  {
+    assert(level > 0);
+
+    for (ClosedIterator it = closed[level].begin(); it != closed[level].end(); ++it)
+      node_pool.free(it->first);
+    open[level].reset();
+    closed[level].release();
+    num_evictions[level] += 1;
+
+    seed_level(level);
   }
 
   void dump_open_sizes(std::ostream &o) const
@@ -327,7 +505,10 @@ private:
 
   void dump_closed_sizes(std::ostream &o) const
   {
-    o << "closed size: " << closed.size() << std::endl;
+    o << "closed sizes:" << std::endl;
+    for (unsigned level = 0; level < hierarchy_height; level += 1)
+      o << "  " << level << ": " << closed[level].size()
+        << (closed[level].uses_perfect_hash() ? " (dense)" : "") << std::endl;
   }
 
 
@@ -345,6 +526,14 @@ private:
   }
 
 
+  void dump_eviction_information(std::ostream &o) const
+  {
+    o << "evictions per level (budget " << memory_budget << " bytes):" << std::endl;
+    for (unsigned level = 0; level < hierarchy_height; level += 1)
+      o << "  " << level << ": " << num_evictions[level] << std::endl;
+  }
+
+
   void dump_first_searches_information(std::ostream &o) const
   {
     o << "nodes expanded/generated during first search:" << std::endl;
@@ -51,28 +51,78 @@ public:
 		return 1;
 	}
 
-	void compute_successors(const TilesNode15 &n,
-				std::vector<TilesNode15 *> &succs,
-				boost::pool<> &node_pool) {
+	typedef TilesInstance15::Successors Successors;
+
+	template <class NodeT>
+	void compute_successor_states(const NodeT &n,
+				      Successors &succs) const {
+		tiles_instance->compute_glued_successor_states(n, succs, glued);
+	}
+
+	template <class NodeT>
+	void compute_predecessor_states(const NodeT &n,
+					Successors &succs) const {
+		compute_successor_states(n, succs);
+	}
+
+	template <class NodeT>
+	void compute_successors(const NodeT &n,
+				std::vector<NodeT *> &succs,
+				typename NodeT::Pool &node_pool) {
 		tiles_instance->compute_glued_successors(n, succs, glued,
 							 node_pool);
 	}
 
-	void compute_predecessors(const TilesNode15 &n,
-				  std::vector<TilesNode15 *> &succs,
-				  boost::pool<> &node_pool) {
+	template <class NodeT>
+	void compute_predecessors(const NodeT &n,
+				  std::vector<NodeT *> &succs,
+				  typename NodeT::Pool &node_pool) {
 		compute_successors(n, succs, node_pool);
 	}
 
-	void compute_heuristic(const TilesNode15 &parent,
-			       TilesNode15 &child) const {
+	template <class NodeT>
+	void compute_heuristic(const NodeT &parent,
+			       NodeT &child) const {
 		tiles_instance->compute_heuristic(parent, child);
 	}
 
-	void compute_heuristic(TilesNode15 &child) const {
+	template <class NodeT>
+	void compute_heuristic(NodeT &child) const {
 		tiles_instance->compute_heuristic(child);
 	}
 
+	template <class NodeT>
+	void compute_start_heuristic(NodeT &child) const {
+		tiles_instance->compute_start_heuristic(child);
+	}
+
+	// In-place moves, for IDAStar.  A move is the new position of
+	// the blank, which may not be where the glued tile is.
+	typedef TilesInstance15::Move Move;
+	typedef TilesInstance15::Moves Moves;
+	typedef TilesInstance15::MoveState MoveState;
+	static const MoveState initial_move_state =
+		TilesInstance15::initial_move_state;
+
+	unsigned compute_moves(const TilesState15 &s, MoveState ms,
+			       Moves &moves) const {
+		return tiles_instance->compute_glued_moves(s, ms, glued,
+							   moves);
+	}
+
+	MoveState next_move_state(const TilesState15 &s, MoveState ms,
+				  Move m) const {
+		return tiles_instance->next_glued_move_state(s, ms, m);
+	}
+
+	Move apply_move(TilesState15 &s, Move m, TileCost &h) const {
+		return tiles_instance->apply_move(s, m, h);
+	}
+
+	void undo_move(TilesState15 &s, Move undo) const {
+		tiles_instance->undo_move(s, undo);
+	}
+
 	const TilesState15 & get_start_state() const {
 		return tiles_instance->get_start_state();
 	}
@@ -91,6 +141,19 @@ public:
 		return TilesInstance15::is_valid_level(level);
 	}
 
+
+	PermutationRank num_ranks(unsigned level) const {
+		return tiles_instance->num_ranks(level);
+	}
+
+	PermutationRank rank(unsigned level, const TilesState15 &s) const {
+		return tiles_instance->rank(level, s);
+	}
+
+	TilesState15 unrank(unsigned level, PermutationRank r) const {
+		return tiles_instance->unrank(level, r);
+	}
+
 private:
 	TilesInstance15::AbstractionOrder
 	compute_abstraction_order(const TilesState15 &s,
@@ -60,33 +60,91 @@ public:
     return 1;
   }
 
-  void compute_successors(const TilesNode15 &n,
-                          std::vector<TilesNode15 *> &succs,
-                          boost::pool<> &node_pool)
+  typedef TilesInstance15::MacroSuccessors Successors;
+
+  template <class NodeT>
+  void compute_successor_states(const NodeT &n, Successors &succs) const
+  {
+    tiles_instance->compute_macro_successor_states(n, succs);
+  }
+
+  template <class NodeT>
+  void compute_predecessor_states(const NodeT &n, Successors &succs) const
+  {
+    tiles_instance->compute_macro_predecessor_states(n, succs);
+  }
+
+  template <class NodeT>
+  void compute_successors(const NodeT &n,
+                          std::vector<NodeT *> &succs,
+                          typename NodeT::Pool &node_pool)
   {
     tiles_instance->compute_macro_successors(n, succs, node_pool);
   }
 
-  void compute_predecessors(const TilesNode15 &n,
-                            std::vector<TilesNode15 *> &succs,
-                            boost::pool<> &node_pool)
+  template <class NodeT>
+  void compute_predecessors(const NodeT &n,
+                            std::vector<NodeT *> &succs,
+                            typename NodeT::Pool &node_pool)
   {
     tiles_instance->compute_macro_predecessors(n, succs, node_pool);
   }
 
-  void compute_heuristic(const TilesNode15 &parent,
-                         TilesNode15 &child) const
+  // A macro move can slide several tiles, which the incremental
+  // update of the unit-move puzzle does not account for, so the child
+  // is scored from scratch.
+  template <class NodeT>
+  void compute_heuristic(const NodeT &parent,
+                         NodeT &child) const
   {
-    tiles_instance->compute_heuristic(parent, child);
-    child.set_h(child.get_h() / 3);
+    compute_heuristic(child);
   }
 
-  void compute_heuristic(TilesNode15 &child) const
+  template <class NodeT>
+  void compute_heuristic(NodeT &child) const
   {
     tiles_instance->compute_heuristic(child);
     child.set_h(child.get_h() / 3);
   }
 
+  template <class NodeT>
+  void compute_start_heuristic(NodeT &child) const
+  {
+    tiles_instance->compute_start_heuristic(child);
+    child.set_h(child.get_h() / 3);
+  }
+
+  // In-place moves, for IDAStar.  A move is the new position of the
+  // blank, pruned by the macro-move automaton.  As with
+  // compute_heuristic(), the child is scored from scratch.
+  typedef TilesInstance15::Move Move;
+  typedef TilesInstance15::MacroMoves Moves;
+  typedef TilesInstance15::MoveState MoveState;
+  static const MoveState initial_move_state = TilesInstance15::initial_move_state;
+
+  unsigned compute_moves(const TilesState15 &s, MoveState ms, Moves &moves) const
+  {
+    return tiles_instance->compute_macro_moves(s, ms, moves);
+  }
+
+  MoveState next_move_state(const TilesState15 &s, MoveState ms, Move m) const
+  {
+    return tiles_instance->next_macro_move_state(s, ms, m);
+  }
+
+  Move apply_move(TilesState15 &s, Move m, TileCost &h) const
+  {
+    const Move undo = s.get_blank();
+    s = s.move_blank_to(m);
+    h = tiles_instance->get_md().compute_full(s) / 3;
+    return undo;
+  }
+
+  void undo_move(TilesState15 &s, Move undo) const
+  {
+    tiles_instance->undo_move(s, undo);
+  }
+
   const TilesState15 & get_start_state() const
   {
     return tiles_instance->get_start_state();
@@ -108,6 +166,22 @@ public:
   {
     return TilesInstance15::is_valid_level(level);
   }
+
+
+  PermutationRank num_ranks(unsigned level) const
+  {
+    return tiles_instance->num_ranks(level);
+  }
+
+  PermutationRank rank(unsigned level, const TilesState15 &s) const
+  {
+    return tiles_instance->rank(level, s);
+  }
+
+  TilesState15 unrank(unsigned level, PermutationRank r) const
+  {
+    return tiles_instance->unrank(level, r);
+  }
 };
 
 
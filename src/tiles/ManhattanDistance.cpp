@@ -1,8 +1,137 @@
 #include <cassert>
+#include <cstdlib>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MANHATTAN_DIST_VECTOR_KERNELS
+#include <immintrin.h>
+#endif
 
 #include "tiles/ManhattanDistance.hpp"
 
 
+namespace
+{
+  TileCost scalar_full(const boost::uint8_t *goal_places,
+                       boost::uint64_t packed)
+  {
+    const unsigned blank = packed & 0xF;
+    boost::uint64_t slots = packed >> 4;
+    TileCost dist = 0;
+
+    for (unsigned slot = 0; slot < 15; slot += 1, slots >>= 4) {
+      const unsigned tile = slots & 0xF;
+      if (tile == 0)
+        continue;
+      const int pos = slot < blank ? slot : slot + 1;
+      dist += abs(goal_places[tile] - pos / 4)
+        + abs(goal_places[16 + tile] - pos % 4);
+    }
+
+    return dist;
+  }
+
+
+#ifdef MANHATTAN_DIST_VECTOR_KERNELS
+  /*
+   * The vector kernels unpack a board into one byte per position,
+   * holding its tile, or 0 for the blank and obscured tiles.  Looking
+   * the tiles up in the goal row and goal column tables with a byte
+   * shuffle gives where each tile belongs, and a SAD against the row
+   * and column of each position sums the distances.  Positions without
+   * a tile take their own row and column as the goal, adding nothing.
+   */
+
+  __attribute__((target("sse4.1")))
+  inline __m128i unpack_tiles(boost::uint64_t packed)
+  {
+    const boost::uint64_t slot_word = packed >> 4;
+    const __m128i word =
+      _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&slot_word));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i slots =
+      _mm_unpacklo_epi8(_mm_and_si128(word, nibble),
+                        _mm_and_si128(_mm_srli_epi16(word, 4), nibble));
+
+    // Position p holds slot p before the blank and slot p - 1 after
+    // it.  A shuffle index with the high bit set gives 0, for the
+    // blank itself.
+    const __m128i positions = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i blank = _mm_set1_epi8(packed & 0xF);
+    __m128i index = _mm_add_epi8(positions, _mm_cmpgt_epi8(positions, blank));
+    index = _mm_or_si128(index, _mm_cmpeq_epi8(positions, blank));
+
+    return _mm_shuffle_epi8(slots, index);
+  }
+
+  __attribute__((target("sse4.1")))
+  TileCost sse41_full(const boost::uint8_t *goal_places,
+                      boost::uint64_t packed)
+  {
+    const __m128i rows = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1,
+                                       2, 2, 2, 2, 3, 3, 3, 3);
+    const __m128i cols = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3,
+                                       0, 1, 2, 3, 0, 1, 2, 3);
+    const __m128i goal_row_table =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(goal_places));
+    const __m128i goal_col_table =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(goal_places + 16));
+
+    const __m128i tiles = unpack_tiles(packed);
+    const __m128i missing = _mm_cmpeq_epi8(tiles, _mm_setzero_si128());
+    const __m128i goal_rows =
+      _mm_blendv_epi8(_mm_shuffle_epi8(goal_row_table, tiles), rows, missing);
+    const __m128i goal_cols =
+      _mm_blendv_epi8(_mm_shuffle_epi8(goal_col_table, tiles), cols, missing);
+
+    const __m128i sums = _mm_add_epi64(_mm_sad_epu8(goal_rows, rows),
+                                       _mm_sad_epu8(goal_cols, cols));
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+  }
+
+  // With 32 lanes, a single board is looked up in the row and the
+  // column tables at once: the low half handles rows and the high
+  // half columns, which is exactly the layout of goal_places.
+  __attribute__((target("avx2")))
+  TileCost avx2_full(const boost::uint8_t *goal_places,
+                     boost::uint64_t packed)
+  {
+    const __m256i places = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 3, 3, 3, 3,
+                                            0, 1, 2, 3, 0, 1, 2, 3,
+                                            0, 1, 2, 3, 0, 1, 2, 3);
+    const __m256i goal_table =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(goal_places));
+
+    const __m256i tiles = _mm256_broadcastsi128_si256(unpack_tiles(packed));
+    const __m256i missing = _mm256_cmpeq_epi8(tiles, _mm256_setzero_si256());
+    const __m256i goals =
+      _mm256_blendv_epi8(_mm256_shuffle_epi8(goal_table, tiles), places, missing);
+
+    const __m256i sad = _mm256_sad_epu8(goals, places);
+    const __m128i sums = _mm_add_epi64(_mm256_castsi256_si128(sad),
+                                       _mm256_extracti128_si256(sad, 1));
+    return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+  }
+#endif /* MANHATTAN_DIST_VECTOR_KERNELS */
+
+
+  enum KernelKind { scalar_kernel, sse41_kernel, avx2_kernel };
+
+  KernelKind best_kernel()
+  {
+#ifdef MANHATTAN_DIST_VECTOR_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return avx2_kernel;
+    if (__builtin_cpu_supports("sse4.1"))
+      return sse41_kernel;
+#endif
+    return scalar_kernel;
+  }
+}
+
+
 ManhattanDist15::ManhattanDist15(const TilesState15 &goal)
 {
   init(goal);
@@ -12,15 +141,20 @@ void ManhattanDist15::init(const TilesState15 &goal)
 {
   TileIndex goal_pos;
 
+  goal_places.assign(0);
+  // The blank is not counted.
+  table[0].assign(0);
   for (Tile tile = 1; tile < 16; tile += 1) {
     for (goal_pos = 0; goal_pos < 16; goal_pos += 1) {
-      if (goal.get_tiles()[goal_pos] == tile)
+      if (goal.get_tile(goal_pos) == tile)
         break;
     }
 
-    assert(goal.get_tiles()[goal_pos] == tile);
+    assert(goal.get_tile(goal_pos) == tile);
     int goal_col = goal_pos % 4;
     int goal_row = goal_pos / 4;
+    goal_places[tile] = goal_row;
+    goal_places[16 + tile] = goal_col;
     for (unsigned pos = 0; pos < 16; pos += 1) {
       int col = pos % 4;
       int row = pos / 4;
@@ -36,4 +170,31 @@ void ManhattanDist15::init(const TilesState15 &goal)
       else
         assert(table[i][j] <= 6);
   }
+
+  switch (best_kernel()) {
+#ifdef MANHATTAN_DIST_VECTOR_KERNELS
+  case avx2_kernel:
+    full_kernel = avx2_full;
+    break;
+  case sse41_kernel:
+    full_kernel = sse41_full;
+    break;
+#endif
+  default:
+    full_kernel = scalar_full;
+    break;
+  }
+}
+
+
+const char * ManhattanDist15::get_kernel_name()
+{
+  switch (best_kernel()) {
+  case avx2_kernel:
+    return "avx2";
+  case sse41_kernel:
+    return "sse4.1";
+  default:
+    return "scalar";
+  }
 }
@@ -3,6 +3,7 @@
 
 
 #include <boost/array.hpp>
+#include <boost/cstdint.hpp>
 
 #include "tiles/TilesNode.hpp"
 #include "tiles/TilesState.hpp"
@@ -30,23 +31,26 @@ class ManhattanDist15 {
 public:
   ManhattanDist15(const TilesState15 &goal);
 
+  /*! \brief Computes the distance of the whole board.
+
+      This decodes the packed state with byte shuffles and sums the
+      row and column distances with SAD instructions.  The SSE4.1 or
+      AVX2 version is picked at run time, with a table-lookup loop as
+      the fallback.
+   */
   inline TileCost compute_full(const TilesState15 &s) const
   {
-    TileCost dist = 0;
-
-    for (unsigned i = 0; i < 16; i += 1)
-      dist += lookup_dist(s.get_tiles()[i], i);
-
-    return dist;
+    return full_kernel(goal_places.data(), s.get_packed());
   }
 
+  template <class NodeT>
   inline TileCost compute_incr(const TilesState15 &s,
-                               const TilesNode15 &parent) const
+                               const NodeT &parent) const
   {
     const TilesState15 &p = parent.get_state();
     unsigned new_b = s.get_blank();
     unsigned par_b = p.get_blank();
-    Tile tile = p.get_tiles()[new_b];
+    Tile tile = p.get_tile(new_b);
     TileCost ret = 0;
   
     const unsigned par_dist = lookup_dist (tile, par_b);
@@ -65,10 +69,25 @@ public:
   }
 
 
+  /*! \brief The kernel used by compute_full, for the build
+      information: "avx2", "sse4.1" or "scalar".
+   */
+  static const char * get_kernel_name();
+
+
 private:
   void init(const TilesState15 &goal);
 
+  typedef TileCost (*FullKernel)(const boost::uint8_t *goal_places,
+                                 boost::uint64_t packed);
+
   boost::array<boost::array<TileCost, 16>, 16> table;
+
+  // The goal row of each tile, then the goal column of each tile.
+  // Entry 0 of each half, for the blank, is never used.
+  boost::array<boost::uint8_t, 32> goal_places;
+
+  FullKernel full_kernel;
 };
 
 
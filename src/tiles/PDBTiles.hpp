@@ -0,0 +1,170 @@
+#ifndef _PDB_TILES_HPP_
+#define _PDB_TILES_HPP_
+
+#include <boost/utility.hpp>
+
+#include <iostream>
+#include <vector>
+
+#include "tiles/PatternDatabase.hpp"
+#include "tiles/Tiles.hpp"
+#include "tiles/TilesState.hpp"
+#include "tiles/TilesNode.hpp"
+
+
+/*! \brief The fifteen puzzle, with an additive pattern database in
+    place of Manhattan distance as the heuristic.
+
+    This is meant for the non-hierarchical searchers, A* and IDA*.
+ */
+class PDBTilesInstance15 : boost::noncopyable
+{
+private:
+  TilesInstance15 *tiles_instance;
+  const AdditivePDB15 *pdb;
+
+public:
+  PDBTilesInstance15 (TilesInstance15 *tiles_instance,
+                      const AdditivePDB15 *pdb)
+    : tiles_instance(tiles_instance)
+    , pdb(pdb)
+  {
+  }
+
+  ~PDBTilesInstance15 ()
+  {
+    delete pdb;
+    delete tiles_instance;
+  }
+
+  void print(std::ostream &o) const
+  {
+    o << "Initial state:" << std::endl
+      << get_start_state() << std::endl;
+
+    o << std::endl << "Goal state:" << std::endl
+      << get_goal_state() << std::endl;
+
+    o << std::endl << "Initial additive PDB heuristic estimate: "
+      << pdb->compute_full(get_start_state()) << std::endl
+      << "(" << pdb->get_num_patterns() << " patterns, "
+      << pdb->get_mapped_bytes() << " bytes mapped)" << std::endl;
+  }
+
+  bool is_goal(const TilesState15 &s) const
+  {
+    return tiles_instance->is_goal(s);
+  }
+
+  TileCost get_epsilon(const TilesState15 &s) const
+  {
+    return 1;
+  }
+
+  typedef TilesInstance15::Successors Successors;
+
+  template <class NodeT>
+  void compute_successor_states(const NodeT &n, Successors &succs) const
+  {
+    tiles_instance->compute_successor_states(n, succs);
+  }
+
+  template <class NodeT>
+  void compute_predecessor_states(const NodeT &n, Successors &succs) const
+  {
+    tiles_instance->compute_predecessor_states(n, succs);
+  }
+
+  template <class NodeT>
+  void compute_successors(const NodeT &n,
+                          std::vector<NodeT *> &succs,
+                          typename NodeT::Pool &node_pool)
+  {
+    tiles_instance->compute_successors(n, succs, node_pool);
+  }
+
+  template <class NodeT>
+  void compute_predecessors(const NodeT &n,
+                            std::vector<NodeT *> &succs,
+                            typename NodeT::Pool &node_pool)
+  {
+    tiles_instance->compute_predecessors(n, succs, node_pool);
+  }
+
+  // Only the pattern of the moved tile changes, but looking up both of
+  // its entries costs about as much as looking up every pattern of the
+  // child, so the parent is not used.
+  template <class NodeT>
+  void compute_heuristic(const NodeT &parent,
+                         NodeT &child) const
+  {
+    compute_heuristic(child);
+  }
+
+  template <class NodeT>
+  void compute_heuristic(NodeT &child) const
+  {
+    // The entries are 0 only when every tile is home, i.e. at the
+    // goal, so there is no need to raise them to epsilon.
+    child.set_h(pdb->compute_full(child.get_state()));
+  }
+
+  // The database is for the goal, so searching backward uses the
+  // Manhattan distance to the start.
+  template <class NodeT>
+  void compute_start_heuristic(NodeT &child) const
+  {
+    tiles_instance->compute_start_heuristic(child);
+  }
+
+  // In-place moves, for IDAStar.  A move is the new position of the
+  // blank.  As with compute_heuristic(), the child is scored from
+  // scratch.
+  typedef TilesInstance15::Move Move;
+  typedef TilesInstance15::Moves Moves;
+  typedef TilesInstance15::MoveState MoveState;
+  static const MoveState initial_move_state = TilesInstance15::initial_move_state;
+
+  unsigned compute_moves(const TilesState15 &s, MoveState ms, Moves &moves) const
+  {
+    return tiles_instance->compute_moves(s, ms, moves);
+  }
+
+  MoveState next_move_state(const TilesState15 &s, MoveState ms, Move m) const
+  {
+    return tiles_instance->next_move_state(s, ms, m);
+  }
+
+  Move apply_move(TilesState15 &s, Move m, TileCost &h) const
+  {
+    const Move undo = s.get_blank();
+    s = s.move_blank_to(m);
+    h = pdb->compute_full(s);
+    return undo;
+  }
+
+  void undo_move(TilesState15 &s, Move undo) const
+  {
+    tiles_instance->undo_move(s, undo);
+  }
+
+  const TilesState15 & get_start_state() const
+  {
+    return tiles_instance->get_start_state();
+  }
+
+  const TilesState15 & get_goal_state() const
+  {
+    return tiles_instance->get_goal_state();
+  }
+};
+
+
+inline std::ostream & operator << (std::ostream &o, const PDBTilesInstance15 &t)
+{
+  t.print(o);
+  return o;
+}
+
+
+#endif	/* !_PDB_TILES_HPP_ */
@@ -0,0 +1,464 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "tiles/PatternDatabase.hpp"
+
+
+namespace
+{
+  const char pdb_magic[8] = {'T', 'I', 'L', 'E', 'S', 'P', 'D', 'B'};
+
+  /*
+   * The file starts with this header, followed by the table of each
+   * pattern in order: one byte per ranked placement of the pattern's
+   * tiles.
+   */
+  struct PDBFileHeader
+  {
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t num_patterns;
+    boost::int8_t goal[16];
+    boost::uint8_t pattern_sizes[16];
+    boost::uint64_t file_size;
+  };
+
+
+  PDBFileHeader make_header(const TilesState15 &goal,
+                            const AdditivePDB15::Partition &partition)
+  {
+    PDBFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, pdb_magic, sizeof(header.magic));
+    header.version = AdditivePDB15::file_version;
+    header.num_patterns = partition.size();
+
+    for (TileIndex i = 0; i < 16; i += 1)
+      header.goal[i] = goal.get_tile(i);
+
+    header.file_size = sizeof(header);
+    for (unsigned p = 0; p < partition.size(); p += 1) {
+      header.pattern_sizes[p] = partition[p];
+      header.file_size += num_k_permutations(16, partition[p]);
+    }
+
+    return header;
+  }
+
+
+  /*
+   * Sets of board positions are 16-bit masks, with position 0 in the
+   * low bit.
+   */
+  const unsigned all_positions = 0xFFFF;
+  const unsigned left_column = 0x1111;
+  const unsigned right_column = 0x8888;
+
+  inline unsigned neighbors(unsigned positions)
+  {
+    return (((positions & ~left_column) >> 1)
+            | ((positions & ~right_column) << 1)
+            | (positions >> 4)
+            | (positions << 4)) & all_positions;
+  }
+
+  // The positions that the blank can reach from the given positions
+  // without moving a pattern tile, i.e. for free.
+  inline unsigned blank_closure(unsigned blanks, unsigned free_positions)
+  {
+    unsigned reached = blanks & free_positions;
+    for (;;) {
+      const unsigned grown = reached | (neighbors(reached) & free_positions);
+      if (grown == reached)
+        return reached;
+      reached = grown;
+    }
+  }
+
+  inline unsigned lowest_position(unsigned positions)
+  {
+    assert(positions != 0);
+    return __builtin_ctz(positions);
+  }
+
+
+  /*
+   * The state of the breadth-first search for a single pattern.  An
+   * abstract state is a placement of the pattern's tiles plus the
+   * position of the blank; the blank positions are kept as a mask per
+   * placement.  Each layer of the search is closed under free blank
+   * moves before it is expanded.
+   */
+  struct PatternSearch
+  {
+    unsigned num_tiles;
+    PermutationRank num_placements;
+    unsigned depth;
+
+    std::vector<boost::uint8_t> dist;
+    std::vector<boost::uint16_t> current;
+    std::vector<boost::uint16_t> next;
+    std::vector<boost::uint16_t> seen;
+  };
+
+  const boost::uint8_t unreached = 0xFF;
+
+
+  struct LayerWork
+  {
+    PatternSearch *search;
+    PermutationRank begin;
+    PermutationRank end;
+    PermutationRank num_reached;
+    PermutationRank num_active;
+  };
+
+
+  // Moves a pattern tile into the blank, for every blank position in
+  // the current layer, and records the resulting states in the next
+  // layer.
+  void * expand_layer(void *arg)
+  {
+    LayerWork &work = *static_cast<LayerWork *>(arg);
+    PatternSearch &s = *work.search;
+    boost::array<TileIndex, 16> places;
+    boost::array<unsigned char, 16> tile_at;
+
+    for (PermutationRank r = work.begin; r < work.end; r += 1) {
+      const unsigned blanks = s.current[r];
+      if (blanks == 0)
+        continue;
+
+      unrank_k_permutation(16, s.num_tiles, r, places);
+      unsigned occupied = 0;
+      for (unsigned j = 0; j < s.num_tiles; j += 1) {
+        occupied |= 1u << places[j];
+        tile_at[places[j]] = j;
+      }
+
+      for (unsigned movable = neighbors(blanks) & occupied;
+           movable != 0;
+           movable &= movable - 1) {
+        const unsigned from = lowest_position(movable);
+        const unsigned j = tile_at[from];
+        const unsigned new_blank = 1u << from;
+
+        for (unsigned targets = neighbors(new_blank) & blanks;
+             targets != 0;
+             targets &= targets - 1) {
+          places[j] = lowest_position(targets);
+          const PermutationRank child = rank_k_permutation(16, s.num_tiles, places);
+          if ((s.seen[child] & new_blank) == 0 && (s.next[child] & new_blank) == 0)
+            __sync_fetch_and_or(&s.next[child], new_blank);
+        }
+        places[j] = from;
+      }
+    }
+
+    return NULL;
+  }
+
+
+  // Closes the next layer under free blank moves, drops what has been
+  // seen before and makes the rest the current layer.
+  void * settle_layer(void *arg)
+  {
+    LayerWork &work = *static_cast<LayerWork *>(arg);
+    PatternSearch &s = *work.search;
+    boost::array<TileIndex, 16> places;
+    work.num_reached = 0;
+    work.num_active = 0;
+
+    for (PermutationRank r = work.begin; r < work.end; r += 1) {
+      const unsigned blanks = s.next[r] & ~s.seen[r];
+      s.next[r] = 0;
+      if (blanks == 0) {
+        s.current[r] = 0;
+        continue;
+      }
+
+      unrank_k_permutation(16, s.num_tiles, r, places);
+      unsigned occupied = 0;
+      for (unsigned j = 0; j < s.num_tiles; j += 1)
+        occupied |= 1u << places[j];
+
+      // The seen blank positions are closed already, so the closure
+      // of the new ones never overlaps them.
+      const unsigned reached = blank_closure(blanks, ~occupied & all_positions);
+      s.current[r] = reached;
+      s.seen[r] |= reached;
+      work.num_active += 1;
+      if (s.dist[r] == unreached) {
+        s.dist[r] = s.depth + 1;
+        work.num_reached += 1;
+      }
+    }
+
+    return NULL;
+  }
+
+
+  // Runs the given layer function over all placements, split evenly
+  // among the threads, and totals the work counts.
+  LayerWork run_in_parallel(void * (*layer_function)(void *),
+                            PatternSearch &s,
+                            unsigned num_threads)
+  {
+    std::vector<LayerWork> work(num_threads);
+    std::vector<pthread_t> threads(num_threads);
+    std::vector<bool> started(num_threads, false);
+
+    const PermutationRank per_thread =
+      (s.num_placements + num_threads - 1) / num_threads;
+    for (unsigned i = 0; i < num_threads; i += 1) {
+      work[i].search = &s;
+      work[i].begin = std::min(s.num_placements, i * per_thread);
+      work[i].end = std::min(s.num_placements, (i + 1) * per_thread);
+      work[i].num_reached = 0;
+      work[i].num_active = 0;
+    }
+
+    // The calling thread takes the first share.  If a thread cannot be
+    // started, its share is done here too.
+    for (unsigned i = 1; i < num_threads; i += 1)
+      started[i] = pthread_create(&threads[i], NULL, layer_function, &work[i]) == 0;
+    layer_function(&work[0]);
+    for (unsigned i = 1; i < num_threads; i += 1)
+      if (!started[i])
+        layer_function(&work[i]);
+
+    LayerWork total = work[0];
+    for (unsigned i = 1; i < num_threads; i += 1) {
+      if (started[i])
+        pthread_join(threads[i], NULL);
+      total.num_reached += work[i].num_reached;
+      total.num_active += work[i].num_active;
+    }
+
+    return total;
+  }
+
+
+  void build_pattern(const TilesState15 &goal,
+                     const std::vector<Tile> &tiles,
+                     unsigned num_threads,
+                     PatternSearch &s,
+                     std::ostream &log)
+  {
+    s.num_tiles = tiles.size();
+    s.num_placements = num_k_permutations(16, s.num_tiles);
+    s.dist.assign(s.num_placements, unreached);
+    s.current.assign(s.num_placements, 0);
+    s.next.assign(s.num_placements, 0);
+    s.seen.assign(s.num_placements, 0);
+
+    boost::array<TileIndex, 16> positions;
+    goal.get_tile_positions(positions);
+    boost::array<TileIndex, 16> places;
+    unsigned occupied = 0;
+    for (unsigned j = 0; j < tiles.size(); j += 1) {
+      places[j] = positions[tiles[j]];
+      occupied |= 1u << places[j];
+    }
+
+    const PermutationRank r = rank_k_permutation(16, s.num_tiles, places);
+    s.dist[r] = 0;
+    s.current[r] = blank_closure(1u << goal.get_blank(), ~occupied & all_positions);
+    s.seen[r] = s.current[r];
+
+    PermutationRank num_reached = 1;
+    for (s.depth = 0; ; s.depth += 1) {
+      log << "  depth " << s.depth << ": " << num_reached << " placements"
+          << std::endl;
+
+      run_in_parallel(expand_layer, s, num_threads);
+      const LayerWork settled = run_in_parallel(settle_layer, s, num_threads);
+      num_reached = settled.num_reached;
+
+      // A layer may hold only new blank positions for placements that
+      // were reached before, so the search ends only when it is empty.
+      if (settled.num_active == 0)
+        break;
+
+      assert(s.depth + 2 < unreached);
+    }
+
+#ifndef NDEBUG
+    for (PermutationRank i = 0; i < s.num_placements; i += 1)
+      assert(s.dist[i] != unreached);
+#endif
+  }
+}
+
+
+AdditivePDB15::AdditivePDB15(const Partition &partition,
+                             const void *mapped,
+                             std::size_t mapped_size)
+  : patterns(get_patterns(partition))
+  , tables()
+  , mapped(mapped)
+  , mapped_size(mapped_size)
+{
+  const boost::uint8_t *table =
+    static_cast<const boost::uint8_t *>(mapped) + sizeof(PDBFileHeader);
+  for (unsigned p = 0; p < patterns.size(); p += 1) {
+    tables.push_back(table);
+    table += num_k_permutations(16, patterns[p].size());
+  }
+  assert(table == static_cast<const boost::uint8_t *>(mapped) + mapped_size);
+}
+
+
+AdditivePDB15::~AdditivePDB15()
+{
+  munmap(const_cast<void *>(mapped), mapped_size);
+}
+
+
+std::vector<std::vector<Tile> >
+AdditivePDB15::get_patterns(const Partition &partition)
+{
+  std::vector<std::vector<Tile> > patterns(partition.size());
+  Tile t = 1;
+  for (unsigned p = 0; p < partition.size(); p += 1)
+    for (unsigned j = 0; j < partition[p]; j += 1)
+      patterns[p].push_back(t++);
+  assert(t == 16);
+  return patterns;
+}
+
+
+bool AdditivePDB15::parse_partition(const std::string &spec,
+                                    Partition &partition)
+{
+  partition.clear();
+  std::istringstream in(spec);
+  unsigned total = 0;
+
+  for (;;) {
+    unsigned size;
+    if (!(in >> size) || size == 0 || size > 15)
+      return false;
+    partition.push_back(size);
+    total += size;
+
+    const int c = in.get();
+    if (c == EOF)
+      break;
+    if (c != '-')
+      return false;
+  }
+
+  return total == 15;
+}
+
+
+bool AdditivePDB15::build(const std::string &path,
+                          const TilesState15 &goal,
+                          const Partition &partition,
+                          unsigned num_threads,
+                          std::ostream &log)
+{
+  const PDBFileHeader header = make_header(goal, partition);
+  const std::vector<std::vector<Tile> > patterns = get_patterns(partition);
+
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp." << getpid();
+  std::ofstream out(tmp_path.str().c_str(), std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  log << "building pattern database " << path
+      << " with " << num_threads << " threads" << std::endl;
+
+  for (unsigned p = 0; p < patterns.size() && out; p += 1) {
+    log << "pattern " << p << ", tiles";
+    for (unsigned j = 0; j < patterns[p].size(); j += 1)
+      log << " " << patterns[p][j];
+    log << ":" << std::endl;
+
+    PatternSearch s;
+    build_pattern(goal, patterns[p], num_threads, s, log);
+    out.write(reinterpret_cast<const char *>(&s.dist[0]), s.dist.size());
+  }
+
+  out.close();
+  if (!out || rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    log << "error: cannot write pattern database " << path << ": "
+        << strerror(errno) << std::endl;
+    unlink(tmp_path.str().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+AdditivePDB15 * AdditivePDB15::map(const std::string &path,
+                                   const TilesState15 &goal,
+                                   const Partition &partition,
+                                   std::ostream &log)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    log << "error: cannot open pattern database " << path << ": "
+        << strerror(errno) << std::endl;
+    return NULL;
+  }
+
+  struct stat st;
+  void *mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(PDBFileHeader))
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapped == MAP_FAILED) {
+    log << "error: cannot map pattern database " << path << std::endl;
+    return NULL;
+  }
+
+  const PDBFileHeader expected = make_header(goal, partition);
+  const PDBFileHeader &header = *static_cast<const PDBFileHeader *>(mapped);
+
+  const char *problem = NULL;
+  if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+      || header.version != expected.version)
+    problem = "is not a pattern database of this version";
+  else if (memcmp(&header, &expected, sizeof(header)) != 0
+           || (boost::uint64_t) st.st_size != header.file_size)
+    problem = "was not built for this goal and partition";
+
+  if (problem != NULL) {
+    log << "error: " << path << " " << problem << std::endl;
+    munmap(mapped, st.st_size);
+    return NULL;
+  }
+
+  return new AdditivePDB15(partition, mapped, st.st_size);
+}
+
+
+AdditivePDB15 * AdditivePDB15::load_or_build(const std::string &path,
+                                             const TilesState15 &goal,
+                                             const Partition &partition,
+                                             std::ostream &log)
+{
+  if (access(path.c_str(), F_OK) != 0) {
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const unsigned num_threads = num_cpus > 0 ? num_cpus : 1;
+    if (!build(path, goal, partition, num_threads, log))
+      return NULL;
+  }
+
+  return map(path, goal, partition, log);
+}
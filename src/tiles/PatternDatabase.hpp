@@ -0,0 +1,130 @@
+#ifndef _PATTERN_DATABASE_HPP_
+#define _PATTERN_DATABASE_HPP_
+
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tiles/TilesState.hpp"
+#include "tiles/TilesTypes.hpp"
+#include "util/PermutationRank.hpp"
+
+
+/*! \brief A disjoint additive pattern database heuristic for the
+    fifteen puzzle.
+
+    The tiles are partitioned into patterns.  For each pattern there is
+    a table that gives, for every placement of the pattern's tiles on
+    the board, the fewest moves of those tiles needed to bring them to
+    their goal positions, where moves of the other tiles are free.  No
+    move is counted by two patterns, so the entries of the patterns can
+    be added.
+
+    The tables are built with a multi-threaded backward breadth-first
+    search from the goal and written to a versioned file.  Searches map
+    that file read-only, so every process on a machine shares one copy.
+ */
+class AdditivePDB15 : boost::noncopyable
+{
+public:
+  /*! \brief The number of tiles in each pattern.
+
+      The patterns take the tiles 1, 2, ..., 15 in order, so {7, 8}
+      is the usual 7-8 partitioning: tiles 1 through 7, then tiles 8
+      through 15.
+   */
+  typedef std::vector<unsigned> Partition;
+
+  static const boost::uint32_t file_version = 1;
+
+  //! Parses a partition written as pattern sizes, such as "7-8" or "5-5-5".
+  static bool parse_partition(const std::string &spec, Partition &partition);
+
+  /*! \brief Builds the database for the given goal and writes it to
+      the given path.
+
+      The file is written under a temporary name and renamed into
+      place, so processes racing to build the same database never see
+      a partial file.  Returns false on error.
+   */
+  static bool build(const std::string &path,
+                    const TilesState15 &goal,
+                    const Partition &partition,
+                    unsigned num_threads,
+                    std::ostream &log);
+
+  /*! \brief Maps the database in the given file.
+
+      Returns NULL if the file cannot be mapped or was not built for the
+      given goal and partition.
+   */
+  static AdditivePDB15 * map(const std::string &path,
+                             const TilesState15 &goal,
+                             const Partition &partition,
+                             std::ostream &log);
+
+  //! Maps the database in the given file, building it first if needed.
+  static AdditivePDB15 * load_or_build(const std::string &path,
+                                       const TilesState15 &goal,
+                                       const Partition &partition,
+                                       std::ostream &log);
+
+  ~AdditivePDB15();
+
+  inline TileCost compute_full(const TilesState15 &s) const
+  {
+    boost::array<TileIndex, 16> positions;
+    s.get_tile_positions(positions);
+
+    TileCost h = 0;
+    for (unsigned p = 0; p < patterns.size(); p += 1)
+      h += lookup(p, positions);
+    return h;
+  }
+
+  std::size_t get_num_patterns() const
+  {
+    return patterns.size();
+  }
+
+  std::size_t get_mapped_bytes() const
+  {
+    return mapped_size;
+  }
+
+private:
+  AdditivePDB15(const Partition &partition,
+                const void *mapped,
+                std::size_t mapped_size);
+
+  inline TileCost lookup(unsigned p,
+                         const boost::array<TileIndex, 16> &positions) const
+  {
+    const std::vector<Tile> &tiles = patterns[p];
+    boost::array<TileIndex, 16> places;
+    for (unsigned j = 0; j < tiles.size(); j += 1) {
+      assert(tiles[j] > 0);
+      places[j] = positions[tiles[j]];
+    }
+
+    return tables[p][rank_k_permutation(16, tiles.size(), places)];
+  }
+
+  static std::vector<std::vector<Tile> > get_patterns(const Partition &partition);
+
+private:
+  std::vector<std::vector<Tile> > patterns;
+  std::vector<const boost::uint8_t *> tables;
+
+  const void *mapped;
+  std::size_t mapped_size;
+};
+
+
+#endif /* !_PATTERN_DATABASE_HPP_ */
@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <cassert>
 #include <iomanip>
+#include <set>
+
+#include <boost/unordered_set.hpp>
 
 #include "tiles/Tiles.hpp"
 
@@ -9,9 +12,181 @@ TilesInstance15::TilesInstance15 (const TilesState15 &start,
     : start(start)
     , goal(goal)
     , md_heur(goal)
+    , start_md(start)
     , abstraction_order(get_custom_abstraction(start, md_heur))
+    , unit_fsm(4, find_redundant_sequences(false, unit_redundancy_length))
+    , macro_fsm(12, find_redundant_sequences(true, macro_redundancy_length))
+    , inverse_fsm(4, find_redundant_sequences(false, 2))
 {
   assert(is_goal(goal));
+  init_move_tables();
+}
+
+
+TilesInstance15::TilesInstance15 (const TilesInstance15 &other,
+                                  const TilesState15 &start,
+                                  const TilesState15 &goal)
+    : start(start)
+    , goal(goal)
+    , md_heur(goal)
+    , start_md(start)
+    , abstraction_order(get_custom_abstraction(start, md_heur))
+    , unit_fsm(other.unit_fsm)
+    , macro_fsm(other.macro_fsm)
+    , inverse_fsm(other.inverse_fsm)
+{
+  init_move_tables();
+}
+
+
+void TilesInstance15::init_move_tables()
+{
+  for (unsigned blank = 0; blank < 16; blank += 1) {
+    const unsigned col = blank % 4;
+    const unsigned row = blank / 4;
+
+    unsigned n = 0;
+    if (col > 0)
+      unit_moves[blank][n++] = blank - 1;
+    if (col < 3)
+      unit_moves[blank][n++] = blank + 1;
+    if (row > 0)
+      unit_moves[blank][n++] = blank - 4;
+    if (row < 3)
+      unit_moves[blank][n++] = blank + 4;
+    num_unit_moves[blank] = n;
+    for (unsigned i = 0; i < n; i += 1)
+      unit_move_labels[blank][i] = unit_move_label(blank, unit_moves[blank][i]);
+
+    // Along the column, then along the row, as
+    // compute_macro_successor_states() orders them.
+    n = 0;
+    for (unsigned i = 0; i < 4; i += 1)
+      if (i != row)
+        macro_moves[blank][n++] = col + 4 * i;
+    for (unsigned j = 0; j < 4; j += 1)
+      if (j != col)
+        macro_moves[blank][n++] = row * 4 + j;
+    assert(n == macro_moves[blank].size());
+    for (unsigned i = 0; i < n; i += 1)
+      macro_move_labels[blank][i] = macro_move_label(blank, macro_moves[blank][i]);
+  }
+}
+
+
+bool TilesInstance15::move_by_label(bool macro, unsigned label, TilesState15 &s)
+{
+  const int col = s.get_blank() % 4;
+  const int row = s.get_blank() / 4;
+
+  int new_col = col;
+  int new_row = row;
+  if (!macro) {
+    const int d = label % 2 == 0 ? -1 : 1;
+    if (label < 2)
+      new_col += d;
+    else
+      new_row += d;
+  }
+  else {
+    const int d = label % 6 < 3 ? label % 6 - 3 : label % 6 - 2;
+    if (label < 6)
+      new_row += d;
+    else
+      new_col += d;
+  }
+
+  if (new_col < 0 || new_col > 3 || new_row < 0 || new_row > 3)
+    return false;
+  const TileIndex new_blank = new_row * 4 + new_col;
+  assert((macro ? macro_move_label(s.get_blank(), new_blank)
+                : unit_move_label(s.get_blank(), new_blank)) == label);
+  s = s.move_blank_to(new_blank);
+  return true;
+}
+
+
+/*
+ * A sequence of moves is redundant if, from every position of the blank
+ * that it can be made from, it reaches a state that a shorter sequence
+ * reaches, or one of the same length that comes first by label.  The
+ * sequences are tried shortest first and in label order, from a start
+ * state of distinct tiles with the blank at each position.  Only those
+ * that contain no shorter redundant sequence are tried, so none of the
+ * results contains another.
+ */
+std::vector<MovePruningFSM::Sequence>
+TilesInstance15::find_redundant_sequences(bool macro, unsigned max_length)
+{
+  const unsigned num_labels = macro ? 12 : 4;
+
+  boost::array<TilesState15, 16> starts;
+  boost::array<boost::unordered_set<TilesState15>, 16> seen;
+  for (unsigned blank = 0; blank < 16; blank += 1) {
+    TileArray tiles;
+    for (unsigned i = 0; i < 16; i += 1)
+      tiles[i] = i == blank ? 0 : (i < blank ? i + 1 : i);
+    starts[blank] = TilesState15(tiles);
+    seen[blank].insert(starts[blank]);
+  }
+
+  std::vector<MovePruningFSM::Sequence> redundant;
+  std::set<MovePruningFSM::Sequence> is_redundant;
+  std::vector<MovePruningFSM::Sequence> survivors(1);
+
+  for (unsigned length = 1; length <= max_length; length += 1) {
+    std::vector<MovePruningFSM::Sequence> next_survivors;
+
+    for (unsigned i = 0; i < survivors.size(); i += 1) {
+      for (unsigned label = 0; label < num_labels; label += 1) {
+        MovePruningFSM::Sequence seq(survivors[i]);
+        seq.push_back(label);
+
+        // The prefix contains no redundant sequence, so only a suffix
+        // can be one.
+        bool has_redundant_suffix = false;
+        for (unsigned j = 1; j < seq.size() && !has_redundant_suffix; j += 1)
+          has_redundant_suffix = is_redundant.count(
+            MovePruningFSM::Sequence(seq.begin() + j, seq.end())) != 0;
+        if (has_redundant_suffix)
+          continue;
+
+        bool applies = false;
+        bool is_duplicate = true;
+        std::vector<std::pair<unsigned, TilesState15> > reached;
+        for (unsigned blank = 0; blank < 16; blank += 1) {
+          TilesState15 s = starts[blank];
+          unsigned j = 0;
+          while (j < seq.size() && move_by_label(macro, seq[j], s))
+            j += 1;
+          if (j < seq.size())
+            continue;
+
+          applies = true;
+          if (seen[blank].count(s) == 0) {
+            is_duplicate = false;
+            reached.push_back(std::make_pair(blank, s));
+          }
+        }
+
+        if (!applies)
+          continue;
+        if (is_duplicate) {
+          redundant.push_back(seq);
+          is_redundant.insert(seq);
+        }
+        else {
+          for (unsigned j = 0; j < reached.size(); j += 1)
+            seen[reached[j].first].insert(reached[j].second);
+          next_survivors.push_back(seq);
+        }
+      }
+    }
+
+    survivors.swap(next_survivors);
+  }
+
+  return redundant;
 }
 
 
@@ -29,25 +204,40 @@ void TilesInstance15::print(std::ostream &o) const
 }
 
 
-TilesNode15 * TilesInstance15::child(const TilesState15 &new_state,
-                                     TileCost new_g,
-                                     const TilesNode15 &parent,
-                                     boost::pool<> &node_pool)
+template <class NodeT>
+void TilesInstance15::make_children(const NodeT &parent,
+                                    const MovePruningFSM &fsm,
+                                    const TileIndex *targets,
+                                    const unsigned char *labels,
+                                    unsigned num_targets,
+                                    Tile glued,
+                                    std::vector<NodeT *> &succs,
+                                    typename NodeT::Pool &node_pool) const
 {
-  assert(new_state != parent.get_state());
-  assert(parent.get_parent() == NULL ||
-         new_state != parent.get_parent()->get_state());
-  TilesNode15 *child_node =
-    new (node_pool.malloc()) TilesNode15(new_state,
-                                         new_g,
-                                         0,
-                                         &parent);
-  return child_node;
+  succs.clear();
+  const TilesState15 &s = parent.get_state();
+  for (unsigned i = 0; i < num_targets; i += 1) {
+    const MovePruningFSM::State ms = fsm.next(parent.get_move_state(), labels[i]);
+    if (ms == MovePruningFSM::pruned
+        || (glued != 0 && s.get_tile(targets[i]) == glued))
+      continue;
+
+    NodeT *child_node =
+      new (node_pool.malloc()) NodeT(s.move_blank_to(targets[i]),
+                                     parent.get_g() + 1,
+                                     0,
+                                     &parent);
+    child_node->set_move_state(ms);
+    assert(parent.get_parent() == NULL ||
+           child_node->get_state() != parent.get_parent()->get_state());
+    succs.push_back(child_node);
+  }
 }
 
 
-void TilesInstance15::compute_heuristic(const TilesNode15 &parent,
-                                        TilesNode15 &child) const
+template <class NodeT>
+void TilesInstance15::compute_heuristic(const NodeT &parent,
+                                        NodeT &child) const
 {
   TileCost new_h = md_heur.compute_incr(child.get_state(), parent);
   if (!is_goal(child.get_state()))
@@ -56,7 +246,8 @@ void TilesInstance15::compute_heuristic(const TilesNode15 &parent,
 }
 
 
-void TilesInstance15::compute_heuristic(TilesNode15 &child) const
+template <class NodeT>
+void TilesInstance15::compute_heuristic(NodeT &child) const
 {
   TileCost new_h = md_heur.compute_full(child.get_state());
   if (!is_goal(child.get_state()))
@@ -65,12 +256,22 @@ void TilesInstance15::compute_heuristic(TilesNode15 &child) const
 }
 
 
-void TilesInstance15::compute_successors(const TilesNode15 &n,
-                                         std::vector<TilesNode15 *> &succs,
-                                         boost::pool<> &node_pool)
+template <class NodeT>
+void TilesInstance15::compute_start_heuristic(NodeT &child) const
+{
+  TileCost new_h = start_md.compute_full(child.get_state());
+  if (child.get_state() != start)
+    new_h = 1 > new_h ? 1 : new_h;
+  child.set_h(new_h);
+}
+
+
+template <class NodeT>
+void TilesInstance15::compute_successor_states(const NodeT &n,
+                                               Successors &succs) const
 {
   succs.clear();
-  const TilesNode15 *gp = n.get_parent();
+  const NodeT *gp = n.get_parent();
 
   const unsigned blank = n.get_state().get_blank();
   const unsigned col = blank % 4;
@@ -79,36 +280,37 @@ void TilesInstance15::compute_successors(const TilesNode15 &n,
   const TileCost g = n.get_g();
   const TileCost new_g = g + 1;
 
-  if (col > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 1)) {
-    const TilesState15 new_state = n.get_state().move_blank_left();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
-  if (col < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 1)) {
-    const TilesState15 new_state = n.get_state().move_blank_right();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
-  if (row > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 4)) {
-    const TilesState15 new_state = n.get_state().move_blank_up();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
-  if (row < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 4)) {
-    const TilesState15 new_state = n.get_state().move_blank_down();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
+  if (col > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 1))
+    succs.push_back(n.get_state().move_blank_left(), new_g, blank - 1);
+  if (col < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 1))
+    succs.push_back(n.get_state().move_blank_right(), new_g, blank + 1);
+  if (row > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 4))
+    succs.push_back(n.get_state().move_blank_up(), new_g, blank - 4);
+  if (row < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 4))
+    succs.push_back(n.get_state().move_blank_down(), new_g, blank + 4);
+}
+
+
+template <class NodeT>
+void TilesInstance15::compute_successors(const NodeT &n,
+                                         std::vector<NodeT *> &succs,
+                                         typename NodeT::Pool &node_pool)
+{
+  const TileIndex blank = n.get_state().get_blank();
+  make_children(n, unit_fsm, unit_moves[blank].data(),
+                unit_move_labels[blank].data(), num_unit_moves[blank], 0,
+                succs, node_pool);
 }
 
+
+template <class NodeT>
 void
-TilesInstance15::compute_glued_successors(const TilesNode15 &n,
-					  std::vector<TilesNode15 *> &succs,
-					  Tile glued,
-					  boost::pool<> &node_pool)
+TilesInstance15::compute_glued_successor_states(const NodeT &n,
+                                                Successors &succs,
+                                                Tile glued) const
 {
   succs.clear();
-  const TilesNode15 *gp = n.get_parent();
+  const NodeT *gp = n.get_parent();
 
   const TilesState15 p = n.get_state();
   const unsigned blank = n.get_state().get_blank();
@@ -119,46 +321,58 @@ TilesInstance15::compute_glued_successors(const TilesNode15 &n,
   const TileCost new_g = g + 1;
 
   if (col > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 1)
-      && (p.get_left_tile() != glued)) {
-    const TilesState15 new_state = n.get_state().move_blank_left();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
+      && (p.get_left_tile() != glued))
+    succs.push_back(n.get_state().move_blank_left(), new_g, blank - 1);
   if (col < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 1)
-      && (p.get_right_tile() != glued)) {
-    const TilesState15 new_state = n.get_state().move_blank_right();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
+      && (p.get_right_tile() != glued))
+    succs.push_back(n.get_state().move_blank_right(), new_g, blank + 1);
   if (row > 0 && (gp == NULL || gp->get_state().get_blank() != blank - 4)
-      && (p.get_up_tile() != glued)) {
-    const TilesState15 new_state = n.get_state().move_blank_up();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
+      && (p.get_up_tile() != glued))
+    succs.push_back(n.get_state().move_blank_up(), new_g, blank - 4);
   if (row < 3 && (gp == NULL || gp->get_state().get_blank() != blank + 4)
-      && (p.get_down_tile() != glued)) {
-    const TilesState15 new_state = n.get_state().move_blank_down();
-    TilesNode15 *child_node = child(new_state, new_g, n, node_pool);
-    succs.push_back(child_node);
-  }
+      && (p.get_down_tile() != glued))
+    succs.push_back(n.get_state().move_blank_down(), new_g, blank + 4);
+}
+
+
+template <class NodeT>
+void
+TilesInstance15::compute_glued_successors(const NodeT &n,
+					  std::vector<NodeT *> &succs,
+					  Tile glued,
+					  typename NodeT::Pool &node_pool)
+{
+  const TileIndex blank = n.get_state().get_blank();
+  make_children(n, inverse_fsm, unit_moves[blank].data(),
+                unit_move_labels[blank].data(), num_unit_moves[blank], glued,
+                succs, node_pool);
+}
+
+
+template <class NodeT>
+void TilesInstance15::compute_predecessor_states(const NodeT &n,
+                                                 Successors &succs) const
+{
+  compute_successor_states(n, succs);
 }
 
 
-void TilesInstance15::compute_predecessors(const TilesNode15 &n,
-                                           std::vector<TilesNode15 *> &succs,
-                                           boost::pool<> &node_pool)
+template <class NodeT>
+void TilesInstance15::compute_predecessors(const NodeT &n,
+                                           std::vector<NodeT *> &succs,
+                                           typename NodeT::Pool &node_pool)
 {
   compute_successors(n, succs, node_pool);
 }
 
 
-void TilesInstance15::compute_macro_successors(const TilesNode15 &n,
-                                               std::vector<TilesNode15 *> &succs,
-                                               boost::pool<> &node_pool)
+template <class NodeT>
+void
+TilesInstance15::compute_macro_successor_states(const NodeT &n,
+                                                MacroSuccessors &succs) const
 {
   succs.clear();
-  const TilesNode15 *gp = n.get_parent();
+  const NodeT *gp = n.get_parent();
 
   const unsigned blank = n.get_state().get_blank();
   const unsigned col = blank % 4;
@@ -167,76 +381,87 @@ void TilesInstance15::compute_macro_successors(const TilesNode15 &n,
   const TileCost g = n.get_g();
   const TileCost new_g = g + 1;
 
+  // A macro move slides the blank several positions along a row or
+  // column; each one is built up from unit moves of the packed state.
+  // Moves up and left are generated farthest first; moved[k] is the
+  // state with the blank moved k + 1 positions.
+  boost::array<TilesState15, 3> moved;
+
   // move the blank up
+  for (unsigned k = 0; k < row; k += 1)
+    moved[k] = (k == 0 ? n.get_state() : moved[k - 1]).move_blank_up();
   for (unsigned i = 0; i < row; i += 1) {
     const unsigned new_blank = col + 4 * i;
-    if (gp == NULL || gp->get_state().get_blank() != new_blank) {
-      TileArray new_tiles = n.get_state().get_tiles();
-      for(unsigned idx = blank; idx >= 4 * (i + 1); idx -= 4){
-        std::swap(new_tiles[idx], new_tiles[idx - 4]);
-      }
-
-      TilesNode15 *child_node = child(TilesState15(new_tiles), new_g, n, node_pool);
-      succs.push_back(child_node);
-    } /* end if */
+    if (gp == NULL || gp->get_state().get_blank() != new_blank)
+      succs.push_back(moved[row - i - 1], new_g, new_blank);
   } /* end for */
 
   // move the blank down
-  for (unsigned i = row + 1; i < 4; i += 1) {
-    const unsigned new_blank = col + 4 * i;
-    if (gp == NULL || gp->get_state().get_blank() != new_blank) {
-      TileArray new_tiles = n.get_state().get_tiles();
-      for(unsigned idx = blank + 4; idx <= new_blank; idx += 4){
-        std::swap(new_tiles[idx], new_tiles[idx - 4]);
-      }
-
-      TilesNode15 *child_node = child(TilesState15(new_tiles), new_g, n, node_pool);
-      succs.push_back(child_node);
-    } /* end if */
-  } /* end for */
+  {
+    TilesState15 new_state = n.get_state();
+    for (unsigned i = row + 1; i < 4; i += 1) {
+      new_state = new_state.move_blank_down();
+      const unsigned new_blank = col + 4 * i;
+      if (gp == NULL || gp->get_state().get_blank() != new_blank)
+        succs.push_back(new_state, new_g, new_blank);
+    } /* end for */
+  }
 
   // move the blank left
+  for (unsigned k = 0; k < col; k += 1)
+    moved[k] = (k == 0 ? n.get_state() : moved[k - 1]).move_blank_left();
   for (unsigned j = 0; j < col; j += 1) {
     const unsigned new_blank = row * 4 + j;
-    if (gp == NULL || gp->get_state().get_blank() != new_blank) {
-      TileArray new_tiles = n.get_state().get_tiles();
-      for(unsigned idx = blank; idx > new_blank; idx -= 1){
-        std::swap(new_tiles[idx], new_tiles[idx - 1]);
-      }
-
-      TilesNode15 *child_node = child(TilesState15(new_tiles), new_g, n, node_pool);
-      succs.push_back(child_node);
-    } /* end if */
+    if (gp == NULL || gp->get_state().get_blank() != new_blank)
+      succs.push_back(moved[col - j - 1], new_g, new_blank);
   } /* end for */
 
   // move the blank right
-  for (unsigned j = col + 1; j < 4; j += 1) {
-    const unsigned new_blank = row * 4 + j;
-    if (gp == NULL || gp->get_state().get_blank() != new_blank) {
-      TileArray new_tiles = n.get_state().get_tiles();
-      for(unsigned idx = blank; idx < new_blank; idx += 1){
-        std::swap(new_tiles[idx], new_tiles[idx + 1]);
-      }
-
-      TilesNode15 *child_node = child(TilesState15(new_tiles), new_g, n, node_pool);
-      succs.push_back(child_node);
-    } /* end if */
-  } /* end for */
+  {
+    TilesState15 new_state = n.get_state();
+    for (unsigned j = col + 1; j < 4; j += 1) {
+      new_state = new_state.move_blank_right();
+      const unsigned new_blank = row * 4 + j;
+      if (gp == NULL || gp->get_state().get_blank() != new_blank)
+        succs.push_back(new_state, new_g, new_blank);
+    } /* end for */
+  }
 
-  assert(succs.size() <= 6);
 #ifndef NDEBUG
   if (gp != NULL) {
     for (unsigned i = 0; i < succs.size(); i += 1) {
-      assert(succs[i]->get_state() != gp->get_state());
+      assert(succs[i].state != gp->get_state());
     }
   }
 #endif
 }
 
 
-void TilesInstance15::compute_macro_predecessors(const TilesNode15 &n,
-                                                 std::vector<TilesNode15 *> &succs,
-                                                 boost::pool<> &node_pool)
+template <class NodeT>
+void TilesInstance15::compute_macro_successors(const NodeT &n,
+                                               std::vector<NodeT *> &succs,
+                                               typename NodeT::Pool &node_pool)
+{
+  const TileIndex blank = n.get_state().get_blank();
+  make_children(n, macro_fsm, macro_moves[blank].data(),
+                macro_move_labels[blank].data(), macro_moves[blank].size(), 0,
+                succs, node_pool);
+}
+
+
+template <class NodeT>
+void
+TilesInstance15::compute_macro_predecessor_states(const NodeT &n,
+                                                  MacroSuccessors &succs) const
+{
+  compute_macro_successor_states(n, succs);
+}
+
+
+template <class NodeT>
+void TilesInstance15::compute_macro_predecessors(const NodeT &n,
+                                                 std::vector<NodeT *> &succs,
+                                                 typename NodeT::Pool &node_pool)
 {
   compute_macro_successors(n, succs, node_pool);
 }
@@ -262,11 +487,9 @@ TilesState15 TilesInstance15::abstract(unsigned level,
 
   TileArray new_tiles(s.get_tiles());
 
-  for (TileIndex i = 0; i < 4; i += 1)
-    for (TileIndex j = 0; j < 4; j += 1) {
-      if ( should_abstract(level, s(i, j)) )
-        new_tiles[i * 4 + j] = -1;
-    }
+  for (TileIndex i = 0; i < new_tiles.size(); i += 1)
+    if ( should_abstract(level, new_tiles[i]) )
+      new_tiles[i] = -1;
 
   return TilesState15(new_tiles);
 }
@@ -278,6 +501,42 @@ bool TilesInstance15::is_valid_level(const unsigned level)
 }
 
 
+PermutationRank TilesInstance15::num_ranks(unsigned level) const
+{
+  assert(valid_level(level));
+
+  unsigned num_symbols = 1;  // the blank
+  for (Tile t = 1; t < 16; t += 1)
+    if (!should_abstract(level, t))
+      num_symbols += 1;
+
+  return num_k_permutations(16, num_symbols);
+}
+
+
+TilesState15 TilesInstance15::unrank(unsigned level, PermutationRank r) const
+{
+  assert(r < num_ranks(level));
+
+  boost::array<Tile, 16> symbols;
+  unsigned num_symbols = 0;
+  symbols[num_symbols++] = 0;
+  for (Tile t = 1; t < 16; t += 1)
+    if (!should_abstract(level, t))
+      symbols[num_symbols++] = t;
+
+  boost::array<TileIndex, 16> places;
+  unrank_k_permutation(16, num_symbols, r, places);
+
+  TileArray tiles;
+  tiles.assign(-1);
+  for (unsigned j = 0; j < num_symbols; j += 1)
+    tiles[places[j]] = symbols[j];
+
+  return TilesState15(tiles);
+}
+
+
 
 std::ostream & operator <<(std::ostream &o, const TilesInstance15 &t)
 {
@@ -379,12 +638,11 @@ TilesInstance15 * readTilesInstance15 (std::istream &in)
     err = readTiles(in, goalTiles);
   }
 
-  if (!err) {
+  if (!err && TilesState15::valid(startTiles) && TilesState15::valid(goalTiles)) {
     TilesState15 start(startTiles);
     TilesState15 goal(goalTiles);
 
-    if (start.valid() && goal.valid())
-      return new TilesInstance15(start, goal);
+    return new TilesInstance15(start, goal);
   }
 
   return NULL;
@@ -492,3 +750,35 @@ bool TilesInstance15::valid_level(unsigned level)
 {
   return level <= num_abstraction_levels;
 }
+
+
+// The domain can be searched with either node layout.
+#define INSTANTIATE_TILES_INSTANCE15(NodeT)                             \
+  template void TilesInstance15::compute_successors<NodeT>(             \
+    const NodeT &, std::vector<NodeT *> &, NodeT::Pool &);              \
+  template void TilesInstance15::compute_predecessors<NodeT>(           \
+    const NodeT &, std::vector<NodeT *> &, NodeT::Pool &);              \
+  template void TilesInstance15::compute_macro_successors<NodeT>(       \
+    const NodeT &, std::vector<NodeT *> &, NodeT::Pool &);              \
+  template void TilesInstance15::compute_macro_predecessors<NodeT>(     \
+    const NodeT &, std::vector<NodeT *> &, NodeT::Pool &);              \
+  template void TilesInstance15::compute_glued_successors<NodeT>(       \
+    const NodeT &, std::vector<NodeT *> &, Tile, NodeT::Pool &);        \
+  template void TilesInstance15::compute_heuristic<NodeT>(              \
+    const NodeT &, NodeT &) const;                                      \
+  template void TilesInstance15::compute_heuristic<NodeT>(NodeT &) const; \
+  template void TilesInstance15::compute_start_heuristic<NodeT>(        \
+    NodeT &) const;                                                     \
+  template void TilesInstance15::compute_successor_states<NodeT>(       \
+    const NodeT &, Successors &) const;                                 \
+  template void TilesInstance15::compute_predecessor_states<NodeT>(     \
+    const NodeT &, Successors &) const;                                 \
+  template void TilesInstance15::compute_macro_successor_states<NodeT>( \
+    const NodeT &, MacroSuccessors &) const;                            \
+  template void TilesInstance15::compute_macro_predecessor_states<NodeT>( \
+    const NodeT &, MacroSuccessors &) const;                            \
+  template void TilesInstance15::compute_glued_successor_states<NodeT>( \
+    const NodeT &, Successors &, Tile) const;
+
+INSTANTIATE_TILES_INSTANCE15(TilesNode15)
+INSTANTIATE_TILES_INSTANCE15(CompactTilesNode15)
@@ -8,9 +8,12 @@
 #include <iostream>
 #include <vector>
 
+#include "search/MovePruningFSM.hpp"
+#include "search/SuccessorBuffer.hpp"
 #include "tiles/ManhattanDistance.hpp"
 #include "tiles/TilesState.hpp"
 #include "tiles/TilesNode.hpp"
+#include "util/PermutationRank.hpp"
 
 
 class TilesInstance15 : boost::noncopyable
@@ -18,6 +21,12 @@ class TilesInstance15 : boost::noncopyable
 public:
   static const unsigned num_abstraction_levels = 8;
 
+  //! The longest redundant sequences of unit and of macro moves that
+  //! are pruned.  Longer ones prune more, but make for automata with
+  //! more states, which take longer to build.
+  static const unsigned unit_redundancy_length = 8;
+  static const unsigned macro_redundancy_length = 5;
+
   typedef std::pair<Tile, TileCost> TileCostPair;
   /*! \brief An AbstractionOrder indicates which tiles should be obscured
       at each level in an abstraction hierarchy.
@@ -47,8 +56,22 @@ public:
    */
   static const AbstractionOrder static_abstraction_order;
 
+  // A state has at most 4 unit-move successors, and at most 6 macro
+  // move successors.
+  typedef SuccessorBuffer<TilesState15, TileCost, 4> Successors;
+  typedef SuccessorBuffer<TilesState15, TileCost, 6> MacroSuccessors;
+
   TilesInstance15 (const TilesState15 &start, const TilesState15 &goal);
 
+  /**
+   * An instance between the given states, sharing the move pruning
+   * machines that other has already learned, for searchers that split
+   * a problem into smaller ones (FrontierAStar).
+   */
+  TilesInstance15 (const TilesInstance15 &other,
+                   const TilesState15 &start,
+                   const TilesState15 &goal);
+
   void print(std::ostream &o) const;
 
   inline bool is_goal(const TilesState15 &s) const
@@ -61,15 +84,45 @@ public:
     return 1;
   }
 
+  /**
+   * Generates the successor states of the given node, with their g
+   * values, without allocating nodes for them.  The operator of each
+   * successor is the new position of the blank.
+   */
+  template <class NodeT>
+  void compute_successor_states(const NodeT &n, Successors &succs) const;
+
+  template <class NodeT>
+  void compute_predecessor_states(const NodeT &n, Successors &succs) const;
+
+  template <class NodeT>
+  void compute_macro_successor_states(const NodeT &n,
+                                      MacroSuccessors &succs) const;
+
+  template <class NodeT>
+  void compute_macro_predecessor_states(const NodeT &n,
+                                        MacroSuccessors &succs) const;
+
+  template <class NodeT>
+  void compute_glued_successor_states(const NodeT &n,
+                                      Successors &succs,
+                                      Tile glued) const;
+
   /**
    * Expands the given node into the given vector for successors.
    *
+   * The moves are pruned by the node's move state, as the in-place
+   * moves below are, so this is only for searches without duplicate
+   * detection (HIDAStar); the *_successor_states() functions only
+   * prune moving the blank back to the grandparent's position.
+   *
    * Note that this does not assign the h values for the successor
    * nodes: that must be done by the caller.
    */
-  void compute_successors(const TilesNode15 &n,
-                          std::vector<TilesNode15 *> &succs,
-                          boost::pool<> &node_pool);
+  template <class NodeT>
+  void compute_successors(const NodeT &n,
+                          std::vector<NodeT *> &succs,
+                          typename NodeT::Pool &node_pool);
 
   /**
    * Expands the given node into the given vector for predecessors.
@@ -81,32 +134,128 @@ public:
    * nodes: that must be done by the caller.
    *
    */
-  void compute_predecessors(const TilesNode15 &n,
-                            std::vector<TilesNode15 *> &succs,
-                            boost::pool<> &node_pool);
+  template <class NodeT>
+  void compute_predecessors(const NodeT &n,
+                            std::vector<NodeT *> &succs,
+                            typename NodeT::Pool &node_pool);
 
 
 
-  void compute_macro_successors(const TilesNode15 &n,
-                                std::vector<TilesNode15 *> &succs,
-                                boost::pool<> &node_pool);
+  template <class NodeT>
+  void compute_macro_successors(const NodeT &n,
+                                std::vector<NodeT *> &succs,
+                                typename NodeT::Pool &node_pool);
 
-  void compute_macro_predecessors(const TilesNode15 &n,
-                                  std::vector<TilesNode15 *> &succs,
-                                  boost::pool<> &node_pool);
+  template <class NodeT>
+  void compute_macro_predecessors(const NodeT &n,
+                                  std::vector<NodeT *> &succs,
+                                  typename NodeT::Pool &node_pool);
 
 
-  void compute_glued_successors(const TilesNode15 &n,
-				std::vector<TilesNode15 *> &succs,
+  template <class NodeT>
+  void compute_glued_successors(const NodeT &n,
+				std::vector<NodeT *> &succs,
 				Tile glued,
-				boost::pool<> &node_pool);
+				typename NodeT::Pool &node_pool);
   /**
    * Computes and assigns the heuristic for the given child node.
    */
-  void compute_heuristic(const TilesNode15 &parent,
-                         TilesNode15 &child) const;
+  template <class NodeT>
+  void compute_heuristic(const NodeT &parent,
+                         NodeT &child) const;
+
+  template <class NodeT>
+  void compute_heuristic(NodeT &child) const;
+
+  /**
+   * Computes and assigns a heuristic for the cost from the start state
+   * to the given node's state, for searching backward from the goal:
+   * the Manhattan distance to the start.
+   */
+  template <class NodeT>
+  void compute_start_heuristic(NodeT &child) const;
+
+  /*
+   * In-place moves, for searchers that keep a single state and change
+   * it (IDAStar).  A move is the new position of the blank, and the
+   * move that undoes it is the blank's old position.  The heuristic is
+   * Manhattan distance, updated by the moved tile's change.
+   *
+   * A MoveState is the state of a move-pruning automaton (see
+   * MovePruningFSM) after the moves made so far.  Unit moves are pruned
+   * by one that rejects the redundant sequences of up to
+   * unit_redundancy_length moves, macro moves by one for up to
+   * macro_redundancy_length moves, and glued moves only by one that
+   * rejects undoing the last move, as a shorter sequence may be
+   * blocked by the glued tile.
+   */
+  typedef TileIndex Move;
+  typedef MovePruningFSM::State MoveState;
+  typedef boost::array<Move, 4> Moves;
+  typedef boost::array<Move, 6> MacroMoves;
+  static const MoveState initial_move_state = MovePruningFSM::start_state;
+
+  unsigned compute_moves(const TilesState15 &s, MoveState ms, Moves &moves) const
+  {
+    const TileIndex blank = s.get_blank();
+    return filter_moves(unit_fsm, ms, unit_moves[blank].data(),
+                        unit_move_labels[blank].data(), num_unit_moves[blank],
+                        s, 0, moves.data());
+  }
+
+  MoveState next_move_state(const TilesState15 &s, MoveState ms, Move m) const
+  {
+    return unit_fsm.next(ms, unit_move_label(s.get_blank(), m));
+  }
+
+  unsigned compute_macro_moves(const TilesState15 &s,
+                               MoveState ms,
+                               MacroMoves &moves) const
+  {
+    const TileIndex blank = s.get_blank();
+    return filter_moves(macro_fsm, ms, macro_moves[blank].data(),
+                        macro_move_labels[blank].data(), macro_moves[blank].size(),
+                        s, 0, moves.data());
+  }
 
-  void compute_heuristic(TilesNode15 &child) const;
+  MoveState next_macro_move_state(const TilesState15 &s,
+                                  MoveState ms,
+                                  Move m) const
+  {
+    return macro_fsm.next(ms, macro_move_label(s.get_blank(), m));
+  }
+
+  unsigned compute_glued_moves(const TilesState15 &s,
+                               MoveState ms,
+                               Tile glued,
+                               Moves &moves) const
+  {
+    const TileIndex blank = s.get_blank();
+    return filter_moves(inverse_fsm, ms, unit_moves[blank].data(),
+                        unit_move_labels[blank].data(), num_unit_moves[blank],
+                        s, glued, moves.data());
+  }
+
+  MoveState next_glued_move_state(const TilesState15 &s,
+                                  MoveState ms,
+                                  Move m) const
+  {
+    return inverse_fsm.next(ms, unit_move_label(s.get_blank(), m));
+  }
+
+  Move apply_move(TilesState15 &s, Move m, TileCost &h) const
+  {
+    const TileIndex blank = s.get_blank();
+    const Tile tile = s.get_tile(m);
+    h = h + md_heur.lookup_dist(tile, blank) - md_heur.lookup_dist(tile, m);
+    s = s.move_blank_to(m);
+    return blank;
+  }
+
+  void undo_move(TilesState15 &s, Move undo) const
+  {
+    s = s.move_blank_to(undo);
+  }
 
   const TilesState15 & get_start_state() const;
 
@@ -119,13 +268,46 @@ public:
   static bool is_valid_level(const unsigned level);
 
 
+  /*! \brief The number of distinct states at the given level, when
+      ranked by rank().
+
+      A state at a level is a placement of the blank and the level's
+      unobscured tiles on the board, so these are ranked as
+      k-permutations of the 16 positions.
+   */
+  PermutationRank num_ranks(unsigned level) const;
+
+  /*! \brief Maps a state at the given level to a unique integer in
+      [0, num_ranks(level)).
+   */
+  PermutationRank rank(unsigned level, const TilesState15 &s) const
+  {
+    // The symbols are the blank followed by the unobscured tiles in
+    // increasing order.  Every state at a level has the same unobscured
+    // tiles, so they can be read off the state itself.
+    boost::array<TileIndex, 16> positions;
+    const unsigned present = s.get_tile_positions(positions);
+
+    boost::array<TileIndex, 16> places;
+    unsigned num_symbols = 0;
+    for (unsigned t = 0; t < 16; t += 1)
+      if (present & (1u << t))
+        places[num_symbols++] = positions[t];
+
+    return rank_k_permutation(16, num_symbols, places);
+  }
+
+  //! The inverse of rank().
+  TilesState15 unrank(unsigned level, PermutationRank r) const;
+
+
   // Set the abstraction order
   void set_abstraction_order(const AbstractionOrder ord) {
     abstraction_order = ord;
   }
 
   // Get the Manhattan distance heuristic.
-  const ManhattanDist15 get_md(void) {
+  const ManhattanDist15 & get_md(void) const {
     return md_heur;
   }
 
@@ -137,23 +319,98 @@ public:
   void dump_abstraction_order(std::ostream &o) const;
 
 private:
-  TilesNode15 * child(const TilesState15 &new_state,
-                      TileCost new_g,
-                      const TilesNode15 &parent,
-                      boost::pool<> &node_pool);
+  /*
+   * The move-pruning automata's labels for moving the blank from one
+   * position to another.  Unit moves left, right, up and down are 0 to
+   * 3.  Macro moves along the column are 0 to 5, by increasing
+   * displacement, and those along the row are 6 to 11.  Both are in
+   * the order in which the moves are generated, which the automata
+   * rely on.
+   */
+  static unsigned unit_move_label(TileIndex from, TileIndex to)
+  {
+    return to + 1 == from ? 0 : to == from + 1 ? 1 : to + 4 == from ? 2 : 3;
+  }
+
+  static unsigned macro_move_label(TileIndex from, TileIndex to)
+  {
+    if (from % 4 == to % 4) {
+      const int d = to / 4 - from / 4;
+      return d < 0 ? d + 3 : d + 2;
+    }
+    const int d = to % 4 - from % 4;
+    return 6 + (d < 0 ? d + 3 : d + 2);
+  }
+
+  // Moves the blank of s by the move with the given label, returning
+  // false if that would take it off the board.
+  static bool move_by_label(bool macro, unsigned label, TilesState15 &s);
+
+  // Finds the redundant sequences of up to max_length unit or macro
+  // moves, for a MovePruningFSM.
+  static std::vector<MovePruningFSM::Sequence>
+  find_redundant_sequences(bool macro, unsigned max_length);
+
+  // Copies to moves those of the given moves of the blank that the
+  // automaton does not prune after ms, and that do not move the glued
+  // tile (0, the blank, for none), returning their number.
+  unsigned filter_moves(const MovePruningFSM &fsm,
+                        MoveState ms,
+                        const TileIndex *targets,
+                        const unsigned char *labels,
+                        unsigned num_targets,
+                        const TilesState15 &s,
+                        Tile glued,
+                        Move *moves) const
+  {
+    unsigned n = 0;
+    for (unsigned i = 0; i < num_targets; i += 1)
+      if (fsm.next(ms, labels[i]) != MovePruningFSM::pruned
+          && (glued == 0 || s.get_tile(targets[i]) != glued))
+        moves[n++] = targets[i];
+    return n;
+  }
+
+  // Makes a node for each move that filter_moves() keeps, with the
+  // automaton's state after it.
+  template <class NodeT>
+  void make_children(const NodeT &parent,
+                     const MovePruningFSM &fsm,
+                     const TileIndex *targets,
+                     const unsigned char *labels,
+                     unsigned num_targets,
+                     Tile glued,
+                     std::vector<NodeT *> &succs,
+                     typename NodeT::Pool &node_pool) const;
 
   AbstractionOrder get_custom_abstraction(const TilesState15 &s,
                                           const ManhattanDist15 &md) const;
 
   static bool valid_level(unsigned level);
 
+  void init_move_tables();
+
 
 private:
   const TilesState15 start;
   const TilesState15 goal;
 
   const ManhattanDist15 md_heur;
+  const ManhattanDist15 start_md;
   AbstractionOrder abstraction_order;
+
+  // The positions the blank can move to from each position, by unit
+  // moves (in the order that compute_successor_states() uses) and by
+  // macro moves, with the moves' labels.
+  boost::array<boost::array<TileIndex, 4>, 16> unit_moves;
+  boost::array<boost::array<unsigned char, 4>, 16> unit_move_labels;
+  boost::array<unsigned, 16> num_unit_moves;
+  boost::array<boost::array<TileIndex, 6>, 16> macro_moves;
+  boost::array<boost::array<unsigned char, 6>, 16> macro_move_labels;
+
+  const MovePruningFSM unit_fsm;
+  const MovePruningFSM macro_fsm;
+  const MovePruningFSM inverse_fsm;
 };
 
 
@@ -2,12 +2,14 @@
 #define _TILES_NODE_HPP_
 
 
+#include "search/CompactNode.hpp"
 #include "search/Node.hpp"
 #include "tiles/TilesTypes.hpp"
 #include "tiles/TilesState.hpp"
 
 
 typedef Node<TilesState15, TileCost> TilesNode15;
+typedef CompactNode<TilesState15, TileCost> CompactTilesNode15;
 
 
 #endif /* !_TILES_NODE_HPP_ */
@@ -22,28 +22,30 @@ std::ostream & operator <<(std::ostream &o, const TilesState15 &tiles)
 
 bool TilesState15::valid() const
 {
-  bool hasBlank = false;
-
-  for (unsigned i = 0; i < 4; ++i) {
-    for (unsigned j = 0; j < 4; ++j) {
-      if ((*this)(i, j) == 0)
-        hasBlank = true;
-      if ( !valid_tile((*this)(i, j)) ) 
-        return false;
-    }
+  return valid(get_tiles());
+}
+
+
+bool TilesState15::valid(const TileArray &tiles)
+{
+  unsigned num_blanks = 0;
+
+  for (unsigned i = 0; i < tiles.size(); ++i) {
+    if (tiles[i] == 0)
+      ++num_blanks;
+    if ( !valid_tile(tiles[i]) )
+      return false;
   }
 
   for (Tile t = 1; t < 16; ++t) {
     unsigned t_count = 0;
-    for (unsigned i = 0; i < 4; ++i) {
-      for (unsigned j = 0; j < 4; ++j) {
-        if ((*this)(i, j) == t)
-          ++t_count;
-      }
+    for (unsigned i = 0; i < tiles.size(); ++i) {
+      if (tiles[i] == t)
+        ++t_count;
     }
 
     if (t_count > 1) return false;
   }
 
-  return hasBlank;
+  return num_blanks == 1;
 }
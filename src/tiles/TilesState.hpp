@@ -2,6 +2,8 @@
 #define _TILES_STATE_HPP_
 
 
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/functional/hash.hpp>
 
 #include <cassert>
@@ -10,40 +12,38 @@
 #include "TilesTypes.hpp"
 
 
+/*! \brief A fifteen puzzle state, packed into a single 64-bit word.
+
+    The low 4 bits of the word hold the index of the blank.  The
+    remaining 60 bits hold the 15 non-blank positions of the board in
+    order, 4 bits apiece: position `pos` is kept in slot `pos` if it
+    comes before the blank, and in slot `pos - 1` otherwise.  A slot
+    value of 0 denotes an obscured tile (-1).
+
+    Since the blank never occupies a slot, moving the blank left or
+    right only changes the blank index, and moving it up or down
+    rotates a single 16-bit field of the word.  Equality is a single
+    word compare.
+ */
 class TilesState15
 {
 private:
-  TileArray tiles;
-#ifdef CACHE_TILES_HASH_VALUE
-  std::size_t hash_value;
-#endif
-#ifdef CACHE_TILES_BLANK_INDEX
-  TileIndex blank_index;
-#endif
+  typedef boost::uint64_t PackedTiles;
+
+  PackedTiles packed;
 
 
 public:
   TilesState15()
+    : packed(0)
   {
-    for (TileIndex t = 0; t < 16; t += 1)
-      tiles[t] = t;
-
-#ifdef CACHE_TILES_HASH_VALUE
-    hash_value = compute_hash(tiles);
-#endif
-#ifdef CACHE_TILES_BLANK_INDEX
-    blank_index = 0;
-#endif
+    for (TileIndex t = 1; t < 16; t += 1)
+      packed |= static_cast<PackedTiles>(t) << slot_shift(t - 1);
+    assert(get_blank() == 0);
   }
 
   TilesState15(const TileArray &tiles)
-    : tiles(tiles)
-#ifdef CACHE_TILES_HASH_VALUE
-    , hash_value(compute_hash(tiles))
-#endif
-#ifdef CACHE_TILES_BLANK_INDEX
-    , blank_index(find_blank_index(tiles))
-#endif
+    : packed(pack(tiles))
   {
     assert(tiles[get_blank()] == 0);
   }
@@ -52,19 +52,23 @@ public:
   {
     assert(i < 4);
     assert(j < 4);
-    return tiles[i * 4 + j];
+    return get_tile(i * 4 + j);
+  }
+
+  inline Tile get_tile(TileIndex pos) const
+  {
+    assert(valid_tile_index(pos));
+    const TileIndex blank = get_blank();
+    if (pos == blank)
+      return 0;
+
+    const unsigned nibble = get_slot(pos < blank ? pos : pos - 1);
+    return nibble == 0 ? -1 : static_cast<Tile>(nibble);
   }
 
   inline bool operator ==(const TilesState15 &other) const
   {
-    return
-#ifdef CACHE_TILES_HASH_VALUE
-      hash_value == other.hash_value &&
-#endif
-#ifdef CACHE_TILES_BLANK_INDEX
-      blank_index == other.blank_index &&
-#endif
-      tiles == other.tiles;
+    return packed == other.packed;
   }
 
   inline bool operator !=(const TilesState15 &other) const
@@ -74,11 +78,7 @@ public:
 
   inline TileIndex get_blank() const
   {
-#ifdef CACHE_TILES_BLANK_INDEX
-    return blank_index;
-#else
-    return find_blank_index(tiles);
-#endif
+    return packed & 0xF;
   }
 
   inline TileIndex get_blank_row() const
@@ -91,104 +91,181 @@ public:
     return get_blank() % 4;
   }
 
-  inline const TileArray & get_tiles() const
+  /*! \brief Finds the position of every tile that is not obscured.
+
+      Sets positions[t] for each unobscured tile t, the blank included,
+      and returns the set of those tiles as a bitmask over tile numbers.
+   */
+  inline unsigned get_tile_positions(boost::array<TileIndex, 16> &positions) const
+  {
+    const TileIndex blank = get_blank();
+    positions[0] = blank;
+    unsigned present = 1;
+
+    PackedTiles slots = packed >> 4;
+    for (TileIndex slot = 0; slot < 15; slot += 1, slots >>= 4) {
+      const unsigned tile = slots & 0xF;
+      if (tile != 0) {
+        positions[tile] = slot < blank ? slot : slot + 1;
+        present |= 1u << tile;
+      }
+    }
+
+    return present;
+  }
+
+  // The packed word itself, laid out as described above, for code
+  // that decodes many tiles at once.
+  inline boost::uint64_t get_packed() const
   {
+    return packed;
+  }
+
+  // Unpacks the board.  Prefer get_tile() for single lookups.
+  TileArray get_tiles() const
+  {
+    TileArray tiles;
+    for (TileIndex i = 0; i < tiles.size(); i += 1)
+      tiles[i] = get_tile(i);
     return tiles;
   }
 
   inline size_t get_hash_value() const
   {
-#ifdef CACHE_TILES_HASH_VALUE
-    return hash_value;
-#else
-    return compute_hash(tiles);
-#endif
+    // A single multiply mixes the tile bits into the high half of the
+    // product; fold them back down so that power-of-two tables work.
+    const PackedTiles h = packed * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
   }
 
   // Get the tile above the blank.
   Tile get_up_tile() const
   {
     assert(get_blank_row() > 0);
-    return get_tile_rel_blank(-4);
+    return get_tile(get_blank() - 4);
   }
 
   // Get the tile below the blank.
   Tile get_down_tile() const
   {
     assert(get_blank_row() < 3);
-    return get_tile_rel_blank(4);
+    return get_tile(get_blank() + 4);
   }
 
   // Get the tile left of the blank.
   Tile get_left_tile() const
   {
     assert(get_blank_col() > 0);
-    return get_tile_rel_blank(-1);
+    return get_tile(get_blank() - 1);
   }
 
   // Get the tile right of the blank.
   Tile get_right_tile() const
   {
     assert(get_blank_col() < 3);
-    return get_tile_rel_blank(1);
+    return get_tile(get_blank() + 1);
   }
 
 
   TilesState15 move_blank_up() const
   {
     assert(get_blank_row() > 0);
-    return move_blank(-4);
+    // The tile above the blank moves past the three tiles between it
+    // and the blank: rotate slots [blank - 4, blank - 1] down by one.
+    const TileIndex new_blank = get_blank() - 4;
+    const unsigned shift = slot_shift(new_blank);
+    const PackedTiles field = (packed >> shift) & 0xFFFF;
+    const PackedTiles rotated = (field >> 4) | ((field & 0xF) << 12);
+    return TilesState15(replace_field(shift, rotated), new_blank);
   }
 
   TilesState15 move_blank_down() const
   {
     assert(get_blank_row() < 3);
-    return move_blank(4);
+    // Inverse of move_blank_up: rotate slots [blank, blank + 3] up by
+    // one.
+    const TileIndex blank = get_blank();
+    const unsigned shift = slot_shift(blank);
+    const PackedTiles field = (packed >> shift) & 0xFFFF;
+    const PackedTiles rotated = ((field << 4) & 0xFFFF) | (field >> 12);
+    return TilesState15(replace_field(shift, rotated), blank + 4);
   }
 
   TilesState15 move_blank_left() const
   {
     assert(get_blank_col() > 0);
-    return move_blank(-1);
+    return TilesState15(packed, get_blank() - 1);
   }
 
   TilesState15 move_blank_right() const
   {
     assert(get_blank_col() < 3);
-    return move_blank(1);
+    return TilesState15(packed, get_blank() + 1);
+  }
+
+  /*! \brief Moves the blank to a position in its row or column,
+      sliding the tiles in between.
+   */
+  TilesState15 move_blank_to(TileIndex pos) const
+  {
+    assert(valid_tile_index(pos));
+    assert(pos / 4 == get_blank_row() || pos % 4 == get_blank_col());
+
+    // Along a row, every tile keeps its slot.
+    if (pos / 4 == get_blank_row())
+      return TilesState15(packed, pos);
+
+    TilesState15 s = *this;
+    while (s.get_blank() > pos)
+      s = s.move_blank_up();
+    while (s.get_blank() < pos)
+      s = s.move_blank_down();
+    return s;
   }
 
   bool valid() const;
 
+  static bool valid(const TileArray &tiles);
+
 
 private:
-  // Get the tile with the relative position to the blank.
-  inline Tile get_tile_rel_blank(TileIndex offset) const
+  TilesState15(PackedTiles tiles, TileIndex blank)
+    : packed((tiles & ~static_cast<PackedTiles>(0xF)) | blank)
+  {
+    assert(valid_tile_index(blank));
+  }
+
+  static inline unsigned slot_shift(unsigned slot)
   {
-    TileIndex blank_index = get_blank();
-    TileIndex tile_index = blank_index + offset;
-    return tiles[tile_index];
+    assert(slot < 15);
+    return 4 + 4 * slot;
   }
 
-  inline TilesState15 move_blank(TileIndex new_blank_offset) const
+  inline unsigned get_slot(unsigned slot) const
   {
-    TileIndex blank_index = get_blank();
-    TileIndex new_blank_index = blank_index + new_blank_offset;
-    TilesState15 new_state(*this);
-    std::swap(new_state.tiles[blank_index], new_state.tiles[new_blank_index]);
-#ifdef CACHE_TILES_HASH_VALUE
-    new_state.hash_value = compute_hash(new_state.tiles);
-#endif
-#ifdef CACHE_TILES_BLANK_INDEX
-    new_state.blank_index = find_blank_index(new_state.tiles);
-#endif
+    return (packed >> slot_shift(slot)) & 0xF;
+  }
 
-    return new_state;
+  inline PackedTiles replace_field(unsigned shift, PackedTiles field) const
+  {
+    const PackedTiles mask = static_cast<PackedTiles>(0xFFFF) << shift;
+    return (packed & ~mask) | (field << shift);
   }
 
-  static std::size_t compute_hash(const TileArray &tiles)
+  static PackedTiles pack(const TileArray &tiles)
   {
-    return boost::hash_range(tiles.begin(), tiles.end());
+    const TileIndex blank = find_blank_index(tiles);
+    PackedTiles p = blank;
+
+    for (TileIndex i = 0; i < tiles.size(); i += 1) {
+      if (i == blank)
+        continue;
+      assert(valid_tile(tiles[i]) && tiles[i] != 0);
+      const PackedTiles nibble = tiles[i] == -1 ? 0 : tiles[i];
+      p |= nibble << slot_shift(i < blank ? i : i - 1);
+    }
+
+    return p;
   }
 
   static TileIndex find_blank_index(const TileArray &tiles)
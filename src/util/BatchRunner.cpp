@@ -0,0 +1,470 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "util/BatchRunner.hpp"
+
+
+namespace
+{
+  double wall_seconds()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+
+  // Compares names with runs of digits taken as numbers.
+  bool natural_less(const std::string &a, const std::string &b)
+  {
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+      if (isdigit(a[i]) && isdigit(b[j])) {
+        std::size_t a_end = i;
+        std::size_t b_end = j;
+        while (a_end < a.size() && isdigit(a[a_end]))
+          a_end += 1;
+        while (b_end < b.size() && isdigit(b[b_end]))
+          b_end += 1;
+        while (i + 1 < a_end && a[i] == '0')
+          i += 1;
+        while (j + 1 < b_end && b[j] == '0')
+          j += 1;
+
+        if (a_end - i != b_end - j)
+          return a_end - i < b_end - j;
+        const int cmp = a.compare(i, a_end - i, b, j, b_end - j);
+        if (cmp != 0)
+          return cmp < 0;
+        i = a_end;
+        j = b_end;
+      }
+      else {
+        if (a[i] != b[j])
+          return a[i] < b[j];
+        i += 1;
+        j += 1;
+      }
+    }
+    return a.size() - i < b.size() - j;
+  }
+
+  void write_all(int fd, const std::string &s)
+  {
+    std::size_t written = 0;
+    while (written < s.size()) {
+      const ssize_t n = write(fd, s.data() + written, s.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return;
+      written += n;
+    }
+  }
+}
+
+
+BatchRunner::BatchRunner(const std::vector<std::string> &command,
+                         unsigned num_workers,
+                         double time_limit,
+                         unsigned long memory_limit_mb)
+  : command(command)
+  , num_workers(num_workers > 0 ? num_workers : 1)
+  , time_limit(time_limit)
+  , memory_limit_mb(memory_limit_mb)
+  , format(SearchStatistics::text_format)
+  , record_base()
+  , paths(NULL)
+  , next_path(0)
+  , csv_header()
+  , pending_records()
+{
+  pthread_mutex_init(&lock, NULL);
+  pthread_mutex_init(&fork_lock, NULL);
+  std::fill(status_counts, status_counts + num_statuses, 0);
+}
+
+
+BatchRunner::~BatchRunner()
+{
+  pthread_mutex_destroy(&fork_lock);
+  pthread_mutex_destroy(&lock);
+}
+
+
+bool BatchRunner::list_instances(const std::vector<std::string> &args,
+                                 std::vector<std::string> &paths,
+                                 std::ostream &err)
+{
+  for (unsigned i = 0; i < args.size(); i += 1) {
+    struct stat st;
+    if (stat(args[i].c_str(), &st) != 0) {
+      err << "error: " << args[i] << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+      paths.push_back(args[i]);
+      continue;
+    }
+
+    DIR *dir = opendir(args[i].c_str());
+    if (dir == NULL) {
+      err << "error: " << args[i] << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    std::vector<std::string> names;
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+      const std::string name(entry->d_name);
+      if (name.empty() || name[0] == '.')
+        continue;
+      struct stat entry_st;
+      const std::string path = args[i] + "/" + name;
+      if (stat(path.c_str(), &entry_st) == 0 && S_ISREG(entry_st.st_mode))
+        names.push_back(name);
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end(), natural_less);
+    for (unsigned j = 0; j < names.size(); j += 1)
+      paths.push_back(args[i] + "/" + names[j]);
+  }
+
+  return true;
+}
+
+
+void BatchRunner::set_record_format(SearchStatistics::Format record_format,
+                                    const SearchStatistics &base)
+{
+  format = record_format;
+  record_base = base;
+}
+
+
+unsigned BatchRunner::run(const std::vector<std::string> &instance_paths)
+{
+  paths = &instance_paths;
+  next_path = 0;
+  std::fill(status_counts, status_counts + num_statuses, 0);
+
+  // Reports are written straight to the file descriptor, so anything
+  // buffered must go first.
+  std::cout.flush();
+  std::cerr.flush();
+
+  // The calling thread is one of the workers.  If a thread cannot be
+  // created, the batch runs on fewer workers.
+  std::vector<pthread_t> threads;
+  for (unsigned i = 1; i < num_workers && i < paths->size(); i += 1) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_main, this) != 0)
+      break;
+    threads.push_back(thread);
+  }
+
+  run_worker();
+
+  for (unsigned i = 0; i < threads.size(); i += 1)
+    pthread_join(threads[i], NULL);
+  flush_pending_records();
+
+  paths = NULL;
+  return status_counts[failed] + status_counts[timed_out]
+    + status_counts[out_of_memory] + status_counts[budget_exhausted];
+}
+
+
+void BatchRunner::output_statistics(std::ostream &o) const
+{
+  unsigned total = 0;
+  for (unsigned s = 0; s < num_statuses; s += 1)
+    total += status_counts[s];
+
+  o << "######## Batch Summary ########" << std::endl
+    << total << " instances with " << num_workers << " workers" << std::endl;
+  for (unsigned s = 0; s < num_statuses; s += 1)
+    o << status_counts[s] << " " << status_name(static_cast<Status>(s)) << std::endl;
+}
+
+
+const char * BatchRunner::status_name(Status status)
+{
+  switch (status) {
+  case done:
+    return "done";
+  case failed:
+    return "failed";
+  case timed_out:
+    return "time limit";
+  case out_of_memory:
+    return "memory limit";
+  case budget_exhausted:
+    return "budget exhausted";
+  default:
+    return "unknown";
+  }
+}
+
+
+void * BatchRunner::worker_main(void *arg)
+{
+  static_cast<BatchRunner *>(arg)->run_worker();
+  return NULL;
+}
+
+
+void BatchRunner::run_worker()
+{
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    const unsigned i = next_path;
+    if (i < paths->size())
+      next_path += 1;
+    pthread_mutex_unlock(&lock);
+
+    if (i >= paths->size())
+      return;
+
+    std::string output;
+    double seconds = 0;
+    const Status status = run_instance((*paths)[i], output, seconds);
+    report((*paths)[i], output, status, seconds);
+  }
+}
+
+
+BatchRunner::Status BatchRunner::run_instance(const std::string &path,
+                                              std::string &output,
+                                              double &seconds)
+{
+  const double start = wall_seconds();
+
+  // Everything the child needs is made before the fork.
+  std::vector<char *> argv;
+  for (unsigned i = 0; i < command.size(); i += 1)
+    argv.push_back(const_cast<char *>(command[i].c_str()));
+  argv.push_back(const_cast<char *>(path.c_str()));
+  argv.push_back(NULL);
+  const std::string exec_error = "error: cannot run " + command[0] + "\n";
+
+  // The write end of the pipe must not leak into another worker's
+  // child, or the pipe would not see end of file until that child
+  // exits, so it is only open in this thread while fork_lock is held.
+  pthread_mutex_lock(&fork_lock);
+  int fds[2];
+  if (pipe(fds) != 0) {
+    pthread_mutex_unlock(&fork_lock);
+    output = std::string("error: pipe: ") + strerror(errno) + "\n";
+    return failed;
+  }
+  // The read end stays open in this thread, so it must not go to
+  // another worker's solver.
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+  const pid_t pid = fork();
+  if (pid == -1) {
+    close(fds[0]);
+    close(fds[1]);
+    pthread_mutex_unlock(&fork_lock);
+    output = std::string("error: fork: ") + strerror(errno) + "\n";
+    return failed;
+  }
+
+  if (pid == 0) {
+    // Only system calls from here on.
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    // Only records are wanted on standard output, so diagnostics go
+    // straight to the terminal when writing them.
+    if (format == SearchStatistics::text_format)
+      dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+
+    if (memory_limit_mb > 0) {
+      struct rlimit limit;
+      limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(memory_limit_mb) << 20;
+      setrlimit(RLIMIT_AS, &limit);
+    }
+
+    execv(argv[0], &argv[0]);
+    while (write(STDERR_FILENO, exec_error.data(), exec_error.size()) < 0
+           && errno == EINTR)
+      ;
+    _exit(127);
+  }
+
+  close(fds[1]);
+  pthread_mutex_unlock(&fork_lock);
+
+  bool killed = false;
+  char buf[4096];
+  for (;;) {
+    int timeout_ms = -1;
+    if (time_limit > 0 && !killed) {
+      const double remaining = start + time_limit - wall_seconds();
+      timeout_ms = remaining > 0 ? static_cast<int>(remaining * 1000) + 1 : 0;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fds[0];
+    pfd.events = POLLIN;
+    const int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0 && errno == EINTR)
+      continue;
+
+    if (ready == 0) {
+      kill(pid, SIGKILL);
+      killed = true;
+      continue;
+    }
+
+    const ssize_t n = read(fds[0], buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    output.append(buf, n);
+  }
+  close(fds[0]);
+
+  int wait_status = 0;
+  while (waitpid(pid, &wait_status, 0) == -1 && errno == EINTR)
+    ;
+  seconds = wall_seconds() - start;
+
+  if (killed)
+    return timed_out;
+  if (WIFEXITED(wait_status)) {
+    if (WEXITSTATUS(wait_status) == 0)
+      return done;
+    if (WEXITSTATUS(wait_status) == out_of_memory_status)
+      return out_of_memory;
+    if (WEXITSTATUS(wait_status) == budget_exhausted_status)
+      return budget_exhausted;
+
+    std::ostringstream msg;
+    msg << "exit status " << WEXITSTATUS(wait_status) << std::endl;
+    output += msg.str();
+    return failed;
+  }
+  if (WIFSIGNALED(wait_status)) {
+    std::ostringstream msg;
+    msg << "killed by signal " << WTERMSIG(wait_status) << std::endl;
+    output += msg.str();
+  }
+  return failed;
+}
+
+
+void BatchRunner::report(const std::string &path,
+                         const std::string &output,
+                         Status status,
+                         double seconds)
+{
+  pthread_mutex_lock(&lock);
+  status_counts[status] += 1;
+
+  if (format == SearchStatistics::text_format) {
+    std::ostringstream o;
+    o << "######## Instance " << path << " ########" << std::endl
+      << output;
+    if (!output.empty() && output[output.size() - 1] != '\n')
+      o << std::endl;
+    o << "######## Batch Status ########" << std::endl
+      << "status: " << status_name(status) << std::endl
+      << "wall time: " << seconds << " s" << std::endl
+      << std::endl;
+    write_all(STDOUT_FILENO, o.str());
+  }
+  else if (status == done || status == budget_exhausted) {
+    report_record(output);
+  }
+  else {
+    // The child's own output, if any, is not a record.
+    if (!output.empty())
+      write_all(STDERR_FILENO, path + ": " + status_name(status) + "\n" + output);
+
+    SearchStatistics record(record_base);
+    record.set_string("instance", path);
+    record.set_string("status", status_name(status));
+    record.set_real("wall_time", seconds);
+    report_record(record);
+  }
+
+  pthread_mutex_unlock(&lock);
+}
+
+
+void BatchRunner::report_record(const std::string &output)
+{
+  if (format == SearchStatistics::json_format) {
+    write_all(STDOUT_FILENO, output);
+    return;
+  }
+
+  // A CSV record is a header line and a row.  The header is written
+  // once, unless the columns change.
+  const std::string::size_type header_end = output.find('\n');
+  const std::string header = output.substr(0, header_end);
+  const std::string row =
+    header_end == std::string::npos ? "" : output.substr(header_end + 1);
+  if (header != csv_header) {
+    csv_header = header;
+    write_all(STDOUT_FILENO, header + "\n");
+  }
+  write_all(STDOUT_FILENO, row);
+
+  for (unsigned i = 0; i < pending_records.size(); i += 1)
+    report_record(pending_records[i]);
+  pending_records.clear();
+}
+
+
+void BatchRunner::report_record(const SearchStatistics &record)
+{
+  std::ostringstream o;
+  if (format == SearchStatistics::json_format) {
+    record.write_json(o);
+  }
+  else if (!csv_header.empty()) {
+    record.write_csv_row(o, csv_header);
+  }
+  else {
+    // The columns are not known until an instance is solved.
+    pending_records.push_back(record);
+    return;
+  }
+  write_all(STDOUT_FILENO, o.str());
+}
+
+
+void BatchRunner::flush_pending_records()
+{
+  if (pending_records.empty())
+    return;
+
+  std::ostringstream o;
+  pending_records[0].write_csv_header(o);
+  csv_header = o.str().substr(0, o.str().size() - 1);
+  write_all(STDOUT_FILENO, o.str());
+
+  std::vector<SearchStatistics> records;
+  records.swap(pending_records);
+  for (unsigned i = 0; i < records.size(); i += 1)
+    report_record(records[i]);
+}
@@ -0,0 +1,146 @@
+#ifndef _BATCH_RUNNER_HPP_
+#define _BATCH_RUNNER_HPP_
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include <boost/utility.hpp>
+
+#include "search/SearchStatistics.hpp"
+
+
+/*! \brief Solves a batch of instances concurrently, each with its own
+    time and memory limit.
+
+    A fixed number of worker threads take instances from the batch in
+    order.  Each instance is solved by a new run of the solver program,
+    in a child process forked by its worker, so that a memory limit (an
+    RLIMIT_AS, like `ulimit -v') can be applied to it alone, and so that
+    an instance that runs out of time can be killed without disturbing
+    the others.  The child writes its usual output to a pipe, which the
+    worker collects.
+
+    The child execs the solver straight after the fork, doing nothing
+    in between that could take a lock: with the other workers running,
+    a lock (in malloc, say) may be held by a thread that does not exist
+    in the child, and would never be released.
+
+    The report for each instance is written to standard output as soon
+    as the instance finishes, in one piece, so the reports of
+    concurrent instances are never interleaved.
+
+    When the solver writes statistics records (JSON lines, or a CSV
+    header and row) rather than text, the batch output is just those
+    records, with one CSV header.  Instances that do not finish get a
+    record with their status in its place, except those whose search
+    ran out of its budget, which write their own record.
+*/
+class BatchRunner : boost::noncopyable
+{
+public:
+  //! The exit status of a child that ran out of memory.
+  static const int out_of_memory_status = 3;
+  /*! The exit status of a solver whose search ran out of its budget.
+      Its output is the usual results, with the statistics so far.
+   */
+  static const int budget_exhausted_status = 4;
+
+  /*! \param command          The solver program and its arguments, to
+                              which the path of an instance is added.
+                              It writes its results to standard output,
+                              and exits with the status of the instance.
+      \param num_workers      The number of instances solved at once
+      \param time_limit       The wall time allowed each instance, in
+                              seconds, or 0 for no limit
+      \param memory_limit_mb  The address space allowed each instance,
+                              in megabytes, or 0 for no limit
+   */
+  BatchRunner(const std::vector<std::string> &command,
+              unsigned num_workers,
+              double time_limit,
+              unsigned long memory_limit_mb);
+
+  ~BatchRunner();
+
+  /*! \brief Makes the batch output statistics records in the given
+      format, which the solver must also write.
+
+      Records for instances that do not finish are made from the given
+      base record, plus the instance, its status, and its wall time.
+   */
+  void set_record_format(SearchStatistics::Format format,
+                         const SearchStatistics &base);
+
+  /*! \brief Expands the given paths into a list of instance files.
+
+      Directories are replaced by the files in them, in natural order
+      (so that korf100/9 comes before korf100/10).  Returns false,
+      after writing a message to err, if a path does not exist.
+   */
+  static bool list_instances(const std::vector<std::string> &args,
+                             std::vector<std::string> &paths,
+                             std::ostream &err);
+
+  /*! \brief Solves the instances in the given files.
+
+      Returns the number of instances that did not finish normally.
+   */
+  unsigned run(const std::vector<std::string> &paths);
+
+  void output_statistics(std::ostream &o) const;
+
+
+private:
+  enum Status {
+    done,
+    failed,
+    timed_out,
+    out_of_memory,
+    budget_exhausted,
+    num_statuses
+  };
+
+  static const char * status_name(Status status);
+
+  static void * worker_main(void *arg);
+  void run_worker();
+  Status run_instance(const std::string &path,
+                      std::string &output,
+                      double &seconds);
+  void report(const std::string &path,
+              const std::string &output,
+              Status status,
+              double seconds);
+  void report_record(const std::string &output);
+  void report_record(const SearchStatistics &record);
+  void flush_pending_records();
+
+  const std::vector<std::string> command;
+  const unsigned num_workers;
+  const double time_limit;
+  const unsigned long memory_limit_mb;
+
+  SearchStatistics::Format format;
+  SearchStatistics record_base;
+
+  // Guards the fields up to fork_lock, and standard output while the
+  // batch runs.
+  pthread_mutex_t lock;
+  const std::vector<std::string> *paths;
+  unsigned next_path;
+  unsigned status_counts[num_statuses];
+  // The last CSV header written, and the records waiting for one.
+  std::string csv_header;
+  std::vector<SearchStatistics> pending_records;
+
+  // Held from the creation of a child's pipe until the parent has
+  // closed the pipe's write end.
+  pthread_mutex_t fork_lock;
+};
+
+
+#endif /* !_BATCH_RUNNER_HPP_ */
@@ -0,0 +1,103 @@
+#ifndef _PERMUTATION_RANK_HPP_
+#define _PERMUTATION_RANK_HPP_
+
+
+#include <algorithm>
+#include <cassert>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+
+/*
+ * Perfect ranking of k-permutations of {0, ..., n - 1}, i.e. of
+ * placements of k distinct symbols into n distinct places.  This is
+ * the linear-time ranking of Myrvold and Ruskey, stopped after its
+ * first k steps.
+ *
+ * A k-permutation is given as an array `places`, where places[j] is the
+ * place of symbol j.  Ranks lie in [0, n! / (n - k)!).
+ */
+
+
+const unsigned MAX_RANKED_PERMUTATION_SIZE = 16;
+
+typedef boost::uint64_t PermutationRank;
+
+
+inline PermutationRank num_k_permutations(unsigned n, unsigned k)
+{
+  assert(k <= n);
+  PermutationRank count = 1;
+  for (unsigned i = n - k + 1; i <= n; i += 1)
+    count *= i;
+  return count;
+}
+
+
+template <class PlaceArray>
+PermutationRank rank_k_permutation(unsigned n,
+                                   unsigned k,
+                                   const PlaceArray &places)
+{
+  assert(k <= n && n <= MAX_RANKED_PERMUTATION_SIZE);
+
+  // The k-permutation is laid out as the last k entries of a
+  // permutation of n.  The unused places fill the first n - k entries
+  // in some order, but the ranking never looks at those entries, so
+  // they are only tracked as being somewhere in the front.
+  const unsigned char in_front = 0xFF;
+  boost::array<unsigned char, MAX_RANKED_PERMUTATION_SIZE> perm;
+  boost::array<unsigned char, MAX_RANKED_PERMUTATION_SIZE> inverse;
+  inverse.assign(in_front);
+
+  for (unsigned j = 0; j < k; j += 1) {
+    assert(places[j] < n);
+    assert(inverse[places[j]] == in_front);
+    perm[n - 1 - j] = places[j];
+    inverse[places[j]] = n - 1 - j;
+  }
+
+  PermutationRank rank = 0;
+  PermutationRank multiplier = 1;
+  for (unsigned i = n; i > n - k; i -= 1) {
+    const unsigned s = perm[i - 1];
+    rank += s * multiplier;
+    multiplier *= i;
+
+    // Swap value i - 1 into entry i - 1, which is not looked at again.
+    const unsigned char where = inverse[i - 1];
+    if (where != in_front)
+      perm[where] = s;
+    inverse[s] = where;
+  }
+
+  return rank;
+}
+
+
+template <class PlaceArray>
+void unrank_k_permutation(unsigned n,
+                          unsigned k,
+                          PermutationRank rank,
+                          PlaceArray &places)
+{
+  assert(k <= n && n <= MAX_RANKED_PERMUTATION_SIZE);
+  assert(rank < num_k_permutations(n, k));
+
+  boost::array<unsigned char, MAX_RANKED_PERMUTATION_SIZE> perm;
+  for (unsigned i = 0; i < n; i += 1)
+    perm[i] = i;
+
+  for (unsigned i = n; i > n - k; i -= 1) {
+    const unsigned s = rank % i;
+    rank /= i;
+    std::swap(perm[i - 1], perm[s]);
+  }
+
+  for (unsigned j = 0; j < k; j += 1)
+    places[j] = perm[n - 1 - j];
+}
+
+
+#endif /* !_PERMUTATION_RANK_HPP_ */